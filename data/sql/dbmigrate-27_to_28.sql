@@ -0,0 +1,27 @@
+-- Script to migate from db version 27 to 28
+-- Adds the resolve cache
+
+CREATE TABLE IF NOT EXISTS resolve_cache (
+    artist TEXT NOT NULL,
+    track TEXT NOT NULL,
+    album TEXT NOT NULL,
+    resolver TEXT NOT NULL,                 -- Resolver::name() of the resolver which found it
+    source INTEGER REFERENCES source(id) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,
+    url TEXT NOT NULL,
+    artistname TEXT NOT NULL,
+    albumname TEXT NOT NULL,
+    trackname TEXT NOT NULL,
+    mimetype TEXT,
+    duration INTEGER,
+    bitrate INTEGER,
+    size INTEGER,
+    friendlysource TEXT,
+    score REAL NOT NULL,
+    expires INTEGER NOT NULL                -- timestamp after which the result is revalidated
+);
+
+CREATE INDEX resolve_cache_query ON resolve_cache(artist, track, album);
+CREATE INDEX resolve_cache_source ON resolve_cache(source);
+CREATE INDEX resolve_cache_expires ON resolve_cache(expires);
+
+UPDATE settings SET v = '28' WHERE k == 'schema_version';
@@ -0,0 +1,7 @@
+-- Script to migate from db version 28 to 29
+-- Playlist revisions can be stored as a delta to their previous revision
+
+ALTER TABLE playlist_revision ADD COLUMN delta TEXT;
+ALTER TABLE playlist_revision ADD COLUMN depth INTEGER NOT NULL DEFAULT 0;
+
+UPDATE settings SET v = '29' WHERE k == 'schema_version';
@@ -0,0 +1,52 @@
+-- Script to migate from db version 29 to 30
+-- Sortnames fold diacritics and drop punctuation now. They have been recomputed
+-- (and their unique indexes dropped) before this script runs, so merge the
+-- artists, tracks and albums that ended up with the same sortname into the
+-- one with the lowest id, then restore the indexes.
+
+CREATE TEMP TABLE artist_merge AS
+    SELECT a.id AS old, m.id AS new FROM artist a
+    JOIN ( SELECT sortname, MIN(id) AS id FROM artist GROUP BY sortname HAVING COUNT(*) > 1 ) m
+    ON a.sortname = m.sortname WHERE a.id != m.id;
+
+UPDATE track SET artist = ( SELECT new FROM artist_merge WHERE old = track.artist ) WHERE artist IN ( SELECT old FROM artist_merge );
+UPDATE album SET artist = ( SELECT new FROM artist_merge WHERE old = album.artist ) WHERE artist IN ( SELECT old FROM artist_merge );
+UPDATE file_join SET artist = ( SELECT new FROM artist_merge WHERE old = file_join.artist ) WHERE artist IN ( SELECT old FROM artist_merge );
+UPDATE OR IGNORE artist_tags SET id = ( SELECT new FROM artist_merge WHERE old = artist_tags.id ) WHERE id IN ( SELECT old FROM artist_merge );
+DELETE FROM artist_tags WHERE id IN ( SELECT old FROM artist_merge );
+DELETE FROM artist WHERE id IN ( SELECT old FROM artist_merge );
+DROP TABLE artist_merge;
+
+CREATE TEMP TABLE track_merge AS
+    SELECT t.id AS old, m.id AS new FROM track t
+    JOIN ( SELECT artist, sortname, MIN(id) AS id FROM track GROUP BY artist, sortname HAVING COUNT(*) > 1 ) m
+    ON t.artist = m.artist AND t.sortname = m.sortname WHERE t.id != m.id;
+
+UPDATE file_join SET track = ( SELECT new FROM track_merge WHERE old = file_join.track ) WHERE track IN ( SELECT old FROM track_merge );
+UPDATE track_attributes SET id = ( SELECT new FROM track_merge WHERE old = track_attributes.id ) WHERE id IN ( SELECT old FROM track_merge );
+UPDATE social_attributes SET id = ( SELECT new FROM track_merge WHERE old = social_attributes.id ) WHERE id IN ( SELECT old FROM track_merge );
+UPDATE playback_log SET track = ( SELECT new FROM track_merge WHERE old = playback_log.track ) WHERE track IN ( SELECT old FROM track_merge );
+UPDATE OR IGNORE track_tags SET id = ( SELECT new FROM track_merge WHERE old = track_tags.id ) WHERE id IN ( SELECT old FROM track_merge );
+DELETE FROM track_tags WHERE id IN ( SELECT old FROM track_merge );
+DELETE FROM track WHERE id IN ( SELECT old FROM track_merge );
+DROP TABLE track_merge;
+
+CREATE TEMP TABLE album_merge AS
+    SELECT a.id AS old, m.id AS new FROM album a
+    JOIN ( SELECT artist, sortname, MIN(id) AS id FROM album GROUP BY artist, sortname HAVING COUNT(*) > 1 ) m
+    ON a.artist = m.artist AND a.sortname = m.sortname WHERE a.id != m.id;
+
+UPDATE file_join SET album = ( SELECT new FROM album_merge WHERE old = file_join.album ) WHERE album IN ( SELECT old FROM album_merge );
+UPDATE OR IGNORE album_tags SET id = ( SELECT new FROM album_merge WHERE old = album_tags.id ) WHERE id IN ( SELECT old FROM album_merge );
+DELETE FROM album_tags WHERE id IN ( SELECT old FROM album_merge );
+DELETE FROM album WHERE id IN ( SELECT old FROM album_merge );
+DROP TABLE album_merge;
+
+CREATE UNIQUE INDEX artist_sortname ON artist(sortname);
+CREATE UNIQUE INDEX track_artist_sortname ON track(artist,sortname);
+CREATE UNIQUE INDEX album_artist_sortname ON album(artist,sortname);
+
+-- cached results are keyed by the old sortnames
+DELETE FROM resolve_cache;
+
+UPDATE settings SET v = '30' WHERE k == 'schema_version';
@@ -0,0 +1,6 @@
+-- Script to migate from db version 30 to 31
+-- Adds the full text index used to filter collection views. sqlite may lack
+-- fts4, so the index itself is created and filled in code, see
+-- DatabaseImpl::setupFullTextIndex().
+
+UPDATE settings SET v = '31' WHERE k == 'schema_version';
@@ -0,0 +1,10 @@
+-- Script to migate from db version 31 to 32
+-- Adds indexes on the file columns collection views sort by, so a page of
+-- them is read in index order instead of sorting all matching files.
+
+CREATE INDEX IF NOT EXISTS file_mtime ON file(mtime);
+CREATE INDEX IF NOT EXISTS file_size ON file(size);
+CREATE INDEX IF NOT EXISTS file_duration ON file(duration);
+CREATE INDEX IF NOT EXISTS file_bitrate ON file(bitrate);
+
+UPDATE settings SET v = '32' WHERE k == 'schema_version';
@@ -24,6 +24,11 @@
 #include <sip/SipHandler.h>
 #include <network/servent.h>
 #include <sourcelist.h>
+#include <artist.h>
+#include <album.h>
+#include <query.h>
+#include <result.h>
+#include <pipeline.h>
 
 #include <QTextEdit>
 #include <QDialogButtonBox>
@@ -61,6 +66,22 @@ void DiagnosticsDialog::updateLogView()
         "TOMAHAWK-VERSION: " TOMAHAWK_VERSION "\n\n\n"
     );
 
+    // shared objects, to keep an eye on the registries growing
+    log.append(
+        QString(
+            "OBJECTS:\n"
+            "    artists: %1\n"
+            "    albums: %2\n"
+            "    queries: %3 (unsolved: %4)\n"
+            "    results: %5\n"
+            "\n\n"
+        ).arg( Tomahawk::Artist::registrySize() )
+         .arg( Tomahawk::Album::registrySize() )
+         .arg( Tomahawk::Query::registrySize() )
+         .arg( Tomahawk::Pipeline::instance()->unsolvedQueryCount() )
+         .arg( Tomahawk::Result::registrySize() )
+    );
+
     // network
     log.append(
         "NETWORK:\n"
@@ -0,0 +1,189 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dirwatcher.h"
+
+#include <QFile>
+#include <QSocketNotifier>
+#include <QVarLengthArray>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "utils/logger.h"
+
+#ifdef Q_OS_LINUX
+#define WATCH_MASK ( IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR )
+#endif
+
+
+DirWatcher::DirWatcher( QObject* parent )
+    : QObject( parent )
+    , m_fd( -1 )
+    , m_notifier( 0 )
+{
+#ifdef Q_OS_LINUX
+    m_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( m_fd < 0 )
+    {
+        tLog() << "Could not initialize inotify:" << errno;
+        return;
+    }
+
+    m_notifier = new QSocketNotifier( m_fd, QSocketNotifier::Read, this );
+    connect( m_notifier, SIGNAL( activated( int ) ), SLOT( readEvents() ) );
+#endif
+}
+
+
+DirWatcher::~DirWatcher()
+{
+#ifdef Q_OS_LINUX
+    delete m_notifier;
+    if ( m_fd >= 0 )
+        ::close( m_fd );
+#endif
+}
+
+
+bool
+DirWatcher::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool
+DirWatcher::addDirs( const QStringList& dirs )
+{
+#ifdef Q_OS_LINUX
+    if ( m_fd < 0 )
+        return false;
+
+    foreach ( const QString& dir, dirs )
+    {
+        if ( m_wds.contains( dir ) )
+            continue;
+
+        const int wd = inotify_add_watch( m_fd, QFile::encodeName( dir ).constData(), WATCH_MASK );
+        if ( wd < 0 )
+        {
+            if ( errno == ENOENT || errno == ENOTDIR )
+                continue; // gone already, the scanner takes care of that
+
+            tLog() << "Could not watch" << dir << "- errno" << errno << "- watching" << m_wds.count() << "dirs";
+            return false;
+        }
+
+        m_wds.insert( dir, wd );
+        m_dirs.insert( wd, dir );
+    }
+
+    return true;
+#else
+    Q_UNUSED( dirs );
+    return false;
+#endif
+}
+
+
+void
+DirWatcher::removeDir( const QString& dir )
+{
+#ifdef Q_OS_LINUX
+    if ( !m_wds.contains( dir ) )
+        return;
+
+    const int wd = m_wds.take( dir );
+    m_dirs.remove( wd );
+    inotify_rm_watch( m_fd, wd );
+#else
+    Q_UNUSED( dir );
+#endif
+}
+
+
+void
+DirWatcher::clear()
+{
+    foreach ( const QString& dir, m_wds.keys() )
+        removeDir( dir );
+}
+
+
+void
+DirWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    int available = 0;
+    if ( ioctl( m_fd, FIONREAD, &available ) < 0 || available <= 0 )
+        available = 4096;
+
+    QVarLengthArray< char, 4096 > buffer( available );
+    const ssize_t len = ::read( m_fd, buffer.data(), available );
+    if ( len <= 0 )
+        return;
+
+    // a single write to a dir produces loads of events, only tell about each dir once
+    QStringList changed;
+    bool overflowed = false;
+
+    const char* at = buffer.constData();
+    const char* const end = at + len;
+    while ( at + sizeof( inotify_event ) <= end )
+    {
+        const inotify_event* ev = reinterpret_cast< const inotify_event* >( at );
+        at += sizeof( inotify_event ) + ev->len;
+
+        if ( ev->mask & IN_Q_OVERFLOW )
+        {
+            overflowed = true;
+            continue;
+        }
+
+        const QString dir = m_dirs.value( ev->wd );
+        if ( dir.isEmpty() )
+            continue;
+
+        if ( ev->mask & IN_IGNORED )
+        {
+            // the kernel dropped the watch, the dir was deleted or unmounted
+            m_dirs.remove( ev->wd );
+            m_wds.remove( dir );
+        }
+
+        if ( !changed.contains( dir ) )
+            changed << dir;
+    }
+
+    if ( overflowed )
+        emit overflow();
+
+    foreach ( const QString& dir, changed )
+        emit dirChanged( dir );
+#endif
+}
@@ -0,0 +1,65 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRWATCHER_H
+#define DIRWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+
+class QSocketNotifier;
+
+// Watches single directories (not their subdirs) for changes to their entries or the files in them.
+// Backed by inotify, so only supported on Linux; elsewhere addDirs() always fails.
+class DirWatcher : public QObject
+{
+Q_OBJECT
+
+public:
+    explicit DirWatcher( QObject* parent = 0 );
+    virtual ~DirWatcher();
+
+    static bool isSupported();
+
+    // returns false if not all dirs could be watched, e.g. when hitting the inotify watch limit
+    bool addDirs( const QStringList& dirs );
+    void removeDir( const QString& dir );
+    void clear();
+
+    QStringList dirs() const { return m_wds.keys(); }
+    bool isWatching( const QString& dir ) const { return m_wds.contains( dir ); }
+
+signals:
+    // something in dir was added, removed or written to, or dir itself went away
+    void dirChanged( const QString& dir );
+    // the kernel dropped events, we can't tell what changed
+    void overflow();
+
+private slots:
+    void readEvents();
+
+private:
+    int m_fd;
+    QSocketNotifier* m_notifier;
+
+    QHash< QString, int > m_wds;
+    QHash< int, QString > m_dirs;
+};
+
+#endif
@@ -22,54 +22,137 @@
 #include "database/database.h"
 #include "database/databaseimpl.h"
 #include "database/databasecommand_alltracks.h"
+#include "database/databasecommand_assignids.h"
+#include "database/idcache.h"
 #include "query.h"
 
 #include "utils/logger.h"
+#include "utils/weakregistry.h"
 
 using namespace Tomahawk;
 
-Album::Album() {}
-Album::~Album() {}
+static TomahawkUtils::WeakRegistry< unsigned int, Album > s_albums;
+// albums handed out without id, by the sortnames of artist and album, see unassignedKey()
+static TomahawkUtils::WeakRegistry< QString, Album > s_unassignedAlbums;
+
+
+// the artist may have no id yet either, so go by its name
+static QString
+unassignedKey( const Tomahawk::artist_ptr& artist, const QString& name )
+{
+    return DatabaseImpl::sortname( artist->name() ) + '\t' + DatabaseImpl::sortname( name );
+}
+
+
+Album::Album()
+    : m_id( 0 )
+    , m_idPending( 0 )
+{
+}
+
+
+Album::~Album()
+{
+    if ( m_id > 0 )
+        s_albums.remove( m_id );
+    if ( !m_unassignedKey.isEmpty() )
+        s_unassignedAlbums.remove( m_unassignedKey );
+}
+
 
 album_ptr
 Album::get( const Tomahawk::artist_ptr& artist, const QString& name, bool autoCreate )
 {
-    int albid = Database::instance()->impl()->albumId( artist->id(), name, autoCreate );
-    if ( albid < 1 && autoCreate )
-        return album_ptr();
+    // same as Artist::get(), never block on the database for a name
+    if ( artist->id() > 0 )
+    {
+        int albid = IdCache::albums()->value( IdCache::albumKey( artist->id(), DatabaseImpl::sortname( name ) ) );
+        if ( albid > 0 )
+            return Album::get( albid, name, artist );
+    }
+
+    album_ptr album = Album::get( 0, name, artist );
+    if ( name.isEmpty() )
+        return album;
+
+    // everybody asking for the name gets the same album until its id is known
+    album->m_unassignedKey = unassignedKey( artist, name );
+    const album_ptr unassigned = s_unassignedAlbums.insert( album->m_unassignedKey, album );
+    const bool lookupQueued = ( unassigned != album && unassigned->idPending() );
+    album = unassigned;
 
-    return Album::get( albid, name, artist );
+    // queue another lookup only if it has to create the album, the first one might not
+    if ( ( autoCreate || ( !lookupQueued && !IdCache::albums()->isLoaded() ) ) && Database::instance() )
+    {
+        album->m_idPending = 1;
+        DatabaseCommand_AssignIds* cmd = new DatabaseCommand_AssignIds( album, autoCreate );
+        Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
+    }
+
+    return album;
 }
 
 
 album_ptr
 Album::get( unsigned int id, const QString& name, const Tomahawk::artist_ptr& artist )
 {
-    static QHash< unsigned int, album_ptr > s_albums;
-    static QMutex s_mutex;
-
-    QMutexLocker lock( &s_mutex );
-    if ( s_albums.contains( id ) )
+    if ( id > 0 )
     {
-        return s_albums.value( id );
+        album_ptr a = s_albums.value( id );
+        if ( !a.isNull() )
+            return a;
+
+        // the album may have been handed out by name already, that one becomes ours
+        if ( !artist.isNull() && !name.isEmpty() )
+        {
+            a = s_unassignedAlbums.value( unassignedKey( artist, name ) );
+            if ( !a.isNull() && ( a->id() == 0 || a->id() == id ) )
+                return setId( a, id );
+        }
     }
 
     album_ptr a = album_ptr( new Album( id, name, artist ) );
     if ( id > 0 )
-        s_albums.insert( id, a );
+        return s_albums.insert( id, a );
 
     return a;
 }
 
 
+album_ptr
+Album::setId( const album_ptr& album, unsigned int id )
+{
+    const bool assigned = ( id > 0 && album->m_id.testAndSetOrdered( 0, id ) );
+    album->m_idPending = 0;
+    if ( id == 0 || album->id() != id )
+        return album;
+
+    // another album might have been registered for the id meanwhile, keep that one
+    const album_ptr registered = s_albums.insert( id, album );
+    if ( assigned )
+        emit album->idChanged( id );
+
+    return registered;
+}
+
+
+unsigned int
+Album::registrySize()
+{
+    return s_albums.count();
+}
+
+
 Album::Album( unsigned int id, const QString& name, const Tomahawk::artist_ptr& artist )
     : PlaylistInterface( this )
     , m_id( id )
+    , m_idPending( 0 )
     , m_name( name )
     , m_artist( artist )
     , m_currentItem( 0 )
     , m_currentTrack( 0 )
 {
+    m_sortname = DatabaseImpl::sortname( name );
 }
 
 
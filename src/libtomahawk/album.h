@@ -20,6 +20,7 @@
 #define TOMAHAWKALBUM_H
 
 #include <QObject>
+#include <QAtomicInt>
 #include <QSharedPointer>
 
 #include "typedefs.h"
@@ -36,12 +37,20 @@ Q_OBJECT
 public:
     static album_ptr get( const Tomahawk::artist_ptr& artist, const QString& name, bool autoCreate = false );
     static album_ptr get( unsigned int id, const QString& name, const Tomahawk::artist_ptr& artist );
+    /// Number of albums known by id, including ones about to be swept.
+    static unsigned int registrySize();
+    /// Ends the id lookup of an album created while its name was still unknown, giving it \a id if one was found.
+    /// Returns the album registered for the id, which is \a album unless another one got there first.
+    static Tomahawk::album_ptr setId( const Tomahawk::album_ptr& album, unsigned int id );
 
     Album( unsigned int id, const QString& name, const Tomahawk::artist_ptr& artist );
     ~Album();
 
     unsigned int id() const { return m_id; }
+    /// Whether the id is still being looked up in the background, see idChanged().
+    bool idPending() const { return m_idPending == 1; }
     QString name() const { return m_name; }
+    QString sortname() const { return m_sortname; }
     artist_ptr artist() const;
 
     QList<Tomahawk::query_ptr> tracks();
@@ -63,6 +72,8 @@ public:
     virtual void setFilter( const QString& /*pattern*/ ) {}
 
 signals:
+    void idChanged( unsigned int id );
+
     void repeatModeChanged( PlaylistInterface::RepeatMode mode );
     void shuffleModeChanged( bool enabled );
 
@@ -78,8 +89,11 @@ private slots:
 private:
     Album();
 
-    unsigned int m_id;
+    QAtomicInt m_id; // filled in later for names that weren't known yet
+    QAtomicInt m_idPending;
+    QString m_unassignedKey;
     QString m_name;
+    QString m_sortname;
 
     artist_ptr m_artist;
     QList<Tomahawk::query_ptr> m_queries;
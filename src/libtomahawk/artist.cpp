@@ -22,57 +22,116 @@
 #include "database/database.h"
 #include "database/databaseimpl.h"
 #include "database/databasecommand_alltracks.h"
+#include "database/databasecommand_assignids.h"
+#include "database/idcache.h"
 #include "query.h"
 
 #include "utils/logger.h"
+#include "utils/weakregistry.h"
 
 using namespace Tomahawk;
 
+static TomahawkUtils::WeakRegistry< unsigned int, Artist > s_artists;
+// artists handed out without id, by the sortname their id is looked up by
+static TomahawkUtils::WeakRegistry< QString, Artist > s_unassignedArtists;
+
 
 Artist::Artist()
+    : m_id( 0 )
+    , m_idPending( 0 )
 {
 }
 
 
 Artist::~Artist()
 {
+    if ( m_id > 0 )
+        s_artists.remove( m_id );
+    if ( !m_unassignedKey.isEmpty() )
+        s_unassignedArtists.remove( m_unassignedKey );
 }
 
 
 artist_ptr
 Artist::get( const QString& name, bool autoCreate )
 {
-    int artid = Database::instance()->impl()->artistId( name, autoCreate );
-    if ( artid < 1 && autoCreate )
-        return artist_ptr();
+    // Called from the GUI and resolver threads, so never touch the database here.
+    // Unknown names get an artist without id, which is filled in in the background.
+    const QString key = DatabaseImpl::sortname( name );
+    int artid = IdCache::artists()->value( key );
+    if ( artid > 0 )
+        return Artist::get( artid, name );
+
+    // everybody asking for the name gets the same artist until its id is known
+    artist_ptr artist = Artist::get( 0, name );
+    artist->m_unassignedKey = key;
+    const artist_ptr unassigned = s_unassignedArtists.insert( key, artist );
+    const bool lookupQueued = ( unassigned != artist && unassigned->idPending() );
+    artist = unassigned;
+
+    // queue another lookup only if it has to create the artist, the first one might not
+    if ( ( autoCreate || ( !lookupQueued && !IdCache::artists()->isLoaded() ) ) && Database::instance() )
+    {
+        artist->m_idPending = 1;
+        DatabaseCommand_AssignIds* cmd = new DatabaseCommand_AssignIds( artist, autoCreate );
+        Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
+    }
 
-    return Artist::get( artid, name );
+    return artist;
 }
 
 
 artist_ptr
 Artist::get( unsigned int id, const QString& name )
 {
-    static QHash< unsigned int, artist_ptr > s_artists;
-    static QMutex s_mutex;
-
-    QMutexLocker lock( &s_mutex );
-    if ( s_artists.contains( id ) )
+    if ( id > 0 )
     {
-        return s_artists.value( id );
+        artist_ptr a = s_artists.value( id );
+        if ( !a.isNull() )
+            return a;
+
+        // the artist may have been handed out by name already, that one becomes ours
+        a = s_unassignedArtists.value( DatabaseImpl::sortname( name ) );
+        if ( !a.isNull() && ( a->id() == 0 || a->id() == id ) )
+            return setId( a, id );
     }
 
     artist_ptr a = artist_ptr( new Artist( id, name ) );
     if ( id > 0 )
-        s_artists.insert( id, a );
+        return s_artists.insert( id, a );
 
     return a;
 }
 
 
+artist_ptr
+Artist::setId( const artist_ptr& artist, unsigned int id )
+{
+    const bool assigned = ( id > 0 && artist->m_id.testAndSetOrdered( 0, id ) );
+    artist->m_idPending = 0;
+    if ( id == 0 || artist->id() != id )
+        return artist;
+
+    // another artist might have been registered for the id meanwhile, keep that one
+    const artist_ptr registered = s_artists.insert( id, artist );
+    if ( assigned )
+        emit artist->idChanged( id );
+
+    return registered;
+}
+
+
+unsigned int
+Artist::registrySize()
+{
+    return s_artists.count();
+}
+
+
 Artist::Artist( unsigned int id, const QString& name )
     : PlaylistInterface( this )
     , m_id( id )
+    , m_idPending( 0 )
     , m_name( name )
     , m_currentItem( 0 )
     , m_currentTrack( 0 )
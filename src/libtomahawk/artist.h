@@ -20,6 +20,7 @@
 #define TOMAHAWKARTIST_H
 
 #include <QObject>
+#include <QAtomicInt>
 #include <QSharedPointer>
 
 #include "typedefs.h"
@@ -36,12 +37,19 @@ Q_OBJECT
 public:
     static artist_ptr get( const QString& name, bool autoCreate = false );
     static artist_ptr get( unsigned int id, const QString& name );
+    /// Number of artists known by id, including ones about to be swept.
+    static unsigned int registrySize();
+    /// Ends the id lookup of an artist created while its name was still unknown, giving it \a id if one was found.
+    /// Returns the artist registered for the id, which is \a artist unless another one got there first.
+    static Tomahawk::artist_ptr setId( const Tomahawk::artist_ptr& artist, unsigned int id );
     Artist( unsigned int id, const QString& name );
 
     Artist();
     virtual ~Artist();
 
     unsigned int id() const { return m_id; }
+    /// Whether the id is still being looked up in the background, see idChanged().
+    bool idPending() const { return m_idPending == 1; }
     QString name() const { return m_name; }
     QString sortname() const { return m_sortname; }
 
@@ -64,6 +72,8 @@ public:
     virtual void setFilter( const QString& /*pattern*/ ) {}
 
 signals:
+    void idChanged( unsigned int id );
+
     void repeatModeChanged( PlaylistInterface::RepeatMode mode );
     void shuffleModeChanged( bool enabled );
 
@@ -79,7 +89,9 @@ private slots:
 private:
     Q_DISABLE_COPY(Artist)
 
-    unsigned int m_id;
+    QAtomicInt m_id; // filled in later for names that weren't known yet
+    QAtomicInt m_idPending;
+    QString m_unassignedKey;
     QString m_name;
     QString m_sortname;
 
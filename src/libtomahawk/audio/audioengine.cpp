@@ -27,6 +27,7 @@
 #include "actioncollection.h"
 #include "database/database.h"
 #include "database/databasecommand_logplayback.h"
+#include "pipeline.h"
 #include "network/servent.h"
 #include "utils/qnr_iodevicestream.h"
 #include "headlesscheck.h"
@@ -528,10 +529,24 @@ AudioEngine::loadTrack( const Tomahawk::result_ptr& result )
     }
 
     m_waitingOnNewTrack = false;
+    resolveNextTrack();
     return true;
 }
 
 
+void
+AudioEngine::resolveNextTrack()
+{
+    if ( m_playlist.isNull() || !Pipeline::instance() )
+        return;
+
+    // ahead of whatever the views want resolved, e.g. a big playlist that just got opened
+    const Tomahawk::query_ptr next = m_playlist.data()->siblingQuery( 1 );
+    if ( !next.isNull() )
+        Pipeline::instance()->resolve( next, Pipeline::PriorityPlayback );
+}
+
+
 void
 AudioEngine::loadPreviousTrack()
 {
@@ -601,6 +616,7 @@ AudioEngine::playItem( Tomahawk::PlaylistInterface* playlist, const Tomahawk::re
     else if ( !m_playlist.isNull() && m_playlist.data()->retryMode() == PlaylistInterface::Retry )
     {
         m_waitingOnNewTrack = true;
+        resolveNextTrack();
         if ( isStopped() )
             sendWaitingNotification();
         else
@@ -146,6 +146,8 @@ private:
 
     void sendWaitingNotification() const;
     void sendNowPlayingNotification();
+    // resolves the playlist's next track at PriorityPlayback
+    void resolveNextTrack();
 
     bool m_isPlayingHttp;
     QSharedPointer<QIODevice> m_input;
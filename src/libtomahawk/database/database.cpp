@@ -18,7 +18,11 @@
 
 #include "database.h"
 
+#include <QtConcurrentRun>
+
 #include "databasecommand.h"
+#include "databasecommand_compactoplog.h"
+#include "databasecommand_updatesearchindex.h"
 #include "databaseimpl.h"
 #include "databaseworker.h"
 #include "utils/logger.h"
@@ -26,6 +30,10 @@
 #define DEFAULT_WORKER_THREADS 4
 #define MAX_WORKER_THREADS 16
 
+// the oplog is compacted a while after startup, then periodically
+#define COMPACT_DELAY 300000
+#define COMPACT_INTERVAL 21600000
+
 Database* Database::s_instance = 0;
 
 
@@ -39,19 +47,27 @@ Database::instance()
 Database::Database( const QString& dbname, QObject* parent )
     : QObject( parent )
     , m_ready( false )
-    , m_impl( new DatabaseImpl( dbname, this ) )
-    , m_workerRW( new DatabaseWorker( m_impl, this, true ) )
+    , m_impl( 0 )
+    , m_openFailed( false )
+    , m_workerRW( 0 )
 {
     s_instance = this;
 
     m_maxConcurrentThreads = qBound( DEFAULT_WORKER_THREADS, QThread::idealThreadCount(), MAX_WORKER_THREADS );
     qDebug() << Q_FUNC_INFO << "Using" << m_maxConcurrentThreads << "threads";
 
-    connect( m_impl, SIGNAL( indexReady() ), SIGNAL( indexReady() ) );
-    connect( m_impl, SIGNAL( indexReady() ), SIGNAL( ready() ) );
-    connect( m_impl, SIGNAL( indexReady() ), SLOT( setIsReadyTrue() ) );
+    // a quick look into the settings table; a new database gets its dbid from us
+    m_dbid = DatabaseImpl::getDatabaseId( dbname );
+    if ( m_dbid.isEmpty() )
+        m_dbid = uuid();
 
-    m_workerRW->start();
+    connect( &m_openWatcher, SIGNAL( finished() ), SLOT( onOpened() ) );
+    m_openWatcher.setFuture( QtConcurrent::run( &Database::openImpl, dbname, m_dbid, thread() ) );
+
+    m_compactTimer.setInterval( COMPACT_INTERVAL );
+    connect( &m_compactTimer, SIGNAL( timeout() ), SLOT( compactOplog() ) );
+    m_compactTimer.start();
+    QTimer::singleShot( COMPACT_DELAY, this, SLOT( compactOplog() ) );
 }
 
 
@@ -61,20 +77,120 @@ Database::~Database()
 
     qDeleteAll( m_workers );
     delete m_workerRW;
-    delete m_impl;
+    delete impl();
+}
+
+
+DatabaseImpl*
+Database::openImpl( const QString& dbname, const QString& dbid, QThread* thread )
+{
+    DatabaseImpl* impl = new DatabaseImpl( dbname, 0, dbid );
+    if ( !impl->isValid() )
+    {
+        delete impl;
+        return 0;
+    }
+
+    impl->loadIdCache();
+    impl->moveToThread( thread );
+
+    return impl;
+}
+
+
+DatabaseImpl*
+Database::impl() const
+{
+    {
+        QMutexLocker lock( &m_pendingMutex );
+        if ( m_impl )
+            return m_impl;
+    }
+
+    // whoever needs the db before it finished opening has to wait for it,
+    // null if it couldn't be opened
+    return m_openWatcher.future().result();
+}
+
+
+bool
+Database::isOpen() const
+{
+    QMutexLocker lock( &m_pendingMutex );
+    return m_impl != 0;
+}
+
+
+void
+Database::onOpened()
+{
+    DatabaseImpl* impl = m_openWatcher.result();
+    if ( !impl )
+    {
+        QMutexLocker lock( &m_pendingMutex );
+        tLog() << "Failed to open the database, dropping" << m_pending.count() << "queued commands";
+        m_pending.clear();
+        m_openFailed = true;
+
+        emit openFailed();
+        return;
+    }
+
+    impl->setParent( this );
+
+    connect( impl, SIGNAL( indexReady() ), SIGNAL( indexReady() ) );
+    connect( impl, SIGNAL( indexReady() ), SIGNAL( ready() ) );
+    connect( impl, SIGNAL( indexReady() ), SLOT( setIsReadyTrue() ) );
+
+    m_workerRW = new DatabaseWorker( impl, this, true );
+    m_workerRW->start();
+
+    QList< QSharedPointer<DatabaseCommand> > pending;
+    {
+        QMutexLocker lock( &m_pendingMutex );
+        m_impl = impl;
+        pending = m_pending;
+        m_pending.clear();
+    }
+
+    tLog() << "Database opened, running" << pending.count() << "queued commands";
+    foreach ( const QSharedPointer<DatabaseCommand>& cmd, pending )
+        enqueue( cmd );
+
+    emit opened();
 }
 
 
 void
 Database::loadIndex()
 {
-    m_impl->loadIndex();
+    // the search index lives in memory only, so build it from the database
+    enqueue( QSharedPointer<DatabaseCommand>( new DatabaseCommand_UpdateSearchIndex() ) );
+}
+
+
+void
+Database::compactOplog()
+{
+    enqueue( QSharedPointer<DatabaseCommand>( new DatabaseCommand_CompactOplog() ) );
 }
 
 
 void
 Database::enqueue( const QList< QSharedPointer<DatabaseCommand> >& lc )
 {
+    DatabaseImpl* impl;
+    {
+        QMutexLocker lock( &m_pendingMutex );
+        impl = m_impl;
+        if ( !impl )
+        {
+            if ( !m_openFailed )
+                m_pending << lc;
+            return;
+        }
+    }
+
     qDebug() << "Enqueueing" << lc.count() << "commands to rw thread";
     m_workerRW->enqueue( lc );
 }
@@ -83,6 +199,18 @@ Database::enqueue( const QList< QSharedPointer<DatabaseCommand> >& lc )
 void
 Database::enqueue( const QSharedPointer<DatabaseCommand>& lc )
 {
+    DatabaseImpl* impl;
+    {
+        QMutexLocker lock( &m_pendingMutex );
+        impl = m_impl;
+        if ( !impl )
+        {
+            if ( !m_openFailed )
+                m_pending << lc;
+            return;
+        }
+    }
+
     if ( lc->doesMutates() )
     {
         qDebug() << "Enqueueing command to rw thread:" << lc->commandname();
@@ -94,7 +222,7 @@ Database::enqueue( const QSharedPointer<DatabaseCommand>& lc )
         // create new thread if < WORKER_THREADS
         if ( m_workers.count() < m_maxConcurrentThreads )
         {
-            DatabaseWorker* worker = new DatabaseWorker( m_impl, this, false );
+            DatabaseWorker* worker = new DatabaseWorker( impl, this, false );
             worker->start();
 
             m_workers << worker;
@@ -106,6 +234,8 @@ Database::enqueue( const QSharedPointer<DatabaseCommand>& lc )
         for ( int i = 0; i < m_workers.count(); i++ )
         {
             DatabaseWorker* worker = m_workers.at( i );
+            if ( !worker->isValid() )
+                continue;
 
             if ( !worker->busy() )
             {
@@ -118,6 +248,10 @@ Database::enqueue( const QSharedPointer<DatabaseCommand>& lc )
                 happyThread = worker;
         }
 
+        // none of the readers could open a connection of its own
+        if ( !happyThread )
+            happyThread = m_workerRW;
+
 //        qDebug() << "Enqueueing command to thread:" << happyThread << busyThreads << lc->commandname();
         happyThread->enqueue( lc );
     }
@@ -127,5 +261,7 @@ Database::enqueue( const QSharedPointer<DatabaseCommand>& lc )
 QString
 Database::dbid() const
 {
-    return m_impl->dbid();
+    // once open, trust what the database says over what we read up front
+    QMutexLocker lock( &m_pendingMutex );
+    return m_impl ? m_impl->dbid() : m_dbid;
 }
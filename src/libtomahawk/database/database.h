@@ -19,7 +19,10 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <QFutureWatcher>
+#include <QMutex>
 #include <QSharedPointer>
+#include <QTimer>
 #include <QVariant>
 
 #include "artist.h"
@@ -40,6 +43,12 @@ class DatabaseWorker;
     the queue of work. There is a threadpool responsible for exec'ing all
     the non-mutating (readonly) commands and one separate thread for mutating ones,
     so sqlite doesn't write to the Database from multiple threads.
+    Each readonly worker owns its own sqlite connection and the database runs
+    in WAL mode, so readers don't block each other or the writer.
+
+    The database file is opened (and migrated, if needed) on a background
+    thread, so the rest of the app can start up meanwhile. Commands enqueued
+    before that finished are held back and run once it's open.
 */
 class DLLEXPORT Database : public QObject
 {
@@ -57,8 +66,11 @@ public:
     void loadIndex();
 
     bool isReady() const { return m_ready; }
+    bool isOpen() const;
 
 signals:
+    void opened();
+    void openFailed();
     void indexReady(); // search index
     void ready();
 
@@ -71,21 +83,34 @@ public slots:
 
 private slots:
     void setIsReadyTrue() { m_ready = true; }
+    void compactOplog();
+    void onOpened();
 
 private:
-    DatabaseImpl* impl() const { return m_impl; }
+    static DatabaseImpl* openImpl( const QString& dbname, const QString& dbid, QThread* thread );
+    DatabaseImpl* impl() const;
+    DatabaseWorker* workerRW() const { return m_workerRW; }
 
     bool m_ready;
+    // known before the db is open, so asking for it never waits on that
+    QString m_dbid;
+    // guarded by m_pendingMutex, as it's set once the db was opened
     DatabaseImpl* m_impl;
+    QFutureWatcher< DatabaseImpl* > m_openWatcher;
+    mutable QMutex m_pendingMutex;
+    bool m_openFailed;
+    QList< QSharedPointer<DatabaseCommand> > m_pending;
     DatabaseWorker* m_workerRW;
     QList<DatabaseWorker*> m_workers;
     bool m_indexReady;
     int m_maxConcurrentThreads;
+    QTimer m_compactTimer;
 
     static Database* s_instance;
 
     friend class Tomahawk::Artist;
     friend class Tomahawk::Album;
+    friend class DatabaseWorker;
 };
 
 #endif // DATABASE_H
@@ -55,6 +55,14 @@ DatabaseCommand_AddFiles::files() const
 void
 DatabaseCommand_AddFiles::postCommitHook()
 {
+    // only push the names we touched to the search index, instead of rebuilding it
+    if ( m_dbi )
+    {
+        m_dbi->addToSearchIndex( "artist", m_artists );
+        m_dbi->addToSearchIndex( "album", m_albums );
+        m_dbi->addToSearchIndex( "track", m_tracks );
+    }
+
     if ( source().isNull() || source()->collection().isNull() )
     {
         qDebug() << "Source has gone offline, not emitting to GUI.";
@@ -82,16 +90,15 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
     qDebug() << Q_FUNC_INFO;
     Q_ASSERT( !source().isNull() );
 
-    TomahawkSqlQuery query_file = dbi->newquery();
-    TomahawkSqlQuery query_filejoin = dbi->newquery();
-    TomahawkSqlQuery query_trackattr = dbi->newquery();
-    TomahawkSqlQuery query_file_del = dbi->newquery();
-
-    query_file.prepare( "INSERT INTO file(source, url, size, mtime, md5, mimetype, duration, bitrate) VALUES (?, ?, ?, ?, ?, ?, ?, ?)" );
-    query_filejoin.prepare( "INSERT INTO file_join(file, artist, album, track, albumpos) VALUES (?, ?, ?, ?, ?)" );
-    query_trackattr.prepare( "INSERT INTO track_attributes(id, k, v) VALUES (?, ?, ?)" );
-    query_file_del.prepare( QString( "DELETE FROM file WHERE source %1 AND url = ?" )
-                               .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) ) );
+    TomahawkSqlQuery query_file = dbi->preparedQuery( "INSERT INTO file(source, url, size, mtime, md5, mimetype, duration, bitrate) VALUES (?, ?, ?, ?, ?, ?, ?, ?)" );
+    TomahawkSqlQuery query_filejoin = dbi->preparedQuery( "INSERT INTO file_join(file, artist, album, track, albumpos) VALUES (?, ?, ?, ?, ?)" );
+    TomahawkSqlQuery query_trackattr = dbi->preparedQuery( "INSERT INTO track_attributes(id, k, v) VALUES (?, ?, ?)" );
+    TomahawkSqlQuery query_file_del = dbi->preparedQuery( source()->isLocal() ? "DELETE FROM file WHERE source IS NULL AND url = ?"
+                                                                              : "DELETE FROM file WHERE source = ? AND url = ?" );
+    // the file_fts rows of deleted files go away by trigger
+    TomahawkSqlQuery query_fts;
+    if ( dbi->hasFullTextIndex() )
+        query_fts = dbi->preparedQuery( "INSERT INTO file_fts(docid, artist, album, track) VALUES (?, ?, ?, ?)" );
 
     int added = 0;
     QVariant srcid = source()->isLocal() ? QVariant( QVariant::Int ) : source()->id();
@@ -117,7 +124,9 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
         int year         = m.value( "year" ).toInt();
 
         int fileid = 0, artistid = 0, albumid = 0, trackid = 0;
-        query_file_del.bindValue( 0, url );
+        if ( !source()->isLocal() )
+            query_file_del.addBindValue( source()->id() );
+        query_file_del.addBindValue( url );
         query_file_del.exec();
 
         query_file.bindValue( 0, srcid );
@@ -170,11 +179,25 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
             continue;
         }
 
+        if ( dbi->hasFullTextIndex() )
+        {
+            query_fts.bindValue( 0, fileid );
+            query_fts.bindValue( 1, DatabaseImpl::sortname( artist ) );
+            query_fts.bindValue( 2, albumid > 0 ? DatabaseImpl::sortname( album ) : QVariant( QVariant::String ) );
+            query_fts.bindValue( 3, DatabaseImpl::sortname( track ) );
+            query_fts.exec();
+        }
+
         query_trackattr.bindValue( 0, trackid );
         query_trackattr.bindValue( 1, "releaseyear" );
         query_trackattr.bindValue( 2, year );
         query_trackattr.exec();
 
+        m_artists.insert( artistid, artist );
+        m_tracks.insert( trackid, track );
+        if ( albumid > 0 )
+            m_albums.insert( albumid, album );
+
 /*        QVariantMap attr;
         Tomahawk::query_ptr query = Tomahawk::Query::get( artist, track, album );
         attr["releaseyear"] = m.value( "year" );
@@ -207,6 +230,8 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
     }
     qDebug() << "Inserted" << added << "tracks to database";
 
+    m_dbi = dbi;
+
     if ( added )
         source()->updateIndexWhenSynced();
 
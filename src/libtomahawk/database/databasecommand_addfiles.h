@@ -35,11 +35,11 @@ Q_PROPERTY( QVariantList files READ files WRITE setFiles )
 
 public:
     explicit DatabaseCommand_AddFiles( QObject* parent = 0 )
-        : DatabaseCommandLoggable( parent )
+        : DatabaseCommandLoggable( parent ), m_dbi( 0 )
     {}
 
     explicit DatabaseCommand_AddFiles( const QList<QVariant>& files, const Tomahawk::source_ptr& source, QObject* parent = 0 )
-        : DatabaseCommandLoggable( parent ), m_files( files )
+        : DatabaseCommandLoggable( parent ), m_files( files ), m_dbi( 0 )
     {
         setSource( source );
     }
@@ -48,6 +48,7 @@ public:
 
     virtual void exec( DatabaseImpl* );
     virtual bool doesMutates() const { return true; }
+    virtual bool groupable() const { return true; }
     virtual void postCommitHook();
 
     QVariantList files() const;
@@ -60,6 +61,10 @@ signals:
 private:
     QVariantList m_files;
     QList<unsigned int> m_ids;
+
+    // names to add to the search index once they're committed
+    DatabaseImpl* m_dbi;
+    QMap< unsigned int, QString > m_artists, m_albums, m_tracks;
 };
 
 #endif // DATABASECOMMAND_ADDFILES_H
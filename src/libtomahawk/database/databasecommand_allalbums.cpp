@@ -23,7 +23,6 @@
 #include "artist.h"
 #include "databaseimpl.h"
 #include "source.h"
-#include "utils/tomahawkutils.h"
 #include "utils/logger.h"
 
 
@@ -51,9 +50,8 @@ DatabaseCommand_AllAlbums::setArtist( const Tomahawk::artist_ptr &artist )
 void
 DatabaseCommand_AllAlbums::execForArtist( DatabaseImpl* dbi )
 {
-    TomahawkSqlQuery query = dbi->newquery();
     QList<Tomahawk::album_ptr> al;
-    QString orderToken, sourceToken, filterToken, tables;
+    QString orderToken, sourceToken, filterToken;
 
     switch ( m_sortOrder )
     {
@@ -67,37 +65,27 @@ DatabaseCommand_AllAlbums::execForArtist( DatabaseImpl* dbi )
     if ( !m_collection.isNull() )
         sourceToken = QString( "AND file.source %1 " ).arg( m_collection->source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( m_collection->source()->id() ) );
 
-    if ( !m_filter.isEmpty() )
-    {
-        QString filtersql;
-        QStringList sl = m_filter.split( " ", QString::SkipEmptyParts );
-        foreach( QString s, sl )
-        {
-            filtersql += QString( " AND ( artist.name LIKE '%%1%' OR album.name LIKE '%%1%' OR track.name LIKE '%%1%' )" ).arg( TomahawkUtils::sqlEscape( s ) );
-        }
-
-        filterToken = QString( "AND artist.id = file_join.artist AND file_join.track = track.id %1" ).arg( filtersql );
-        tables = "artist, track, file, file_join";
-    }
-    else
-        tables = "file, file_join";
+    QVariantList filterBinds;
+    filterToken = dbi->filterCondition( "file.id", m_filter, filterBinds );
 
     QString sql = QString(
         "SELECT DISTINCT album.id, album.name "
-        "FROM %1 "
+        "FROM file, file_join "
         "LEFT OUTER JOIN album ON file_join.album = album.id "
         "WHERE file.id = file_join.file "
-        "AND file_join.artist = %2 "
-        "%3 %4 %5 %6 %7"
-        ).arg( tables )
-         .arg( m_artist->id() )
+        "AND file_join.artist = %1 "
+        "%2 %3 %4 %5 %6"
+        ).arg( dbi->resolveArtistId( m_artist.data() ) )
          .arg( sourceToken )
          .arg( filterToken )
          .arg( m_sortOrder > 0 ? QString( "ORDER BY %1" ).arg( orderToken ) : QString() )
          .arg( m_sortDescending ? "DESC" : QString() )
          .arg( m_amount > 0 ? QString( "LIMIT 0, %1" ).arg( m_amount ) : QString() );
 
+    TomahawkSqlQuery query = dbi->newquery();
     query.prepare( sql );
+    foreach ( const QVariant& value, filterBinds )
+        query.addBindValue( value );
     query.exec();
 
     while( query.next() )
@@ -23,7 +23,6 @@
 #include "artist.h"
 #include "databaseimpl.h"
 #include "source.h"
-#include "utils/tomahawkutils.h"
 #include "utils/logger.h"
 
 DatabaseCommand_AllArtists::DatabaseCommand_AllArtists( const Tomahawk::collection_ptr &collection, QObject *parent )
@@ -41,9 +40,8 @@ DatabaseCommand_AllArtists::~DatabaseCommand_AllArtists()
 void
 DatabaseCommand_AllArtists::exec( DatabaseImpl* dbi )
 {
-    TomahawkSqlQuery query = dbi->newquery();
     QList<Tomahawk::artist_ptr> al;
-    QString orderToken, sourceToken, filterToken, tables, joins;
+    QString orderToken, sourceToken, filterToken;
 
     switch ( m_sortOrder )
     {
@@ -57,38 +55,24 @@ DatabaseCommand_AllArtists::exec( DatabaseImpl* dbi )
     if ( !m_collection.isNull() )
         sourceToken = QString( "AND file.source %1" ).arg( m_collection->source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( m_collection->source()->id() ) );
 
-    if ( !m_filter.isEmpty() )
-    {
-        QString filtersql;
-        QStringList sl = m_filter.split( " ", QString::SkipEmptyParts );
-        foreach( QString s, sl )
-        {
-            filtersql += QString( " AND ( artist.name LIKE '%%1%' OR album.name LIKE '%%1%' OR track.name LIKE '%%1%' )" ).arg( TomahawkUtils::sqlEscape( s ) );
-        }
-
-        filterToken = QString( "AND file_join.track = track.id %1" ).arg( filtersql );
-        joins = "LEFT JOIN album ON album.id = file_join.album";
-        tables = "artist, track, file, file_join";
-    }
-    else
-        tables = "artist, file, file_join";
+    QVariantList filterBinds;
+    filterToken = dbi->filterCondition( "file.id", m_filter, filterBinds );
 
     QString sql = QString(
             "SELECT DISTINCT artist.id, artist.name "
-            "FROM %1 "
-            "%2 "
+            "FROM artist, file, file_join "
             "WHERE file.id = file_join.file "
             "AND file_join.artist = artist.id "
-            "%3 %4 %5 %6 %7"
-            ).arg( tables )
-             .arg( joins )
-             .arg( sourceToken )
+            "%1 %2 %3 %4 %5"
+            ).arg( sourceToken )
              .arg( filterToken )
              .arg( m_sortOrder > 0 ? QString( "ORDER BY %1" ).arg( orderToken ) : QString() )
              .arg( m_sortDescending ? "DESC" : QString() )
              .arg( m_amount > 0 ? QString( "LIMIT 0, %1" ).arg( m_amount ) : QString() );
 
-    query.prepare( sql );
+    TomahawkSqlQuery query = dbi->preparedQuery( sql );
+    foreach ( const QVariant& value, filterBinds )
+        query.addBindValue( value );
     query.exec();
 
     while( query.next() )
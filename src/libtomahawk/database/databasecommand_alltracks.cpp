@@ -30,7 +30,6 @@
 void
 DatabaseCommand_AllTracks::exec( DatabaseImpl* dbi )
 {
-    TomahawkSqlQuery query = dbi->newquery();
     QList<Tomahawk::query_ptr> ql;
 
     QString m_orderToken, sourceToken;
@@ -52,20 +51,38 @@ DatabaseCommand_AllTracks::exec( DatabaseImpl* dbi )
             break;
     }
 
+    // ids are bound rather than put into the sql, so the statement can be reused
+    QVariantList binds;
     if ( !m_collection.isNull() )
-        sourceToken = QString( "AND file.source %1" ).arg( m_collection->source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( m_collection->source()->id() ) );
+    {
+        if ( m_collection->source()->isLocal() )
+            sourceToken = "AND file.source IS NULL";
+        else
+        {
+            sourceToken = "AND file.source = ?";
+            binds << m_collection->source()->id();
+        }
+    }
 
     QString albumToken;
+    unsigned int albumId = 0;
     if ( m_album )
     {
-        if ( m_album->id() == 0 )
+        albumId = dbi->resolveAlbumId( m_album );
+        if ( albumId == 0 )
         {
             m_artist = m_album->artist().data();
             albumToken = QString( "AND album.id IS NULL" );
         }
         else
-            albumToken = QString( "AND album.id = %1" ).arg( m_album->id() );
+            albumToken = QString( "AND album.id = ?" );
     }
+    if ( m_artist )
+        binds << dbi->resolveArtistId( m_artist );
+    if ( albumId != 0 )
+        binds << albumId;
+    if ( m_amount > 0 )
+        binds << m_amount;
 
     QString sql = QString(
             "SELECT file.id, artist.name, album.name, track.name, file.size, "
@@ -80,13 +97,15 @@ DatabaseCommand_AllTracks::exec( DatabaseImpl* dbi )
             "%2 %3 "
             "%4 %5 %6"
             ).arg( sourceToken )
-             .arg( !m_artist ? QString() : QString( "AND artist.id = %1" ).arg( m_artist->id() ) )
+             .arg( !m_artist ? QString() : QString( "AND artist.id = ?" ) )
              .arg( !m_album ? QString() : albumToken )
              .arg( m_sortOrder > 0 ? QString( "ORDER BY %1" ).arg( m_orderToken ) : QString() )
              .arg( m_sortDescending ? "DESC" : QString() )
-             .arg( m_amount > 0 ? QString( "LIMIT 0, %1" ).arg( m_amount ) : QString() );
+             .arg( m_amount > 0 ? QString( "LIMIT 0, ?" ) : QString() );
 
-    query.prepare( sql );
+    TomahawkSqlQuery query = dbi->preparedQuery( sql );
+    foreach ( const QVariant& value, binds )
+        query.addBindValue( value );
     query.exec();
 
     while( query.next() )
@@ -133,10 +152,9 @@ DatabaseCommand_AllTracks::exec( DatabaseImpl* dbi )
         result->setScore( 1.0 );
         result->setCollection( s->collection() );
 
-        TomahawkSqlQuery attrQuery = dbi->newquery();
+        TomahawkSqlQuery attrQuery = dbi->preparedQuery( "SELECT k, v FROM track_attributes WHERE id = ?" );
         QVariantMap attr;
 
-        attrQuery.prepare( "SELECT k, v FROM track_attributes WHERE id = ?" );
         attrQuery.bindValue( 0, result->trackId() );
         attrQuery.exec();
         while ( attrQuery.next() )
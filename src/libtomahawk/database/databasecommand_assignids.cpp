@@ -0,0 +1,60 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "databasecommand_assignids.h"
+
+#include "databaseimpl.h"
+#include "artist.h"
+#include "album.h"
+#include "utils/logger.h"
+
+
+DatabaseCommand_AssignIds::DatabaseCommand_AssignIds( const Tomahawk::album_ptr& album, bool autoCreate, QObject* parent )
+    : DatabaseCommand( parent )
+    , m_artist( album->artist() )
+    , m_album( album )
+    , m_autoCreate( autoCreate )
+    , m_artistId( 0 )
+    , m_albumId( 0 )
+{
+}
+
+
+void
+DatabaseCommand_AssignIds::exec( DatabaseImpl* dbi )
+{
+    m_artistId = m_artist->id();
+    if ( m_artistId == 0 )
+        m_artistId = qMax( 0, dbi->artistId( m_artist->name(), m_autoCreate ) );
+
+    if ( !m_album.isNull() && m_album->id() == 0 && m_artistId > 0 )
+        m_albumId = qMax( 0, dbi->albumId( m_artistId, m_album->name(), m_autoCreate ) );
+}
+
+
+void
+DatabaseCommand_AssignIds::postCommitHook()
+{
+    // ids we created only exist once committed. setId() also ends the lookup
+    // when nothing was found, so whoever waits on it goes ahead then.
+    if ( m_artist->id() == 0 )
+        Tomahawk::Artist::setId( m_artist, m_artistId );
+
+    if ( !m_album.isNull() && m_album->id() == 0 )
+        Tomahawk::Album::setId( m_album, m_albumId );
+}
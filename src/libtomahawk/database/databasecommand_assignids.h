@@ -0,0 +1,60 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_ASSIGNIDS_H
+#define DATABASECOMMAND_ASSIGNIDS_H
+
+#include "databasecommand.h"
+#include "typedefs.h"
+
+#include "dllmacro.h"
+
+/**
+ * Looks up, or creates, the database ids of an artist or album that was
+ * handed out without one because its name wasn't in the IdCache yet.
+ */
+class DLLEXPORT DatabaseCommand_AssignIds : public DatabaseCommand
+{
+Q_OBJECT
+public:
+    explicit DatabaseCommand_AssignIds( const Tomahawk::artist_ptr& artist, bool autoCreate, QObject* parent = 0 )
+        : DatabaseCommand( parent )
+        , m_artist( artist )
+        , m_autoCreate( autoCreate )
+        , m_artistId( 0 )
+        , m_albumId( 0 )
+    {}
+
+    explicit DatabaseCommand_AssignIds( const Tomahawk::album_ptr& album, bool autoCreate, QObject* parent = 0 );
+
+    virtual void exec( DatabaseImpl* );
+    virtual void postCommitHook();
+
+    virtual bool doesMutates() const { return m_autoCreate; }
+    virtual QString commandname() const { return "assignids"; }
+
+private:
+    Tomahawk::artist_ptr m_artist;
+    Tomahawk::album_ptr m_album;
+    bool m_autoCreate;
+
+    unsigned int m_artistId;
+    unsigned int m_albumId;
+};
+
+#endif // DATABASECOMMAND_ASSIGNIDS_H
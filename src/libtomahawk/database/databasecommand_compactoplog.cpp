@@ -0,0 +1,203 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "databasecommand_compactoplog.h"
+
+#include <QHash>
+#include <QSet>
+
+#include <qjson/parser.h>
+#include <qjson/serializer.h>
+
+#include "databaseimpl.h"
+#include "tomahawksqlquery.h"
+#include "utils/logger.h"
+
+
+static QVariantMap
+parseOp( const QByteArray& json, bool compressed )
+{
+    QJson::Parser parser;
+    bool ok;
+    return parser.parse( compressed ? qUncompress( json ) : json, &ok ).toMap();
+}
+
+
+QVariantMap
+DatabaseCommand_CompactOplog::payload( DatabaseImpl* dbi, qlonglong id )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( "SELECT json, compressed FROM oplog WHERE id = ?" );
+    query.addBindValue( id );
+    query.exec();
+
+    if ( !query.next() )
+        return QVariantMap();
+
+    return parseOp( query.value( 0 ).toByteArray(), query.value( 1 ).toBool() );
+}
+
+
+void
+DatabaseCommand_CompactOplog::exec( DatabaseImpl* dbi )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.exec( "SELECT MAX(id) FROM oplog WHERE source IS NULL" );
+    const qlonglong newest = query.next() ? query.value( 0 ).toLongLong() : 0;
+
+    query.exec( "SELECT v FROM settings WHERE k = 'oplog_compacted'" );
+    if ( newest == 0 || ( query.next() && query.value( 0 ).toLongLong() == newest ) )
+    {
+        tDebug() << "No new ops since the last oplog compaction";
+        return;
+    }
+
+    // which add op (still) holds a file, by file id
+    QHash< uint, qlonglong > addedBy;
+    QHash< qlonglong, int > addCounts;
+    QHash< qlonglong, QSet< uint > > removedFiles;
+    QHash< QString, QList< qlonglong > > playlistOps;
+    QHash< QString, qlonglong > lastLove;
+    QSet< qlonglong > dead;
+
+    TomahawkSqlQuery ops = dbi->newquery();
+    ops.setForwardOnly( true );
+    ops.prepare( "SELECT id, command, json, compressed FROM oplog "
+                 "WHERE source IS NULL AND id <= ? AND json != '' "
+                 "AND command IN ( 'addfiles', 'deletefiles', 'createplaylist', 'createdynamicplaylist', "
+                                  "'setplaylistrevision', 'setdynamicplaylistrevision', 'renameplaylist', "
+                                  "'deleteplaylist', 'deletedynamicplaylist', 'socialaction' ) "
+                 "ORDER BY id ASC" );
+    ops.addBindValue( newest );
+    ops.exec();
+
+    while ( ops.next() )
+    {
+        const qlonglong id = ops.value( 0 ).toLongLong();
+        const QString command = ops.value( 1 ).toString();
+        const QVariantMap op = parseOp( ops.value( 2 ).toByteArray(), ops.value( 3 ).toBool() );
+
+        if ( command == "addfiles" )
+        {
+            const QVariantList files = op.value( "files" ).toList();
+            foreach ( const QVariant& file, files )
+                addedBy.insert( file.toMap().value( "url" ).toString().toUInt(), id );
+
+            addCounts.insert( id, files.count() );
+        }
+        else if ( command == "deletefiles" )
+        {
+            if ( op.value( "deleteAll" ).toBool() )
+            {
+                QHash< uint, qlonglong >::const_iterator it = addedBy.constBegin();
+                for ( ; it != addedBy.constEnd(); ++it )
+                    removedFiles[ it.value() ].insert( it.key() );
+
+                addedBy.clear();
+            }
+            else
+            {
+                foreach ( const QVariant& v, op.value( "ids" ).toList() )
+                {
+                    const uint fileId = v.toString().toUInt();
+                    if ( addedBy.contains( fileId ) )
+                        removedFiles[ addedBy.take( fileId ) ].insert( fileId );
+                }
+            }
+        }
+        else if ( command == "createplaylist" || command == "createdynamicplaylist" )
+        {
+            // creates aren't collected, see below
+            continue;
+        }
+        else if ( command == "deleteplaylist" || command == "deletedynamicplaylist" )
+        {
+            // Create and delete are both kept: peers that got the playlist already need
+            // the delete, and new peers must never see a delete for a playlist they
+            // don't have. Only the revisions and renames in between go.
+            foreach ( qlonglong opId, playlistOps.take( op.value( "playlistguid" ).toString() ) )
+                dead << opId;
+        }
+        else if ( command == "socialaction" )
+        {
+            if ( op.value( "action" ).toString() != "Love" )
+                continue;
+
+            const QString key = op.value( "artist" ).toString() + '\t' + op.value( "track" ).toString();
+            if ( lastLove.contains( key ) )
+                dead << lastLove.value( key );
+            lastLove.insert( key, id );
+        }
+        else
+        {
+            playlistOps[ op.value( "playlistguid" ).toString() ] << id;
+        }
+    }
+
+    TomahawkSqlQuery update = dbi->newquery();
+    update.prepare( "UPDATE oplog SET json = ?, compressed = ? WHERE id = ?" );
+
+    // shrink add ops that still hold some of their files
+    QJson::Serializer serializer;
+    int shrunk = 0;
+    QHash< qlonglong, QSet< uint > >::const_iterator it = removedFiles.constBegin();
+    for ( ; it != removedFiles.constEnd(); ++it )
+    {
+        if ( it.value().count() >= addCounts.value( it.key() ) )
+        {
+            dead << it.key();
+            continue;
+        }
+
+        QVariantMap op = payload( dbi, it.key() );
+        QVariantList files;
+        foreach ( const QVariant& file, op.value( "files" ).toList() )
+        {
+            if ( !it.value().contains( file.toMap().value( "url" ).toString().toUInt() ) )
+                files << file;
+        }
+        op.insert( "files", files );
+
+        // same as DatabaseWorker::logOp does
+        QByteArray ba = serializer.serialize( op );
+        const bool compressed = ( ba.length() >= 512 );
+        if ( compressed )
+            ba = qCompress( ba, 9 );
+
+        update.addBindValue( ba );
+        update.addBindValue( compressed );
+        update.addBindValue( it.key() );
+        update.exec();
+        shrunk++;
+    }
+
+    TomahawkSqlQuery empty = dbi->newquery();
+    empty.prepare( "UPDATE oplog SET json = '', compressed = 0 WHERE id = ?" );
+    foreach ( qlonglong id, dead )
+    {
+        empty.addBindValue( id );
+        empty.exec();
+    }
+
+    query.prepare( "INSERT OR REPLACE INTO settings(k, v) VALUES('oplog_compacted', ?)" );
+    query.addBindValue( newest );
+    query.exec();
+
+    tLog() << "Compacted oplog: emptied" << dead.count() << "ops, shrunk" << shrunk;
+}
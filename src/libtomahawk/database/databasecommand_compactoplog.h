@@ -0,0 +1,53 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_COMPACTOPLOG_H
+#define DATABASECOMMAND_COMPACTOPLOG_H
+
+#include <QVariantMap>
+
+#include "databasecommand.h"
+#include "dllmacro.h"
+
+/*
+    Drops what later ops made obsolete from our own oplog:
+    - files that a later deletefiles removed again, from their addfiles op
+    - all ops of playlists that got deleted
+    - love/unlove social actions that a later one for the same track replaced
+
+    Peers hold guids of our ops as the point to continue syncing from, so
+    ops are never removed. Their payload is emptied instead, which makes
+    DatabaseCommand_loadOps skip them.
+*/
+class DLLEXPORT DatabaseCommand_CompactOplog : public DatabaseCommand
+{
+Q_OBJECT
+public:
+    explicit DatabaseCommand_CompactOplog( QObject* parent = 0 )
+        : DatabaseCommand( parent )
+    {}
+
+    virtual QString commandname() const { return "compactoplog"; }
+    virtual bool doesMutates() const { return true; }
+    virtual void exec( DatabaseImpl* db );
+
+private:
+    QVariantMap payload( DatabaseImpl* dbi, qlonglong id );
+};
+
+#endif // DATABASECOMMAND_COMPACTOPLOG_H
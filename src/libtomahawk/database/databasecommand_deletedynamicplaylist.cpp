@@ -62,10 +62,10 @@ DatabaseCommand_DeleteDynamicPlaylist::postCommitHook()
     if( playlist.isNull() )
         playlist = source()->collection()->station( m_playlistguid );
 
-    qDebug() << "Just tried to load playlist for deletion:" << m_playlistguid << "Did we get a null one?" << playlist.isNull() << "is it a station?" << (playlist->mode() == OnDemand);
-    Q_ASSERT( !playlist.isNull() );
-
-    playlist->reportDeleted( playlist );
+    qDebug() << "Just tried to load playlist for deletion:" << m_playlistguid << "Did we get a null one?" << playlist.isNull();
+    // null e.g. for a peer's delete of a playlist we never got
+    if ( !playlist.isNull() )
+        playlist->reportDeleted( playlist );
 
     if( source()->isLocal() )
         Servent::instance()->triggerDBSync();
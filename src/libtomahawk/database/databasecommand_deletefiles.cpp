@@ -37,6 +37,13 @@ using namespace Tomahawk;
 void
 DatabaseCommand_DeleteFiles::postCommitHook()
 {
+    if ( m_dbi )
+    {
+        m_dbi->removeFromSearchIndex( "artist", m_orphanArtists );
+        m_dbi->removeFromSearchIndex( "album", m_orphanAlbums );
+        m_dbi->removeFromSearchIndex( "track", m_orphanTracks );
+    }
+
     if ( !m_files.count() )
         return;
 
@@ -58,6 +65,25 @@ DatabaseCommand_DeleteFiles::postCommitHook()
 }
 
 
+QList< unsigned int >
+DatabaseCommand_DeleteFiles::findOrphans( DatabaseImpl* dbi, const QString& table, const QSet< unsigned int >& ids )
+{
+    QList< unsigned int > orphans;
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( QString( "SELECT 1 FROM file_join WHERE %1 = ? LIMIT 1" ).arg( table ) );
+
+    foreach ( unsigned int id, ids )
+    {
+        query.bindValue( 0, id );
+        query.exec();
+        if ( !query.next() )
+            orphans << id;
+    }
+
+    return orphans;
+}
+
+
 void
 DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
 {
@@ -73,8 +99,11 @@ DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
         {
             tDebug() << "Deleting" << m_dir.path() << "from db for localsource" << srcid;
             TomahawkSqlQuery dirquery = dbi->newquery();
-            QString path( "file://" + m_dir.canonicalPath() + "/%" );
-            dirquery.prepare( QString( "SELECT id, url FROM file WHERE source IS NULL AND url LIKE '%1'" ).arg( TomahawkUtils::sqlEscape( path ) ) );
+            QString path( "file://" + m_dir.canonicalPath() + "/" );
+            dirquery.prepare( "SELECT id, url FROM file WHERE source IS NULL AND url >= ? AND url < ? AND url NOT GLOB ?" );
+            dirquery.addBindValue( path );
+            dirquery.addBindValue( DatabaseImpl::prefixEnd( path ) );
+            dirquery.addBindValue( DatabaseImpl::globEscape( path ) + "*/*" );
             dirquery.exec();
 
             while ( dirquery.next() )
@@ -142,33 +171,50 @@ DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
             m_files << QString( "servent://%1\t%2" ).arg( source()->userName() ).arg( id.toString() );
     }
 
+    QString fileFilter;
     if ( m_deleteAll )
     {
         if ( !m_ids.isEmpty() )
         {
-            delquery.prepare( QString( "DELETE FROM file WHERE source %1" )
-                        .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) ) );
-
-            delquery.exec();
+            fileFilter = QString( "source %1" )
+                            .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) );
         }
     }
     else if ( !m_ids.isEmpty() )
     {
-        delquery.prepare( QString( "DELETE FROM file WHERE source %1 AND %2 IN ( ? )" )
-                             .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
-                             .arg( source()->isLocal() ? "id" : "url"  ) );
-
         QString idstring;
         foreach( const QVariant& id, m_ids )
             idstring.append( id.toString() + ", " );
         idstring.chop( 2 ); //remove the trailing ", "
 
-        delquery.prepare( QString( "DELETE FROM file WHERE source %1 AND %2 IN ( %3 )" )
-                             .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
-                             .arg( source()->isLocal() ? "id" : "url"  )
-                             .arg( idstring ) );
+        fileFilter = QString( "source %1 AND %2 IN ( %3 )" )
+                        .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
+                        .arg( source()->isLocal() ? "id" : "url"  )
+                        .arg( idstring );
+    }
 
+    if ( !fileFilter.isEmpty() )
+    {
+        // remember which names the deleted files referred to, so we can drop the ones
+        // that are left without any files from the search index afterwards
+        QSet< unsigned int > artists, albums, tracks;
+        TomahawkSqlQuery namequery = dbi->newquery();
+        namequery.exec( QString( "SELECT DISTINCT artist, album, track FROM file_join WHERE file IN ( SELECT id FROM file WHERE %1 )" ).arg( fileFilter ) );
+        while ( namequery.next() )
+        {
+            artists << namequery.value( 0 ).toUInt();
+            if ( !namequery.value( 1 ).isNull() )
+                albums << namequery.value( 1 ).toUInt();
+            tracks << namequery.value( 2 ).toUInt();
+        }
+
+        delquery.prepare( QString( "DELETE FROM file WHERE %1" ).arg( fileFilter ) );
         delquery.exec();
+
+        m_orphanArtists = findOrphans( dbi, "artist", artists );
+        m_orphanAlbums = findOrphans( dbi, "album", albums );
+        m_orphanTracks = findOrphans( dbi, "track", tracks );
+        m_dbi = dbi;
     }
 
     emit done( m_files, source()->collection() );
@@ -21,6 +21,7 @@
 
 #include <QObject>
 #include <QDir>
+#include <QSet>
 #include <QVariantMap>
 
 #include "database/databasecommandloggable.h"
@@ -38,23 +39,23 @@ Q_PROPERTY( bool deleteAll READ deleteAll WRITE setDeleteAll )
 
 public:
     explicit DatabaseCommand_DeleteFiles( QObject* parent = 0 )
-        : DatabaseCommandLoggable( parent )
+        : DatabaseCommandLoggable( parent ), m_dbi( 0 )
     {}
 
     explicit DatabaseCommand_DeleteFiles( const Tomahawk::source_ptr& source, QObject* parent = 0 )
-    : DatabaseCommandLoggable( parent ), m_deleteAll( true )
+    : DatabaseCommandLoggable( parent ), m_deleteAll( true ), m_dbi( 0 )
     {
         setSource( source );
     }
 
     explicit DatabaseCommand_DeleteFiles( const QDir& dir, const Tomahawk::source_ptr& source, QObject* parent = 0 )
-    : DatabaseCommandLoggable( parent ), m_dir( dir ), m_deleteAll( false )
+    : DatabaseCommandLoggable( parent ), m_dir( dir ), m_deleteAll( false ), m_dbi( 0 )
     {
         setSource( source );
     }
 
     explicit DatabaseCommand_DeleteFiles( const QVariantList& ids, const Tomahawk::source_ptr& source, QObject* parent = 0 )
-    : DatabaseCommandLoggable( parent ), m_ids( ids ), m_deleteAll( false )
+    : DatabaseCommandLoggable( parent ), m_ids( ids ), m_deleteAll( false ), m_dbi( 0 )
     {
         setSource( source );
     }
@@ -78,10 +79,16 @@ signals:
     void notify( const QList<unsigned int>& ids );
 
 private:
+    QList< unsigned int > findOrphans( DatabaseImpl* dbi, const QString& table, const QSet< unsigned int >& ids );
+
     QStringList m_files;
     QDir m_dir;
     QVariantList m_ids;
     bool m_deleteAll;
+
+    // names to drop from the search index once the deletion is committed
+    DatabaseImpl* m_dbi;
+    QList< unsigned int > m_orphanArtists, m_orphanAlbums, m_orphanTracks;
 };
 
 #endif // DATABASECOMMAND_DELETEFILES_H
@@ -60,9 +60,13 @@ DatabaseCommand_DeletePlaylist::postCommitHook()
     }
 
     playlist_ptr playlist = source()->collection()->playlist( m_playlistguid );
-    Q_ASSERT( !playlist.isNull() );
-
-    playlist->reportDeleted( playlist );
+    if ( playlist.isNull() )
+    {
+        // e.g. a peer's delete for a playlist we never got
+        tDebug() << "Deleted playlist unknown, not emitting to GUI:" << m_playlistguid;
+    }
+    else
+        playlist->reportDeleted( playlist );
 
     if( source()->isLocal() )
         Servent::instance()->triggerDBSync();
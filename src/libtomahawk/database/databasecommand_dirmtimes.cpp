@@ -63,9 +63,13 @@ DatabaseCommand_DirMtimes::execSelectPath( DatabaseImpl *dbi, const QDir& path,
     TomahawkSqlQuery query = dbi->newquery();
     query.prepare( QString( "SELECT name, mtime "
                             "FROM dirs_scanned "
-                            "WHERE name LIKE :prefix" ) );
+                            "WHERE name = :dir "
+                            "OR ( name >= :prefix AND name < :prefixEnd )" ) );
 
-    query.bindValue( ":prefix", path.canonicalPath() + "%" );
+    const QString prefix = path.canonicalPath() + "/";
+    query.bindValue( ":dir", path.canonicalPath() );
+    query.bindValue( ":prefix", prefix );
+    query.bindValue( ":prefixEnd", DatabaseImpl::prefixEnd( prefix ) );
     query.exec();
 
     while( query.next() )
@@ -78,8 +82,19 @@ DatabaseCommand_DirMtimes::execUpdate( DatabaseImpl* dbi )
 {
     qDebug() << "Saving mtimes...";
     TomahawkSqlQuery query = dbi->newquery();
-    query.exec( "DELETE FROM dirs_scanned" );
-    query.prepare( "INSERT INTO dirs_scanned(name, mtime) VALUES(?, ?)" );
+    if( m_replace )
+        query.exec( "DELETE FROM dirs_scanned" );
+
+    query.prepare( "DELETE FROM dirs_scanned WHERE name = ? OR ( name >= ? AND name < ? )" );
+    foreach( const QString& dir, m_toremove )
+    {
+        query.bindValue( 0, dir );
+        query.bindValue( 1, dir + "/" );
+        query.bindValue( 2, DatabaseImpl::prefixEnd( dir + "/" ) );
+        query.exec();
+    }
+
+    query.prepare( "INSERT OR REPLACE INTO dirs_scanned(name, mtime) VALUES(?, ?)" );
 
     foreach( const QString& k, m_tosave.keys() )
     {
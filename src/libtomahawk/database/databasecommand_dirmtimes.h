@@ -36,15 +36,20 @@ Q_OBJECT
 
 public:
     explicit DatabaseCommand_DirMtimes( const QString& prefix = QString(), QObject* parent = 0 )
-        : DatabaseCommand( parent ), m_prefix( prefix ), m_update( false )
+        : DatabaseCommand( parent ), m_prefix( prefix ), m_update( false ), m_replace( false )
     {}
 
     explicit DatabaseCommand_DirMtimes( const QStringList& prefixes, QObject* parent = 0 )
-    : DatabaseCommand( parent ), m_prefixes( prefixes ), m_update( false )
+    : DatabaseCommand( parent ), m_prefixes( prefixes ), m_update( false ), m_replace( false )
     {}
 
     explicit DatabaseCommand_DirMtimes( QMap<QString, unsigned int> tosave, QObject* parent = 0 )
-        : DatabaseCommand( parent ), m_update( true ), m_tosave( tosave )
+        : DatabaseCommand( parent ), m_update( true ), m_replace( true ), m_tosave( tosave )
+    {}
+
+    // keeps all other dirs, removes the given ones including everything below them
+    explicit DatabaseCommand_DirMtimes( QMap<QString, unsigned int> tosave, const QStringList& toremove, QObject* parent = 0 )
+        : DatabaseCommand( parent ), m_update( true ), m_replace( false ), m_tosave( tosave ), m_toremove( toremove )
     {}
 
     virtual void exec( DatabaseImpl* );
@@ -64,7 +69,9 @@ private:
     QString m_prefix;
     QStringList m_prefixes;
     bool m_update;
+    bool m_replace;
     QMap<QString, unsigned int> m_tosave;
+    QStringList m_toremove;
 };
 
 #endif // DATABASECOMMAND_DIRMTIMES_H
@@ -36,18 +36,22 @@ DatabaseCommand_FileMtimes::execSelect( DatabaseImpl* dbi )
 {
     qDebug() << Q_FUNC_INFO;
     //FIXME: If ever needed for a non-local source this will have to be fixed/updated
-    QMap< QString, QMap< unsigned int, unsigned int > > mtimes;
-    TomahawkSqlQuery query = dbi->newquery();
-    if( m_prefix.isEmpty() && m_prefixes.isEmpty() )
+    FileMtimes mtimes;
+    if( !m_dirs.isEmpty() )
+    {
+        foreach( const QString& dir, m_dirs )
+            execSelectDir( dbi, dir, mtimes );
+        foreach( const QString& path, m_prefixes )
+            execSelectPath( dbi, path, mtimes );
+    }
+    else if( m_prefix.isEmpty() && m_prefixes.isEmpty() )
     {
+        // ordered by url, the files of each dir come in sorted already
+        TomahawkSqlQuery query = dbi->newquery();
+        query.setForwardOnly( true );
         QString limit( m_checkonly ? QString( " LIMIT 1" ) : QString() );
-        query.exec( QString( "SELECT url, id, mtime FROM file WHERE source IS NULL%1" ).arg( limit ) );
-        while( query.next() )
-        {
-            QMap< unsigned int, unsigned int > map;
-            map.insert( query.value( 1 ).toUInt(), query.value( 2 ).toUInt() );
-            mtimes.insert( query.value( 0 ).toString(), map );
-        }
+        query.exec( QString( "SELECT url, id, mtime FROM file WHERE source IS NULL ORDER BY url%1" ).arg( limit ) );
+        readRows( query, mtimes );
     }
     else if( m_prefixes.isEmpty() )
         execSelectPath( dbi, m_prefix, mtimes );
@@ -58,25 +62,58 @@ DatabaseCommand_FileMtimes::execSelect( DatabaseImpl* dbi )
         foreach( QString path, m_prefixes )
             execSelectPath( dbi, path, mtimes );
     }
+
+    mtimes.squeeze();
     emit done( mtimes );
 }
 
+
+void
+DatabaseCommand_FileMtimes::readRows( TomahawkSqlQuery& query, FileMtimes& mtimes )
+{
+    // rows go straight into the compact store, we never hold all the urls at once
+    while( query.next() )
+        mtimes.insert( query.value( 0 ).toString(), query.value( 1 ).toUInt(), query.value( 2 ).toUInt() );
+}
+
+
 void
-DatabaseCommand_FileMtimes::execSelectPath( DatabaseImpl *dbi, const QDir& path, QMap<QString, QMap< unsigned int, unsigned int > > &mtimes )
+DatabaseCommand_FileMtimes::execSelectPath( DatabaseImpl *dbi, const QDir& path, FileMtimes& mtimes )
 {
     TomahawkSqlQuery query = dbi->newquery();
+    query.setForwardOnly( true );
     query.prepare( QString( "SELECT url, id, mtime "
                             "FROM file "
                             "WHERE source IS NULL "
-                            "AND url LIKE :prefix" ) );
+                            "AND url >= :prefix AND url < :prefixEnd" ) );
 
-    query.bindValue( ":prefix", "file://" + path.canonicalPath() + "%" );
+    // the directory may be gone already, in which case there's no canonical path for it
+    const QString dir = path.exists() ? path.canonicalPath() : QDir::cleanPath( path.path() );
+    const QString prefix = "file://" + dir + "/";
+    query.bindValue( ":prefix", prefix );
+    query.bindValue( ":prefixEnd", DatabaseImpl::prefixEnd( prefix ) );
     query.exec();
 
-    while( query.next() )
-    {
-        QMap< unsigned int, unsigned int > map;
-        map.insert( query.value( 1 ).toUInt(), query.value( 2 ).toUInt() );
-        mtimes.insert( query.value( 0 ).toString(), map );
-    }
+    readRows( query, mtimes );
+}
+
+
+void
+DatabaseCommand_FileMtimes::execSelectDir( DatabaseImpl *dbi, const QString& dir, FileMtimes& mtimes )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.setForwardOnly( true );
+    query.prepare( QString( "SELECT url, id, mtime "
+                            "FROM file "
+                            "WHERE source IS NULL "
+                            "AND url >= :prefix AND url < :prefixEnd "
+                            "AND url NOT GLOB :subdirs" ) );
+
+    const QString prefix = "file://" + QDir::cleanPath( dir ) + "/";
+    query.bindValue( ":prefix", prefix );
+    query.bindValue( ":prefixEnd", DatabaseImpl::prefixEnd( prefix ) );
+    query.bindValue( ":subdirs", DatabaseImpl::globEscape( prefix ) + "*/*" );
+    query.exec();
+
+    readRows( query, mtimes );
 }
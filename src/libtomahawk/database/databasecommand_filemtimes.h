@@ -25,9 +25,12 @@
 #include <QDir>
 
 #include "databasecommand.h"
+#include "filemtimes.h"
 
 #include "dllmacro.h"
 
+class TomahawkSqlQuery;
+
 // Not loggable, mtimes only used to speed up our local scanner.
 
 class DLLEXPORT DatabaseCommand_FileMtimes : public DatabaseCommand
@@ -43,6 +46,11 @@ public:
     : DatabaseCommand( parent ), m_prefixes( prefixes ), m_checkonly( false )
     {}
 
+    // only the files directly inside each of dirs, plus everything below prefixes
+    explicit DatabaseCommand_FileMtimes( const QStringList& dirs, const QStringList& prefixes, QObject* parent = 0 )
+    : DatabaseCommand( parent ), m_prefixes( prefixes ), m_dirs( dirs ), m_checkonly( false )
+    {}
+
     //NOTE: when this is called we actually ignore the boolean flag; it's just used to give us the right constructor
     explicit DatabaseCommand_FileMtimes( bool /*checkonly*/, QObject* parent = 0 )
     : DatabaseCommand( parent ), m_checkonly( true )
@@ -53,15 +61,18 @@ public:
     virtual QString commandname() const { return "filemtimes"; }
 
 signals:
-    void done( const QMap< QString, QMap< unsigned int, unsigned int > >& );
+    void done( const FileMtimes& );
 
 public slots:
 
 private:
-    void execSelectPath( DatabaseImpl *dbi, const QDir& path, QMap< QString, QMap< unsigned int, unsigned int > > &mtimes );
+    void execSelectPath( DatabaseImpl *dbi, const QDir& path, FileMtimes& mtimes );
+    void execSelectDir( DatabaseImpl *dbi, const QString& dir, FileMtimes& mtimes );
+    void readRows( TomahawkSqlQuery& query, FileMtimes& mtimes );
     void execSelect( DatabaseImpl* dbi );
     QString m_prefix;
     QStringList m_prefixes;
+    QStringList m_dirs;
     bool m_checkonly;
 };
 
@@ -23,6 +23,9 @@
 #include "source.h"
 #include "utils/logger.h"
 
+// a chunk also ends once its payloads add up to this many bytes
+#define MAX_CHUNK_BYTES 4194304
+
 
 void
 DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
@@ -40,26 +43,70 @@ DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
         {
             tLog() << "Unknown oplog guid, requested, not replying:" << m_since;
             Q_ASSERT( false );
-            emit done( m_since, m_since, ops );
+            emit done( m_since, m_since, ops, false );
             return;
         }
     }
 
+    const QString sourceFilter = source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() );
+    const bool snapshot = m_snapshot && source()->isLocal();
+
+    if ( snapshot && m_checkpoint.isEmpty() )
+    {
+        // the snapshot stands for everything up to the newest op, so that's
+        // where the peer continues from next time. Singleton ops get replaced
+        // in the log, so they can't serve as that point
+        TomahawkSqlQuery newest = dbi->newquery();
+        newest.setForwardOnly( true );
+        newest.exec( QString( "SELECT guid, singleton FROM oplog WHERE source %1 ORDER BY id DESC" ).arg( sourceFilter ) );
+        while ( newest.next() )
+        {
+            if ( newest.value( 1 ).toBool() )
+                continue;
+
+            m_checkpoint = newest.value( 0 ).toString();
+            break;
+        }
+
+        emit checkpoint( m_checkpoint );
+        if ( m_checkpoint.isEmpty() )
+        {
+            emit done( m_since, m_since, ops, false );
+            return;
+        }
+    }
+
+    // compacted ops are left in place with an empty payload, so that peers
+    // can still continue from their guids
     TomahawkSqlQuery query = dbi->newquery();
+    query.setForwardOnly( true );
     query.prepare( QString(
                    "SELECT guid, command, json, compressed, singleton "
                    "FROM oplog "
-                   "WHERE source %1 "
+                   "WHERE source %1 %2"
                    "AND id > coalesce((SELECT id FROM oplog WHERE guid = ?),0) "
+                   "AND json != '' "
                    "ORDER BY id ASC"
-                   ).arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
+                   ).arg( sourceFilter )
+                    .arg( snapshot ? "AND command NOT IN ( 'addfiles', 'deletefiles' ) "
+                                     "AND id <= (SELECT id FROM oplog WHERE guid = ?) " : "" )
                   );
+    if ( snapshot )
+        query.addBindValue( m_checkpoint );
     query.addBindValue( m_since );
     query.exec();
 
     QString lastguid = m_since;
+    int bytes = 0;
+    bool more = false;
     while( query.next() )
     {
+        if ( ( m_limit > 0 && ops.count() >= m_limit ) || bytes >= MAX_CHUNK_BYTES )
+        {
+            more = true;
+            break;
+        }
+
         dbop_ptr op( new DBOp );
         op->guid = query.value( 0 ).toString();
         op->command = query.value( 1 ).toString();
@@ -68,9 +115,10 @@ DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
         op->singleton = query.value( 4 ).toBool();
 
         lastguid = op->guid;
+        bytes += op->payload.length();
         ops << op;
     }
 
 //    qDebug() << "Loaded" << ops.length() << "ops from db";
-    emit done( m_since, lastguid, ops );
+    emit done( m_since, lastguid, ops, more );
 }
@@ -25,12 +25,18 @@
 
 #include "dllmacro.h"
 
+/*
+    Loads the ops of a source after a given guid, a chunk at a time: done()
+    tells whether there are more, which the caller fetches with another
+    command starting at the chunk's last guid. Ops that were compacted away
+    are skipped.
+*/
 class DLLEXPORT DatabaseCommand_loadOps : public DatabaseCommand
 {
 Q_OBJECT
 public:
     explicit DatabaseCommand_loadOps( const Tomahawk::source_ptr& src, QString since, QObject* parent = 0 )
-        : DatabaseCommand( src ), m_since( since )
+        : DatabaseCommand( src ), m_since( since ), m_limit( 0 ), m_snapshot( false )
     {
         Q_UNUSED( parent );
     }
@@ -39,11 +45,27 @@ public:
     virtual bool doesMutates() const { return false; }
     virtual QString commandname() const { return "loadops"; }
 
+    // most ops to load in one go, 0 for no limit
+    void setLimit( int limit ) { m_limit = limit; }
+
+    // For peers that get a snapshot of the collection: skip the addfiles and
+    // deletefiles history and stop at the snapshot's checkpoint. If that isn't
+    // known yet it is looked up and announced with checkpoint() first.
+    void setSnapshot( bool snapshot, const QString& checkpoint = QString() )
+    {
+        m_snapshot = snapshot;
+        m_checkpoint = checkpoint;
+    }
+
 signals:
-    void done( QString sinceguid, QString lastguid, QList< dbop_ptr > ops );
+    void checkpoint( const QString& guid );
+    void done( QString sinceguid, QString lastguid, QList< dbop_ptr > ops, bool more );
 
 private:
     QString m_since; // guid to load from
+    int m_limit;
+    bool m_snapshot;
+    QString m_checkpoint;
 };
 
 #endif // DATABASECOMMAND_LOADOPS_H
@@ -21,10 +21,13 @@
 #include <QSqlQuery>
 
 #include "databaseimpl.h"
+#include "playlistrevisionstore.h"
 #include "query.h"
-#include "qjson/parser.h"
 #include "utils/logger.h"
 
+// playlist items we look up per query
+#define ITEM_BATCH_SIZE 100
+
 using namespace Tomahawk;
 
 
@@ -42,7 +45,7 @@ void
 DatabaseCommand_LoadPlaylistEntries::generateEntries( DatabaseImpl* dbi )
 {
     TomahawkSqlQuery query_entries = dbi->newquery();
-    query_entries.prepare("SELECT entries, playlist, author, timestamp, previous_revision "
+    query_entries.prepare("SELECT playlist, previous_revision "
                           "FROM playlist_revision "
                           "WHERE guid = :guid");
     query_entries.bindValue( ":guid", m_revguid );
@@ -50,25 +53,67 @@ DatabaseCommand_LoadPlaylistEntries::generateEntries( DatabaseImpl* dbi )
 
 //    qDebug() << "trying to load entries:" << m_revguid;
     QString prevrev;
-    QJson::Parser parser; bool ok;
+    QString playlistguid;
+    bool havePrevious = false;
 
     if( query_entries.next() )
     {
-        // entries should be a list of strings:
-        QVariant v = parser.parse( query_entries.value(0).toByteArray(), &ok );
-        Q_ASSERT( ok && v.type() == QVariant::List ); //TODO
-        m_guids = v.toStringList();
+        playlistguid = query_entries.value( 0 ).toString();
+        prevrev = query_entries.value( 1 ).toString();
+
+        // with a previous revision, we get its entries along the way
+        const bool ok = PlaylistRevisionStore::load( dbi, m_revguid, m_guids, prevrev.isEmpty() ? 0 : &m_oldentries );
+        havePrevious = ok && !prevrev.isEmpty();
+        loadItems( dbi );
+    }
+    else
+    {
+//        qDebug() << "Playlist has no current revision data";
+    }
+
+    if( havePrevious )
+    {
+        TomahawkSqlQuery query_latest = dbi->newquery();
+        query_latest.prepare( "SELECT currentrevision = ? FROM playlist WHERE guid = ?" );
+        query_latest.addBindValue( m_revguid );
+        query_latest.addBindValue( playlistguid );
+        query_latest.exec();
+        if( query_latest.next() )
+            m_islatest = query_latest.value( 0 ).toBool();
+    }
+
+//    qDebug() << Q_FUNC_INFO << "entrymap:" << m_entrymap;
+}
+
+
+void
+DatabaseCommand_LoadPlaylistEntries::loadItems( DatabaseImpl* dbi )
+{
+    // look the items up in batches, re-using the statement for all full batches
+    const QString sql = QString( "SELECT guid, trackname, artistname, albumname, annotation, "
+                                 "duration, addedon, addedby, result_hint "
+                                 "FROM playlist_item "
+                                 "WHERE guid IN (%1)" );
+
+    TomahawkSqlQuery query = dbi->newquery();
+    int prepared = 0;
+    for( int i = 0; i < m_guids.count(); i += ITEM_BATCH_SIZE )
+    {
+        const int n = qMin( ITEM_BATCH_SIZE, m_guids.count() - i );
+        if( n != prepared )
+        {
+            QStringList placeholders;
+            for( int j = 0; j < n; j++ )
+                placeholders << "?";
 
-        QString inclause = QString("('%1')").arg(m_guids.join("', '"));
+            query.prepare( sql.arg( placeholders.join( ", " ) ) );
+            prepared = n;
+        }
 
-        TomahawkSqlQuery query = dbi->newquery();
-        QString sql = QString("SELECT guid, trackname, artistname, albumname, annotation, "
-                              "duration, addedon, addedby, result_hint "
-                              "FROM playlist_item "
-                              "WHERE guid IN %1").arg( inclause );
-        //qDebug() << sql;
+        for( int j = 0; j < n; j++ )
+            query.bindValue( j, m_guids.at( i + j ) );
+        query.exec();
 
-        query.exec( sql );
         while( query.next() )
         {
             plentry_ptr e( new PlaylistEntry );
@@ -84,38 +129,5 @@ DatabaseCommand_LoadPlaylistEntries::generateEntries( DatabaseImpl* dbi )
 
             m_entrymap.insert( e->guid(), e );
         }
-
-        prevrev = query_entries.value( 4 ).toString();
-
-    }
-    else
-    {
-//        qDebug() << "Playlist has no current revision data";
     }
-
-    if( prevrev.length() )
-    {
-        TomahawkSqlQuery query_entries_old = dbi->newquery();
-        query_entries_old.prepare( "SELECT entries, "
-                                   "(SELECT currentrevision = ? FROM playlist WHERE guid = ?) "
-                                   "FROM playlist_revision "
-                                   "WHERE guid = ?" );
-        query_entries_old.addBindValue( m_revguid );
-        query_entries_old.addBindValue( query_entries.value( 1 ).toString() );
-        query_entries_old.addBindValue( prevrev );
-
-        query_entries_old.exec();
-        if( !query_entries_old.next() )
-        {
-            return;
-            Q_ASSERT( false );
-        }
-
-        QVariant v = parser.parse( query_entries_old.value( 0 ).toByteArray(), &ok );
-        Q_ASSERT( ok && v.type() == QVariant::List ); //TODO
-        m_oldentries = v.toStringList();
-        m_islatest = query_entries_old.value( 1 ).toBool();
-    }
-
-//    qDebug() << Q_FUNC_INFO << "entrymap:" << m_entrymap;
 }
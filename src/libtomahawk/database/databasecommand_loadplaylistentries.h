@@ -59,6 +59,8 @@ protected:
     QStringList m_oldentries;
 
 private:
+    void loadItems( DatabaseImpl* dbi );
+
     QString m_revguid;
 };
 
@@ -0,0 +1,122 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "databasecommand_loadresolvecache.h"
+
+#include <QDateTime>
+#include <QMap>
+#include <QSet>
+
+#include "databaseimpl.h"
+#include "tomahawksqlquery.h"
+#include "artist.h"
+#include "album.h"
+#include "query.h"
+#include "sourcelist.h"
+#include "utils/logger.h"
+
+using namespace Tomahawk;
+
+
+DatabaseCommand_LoadResolveCache::DatabaseCommand_LoadResolveCache( const QList< query_ptr >& queries, QObject* parent )
+    : DatabaseCommand( parent )
+    , m_queries( queries )
+{
+}
+
+
+void
+DatabaseCommand_LoadResolveCache::exec( DatabaseImpl* lib )
+{
+    TomahawkSqlQuery query = lib->newquery();
+    query.prepare( "SELECT source, url, artistname, albumname, trackname, mimetype, "
+                   "duration, bitrate, size, friendlysource, score, resolver "
+                   "FROM resolve_cache "
+                   "WHERE artist = ? AND track = ? AND album = ? AND expires > ? "
+                   "ORDER BY score DESC" );
+
+    const unsigned int now = QDateTime::currentDateTime().toTime_t();
+    unsigned int found = 0;
+
+    foreach ( const query_ptr& q, m_queries )
+    {
+        query.bindValue( 0, q->artistSortname() );
+        query.bindValue( 1, q->trackSortname() );
+        query.bindValue( 2, q->albumSortname() );
+        query.bindValue( 3, now );
+        query.exec();
+
+        QMap< QString, QList< result_ptr > > cached;
+        QSet< QString > urls;
+        while ( query.next() )
+        {
+            const QString url = query.value( 1 ).toString();
+            if ( urls.contains( url ) )
+                continue;
+
+            source_ptr s;
+            if ( !query.value( 0 ).isNull() )
+            {
+                s = SourceList::instance()->get( query.value( 0 ).toInt() );
+                if ( s.isNull() || !s->isOnline() )
+                    continue;
+            }
+
+            result_ptr result = Result::get( url );
+
+            // the result might still be around from resolving it earlier, leave that one alone
+            if ( result->artist().isNull() )
+            {
+                const QString artistName = query.value( 2 ).toString();
+                const QString albumName = query.value( 3 ).toString();
+
+                int artistId = lib->artistId( artistName, false );
+                artist_ptr artist = Artist::get( artistId > 0 ? artistId : 0, artistName );
+                int albumId = artistId > 0 ? lib->albumId( artistId, albumName, false ) : 0;
+                album_ptr album = Album::get( albumId > 0 ? albumId : 0, albumName, artist );
+
+                result->setArtist( artist );
+                result->setAlbum( album );
+                result->setTrack( query.value( 4 ).toString() );
+                result->setMimetype( query.value( 5 ).toString() );
+                result->setDuration( query.value( 6 ).toUInt() );
+                result->setBitrate( query.value( 7 ).toUInt() );
+                result->setSize( query.value( 8 ).toUInt() );
+                result->setFriendlySource( query.value( 9 ).toString() );
+                result->setScore( query.value( 10 ).toFloat() );
+                if ( !s.isNull() )
+                    result->setCollection( s->collection() );
+            }
+
+            urls << url;
+            cached[ query.value( 11 ).toString() ] << result;
+        }
+
+        if ( !cached.isEmpty() )
+            found++;
+
+        QMapIterator< QString, QList< result_ptr > > it( cached );
+        while ( it.hasNext() )
+        {
+            it.next();
+            emit results( q->id(), it.key(), it.value() );
+        }
+    }
+
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Found cached results for" << found << "of" << m_queries.count() << "queries";
+}
@@ -0,0 +1,51 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_LOADRESOLVECACHE_H
+#define DATABASECOMMAND_LOADRESOLVECACHE_H
+
+#include "databasecommand.h"
+#include "result.h"
+
+#include "dllmacro.h"
+
+/*
+    Looks up the cached results of a list of queries. Only results which haven't
+    expired yet and are playable right now are reported, separately for each
+    resolver that found them.
+*/
+class DLLEXPORT DatabaseCommand_LoadResolveCache : public DatabaseCommand
+{
+Q_OBJECT
+
+public:
+    explicit DatabaseCommand_LoadResolveCache( const QList< Tomahawk::query_ptr >& queries, QObject* parent = 0 );
+
+    virtual QString commandname() const { return "loadresolvecache"; }
+
+    virtual bool doesMutates() const { return false; }
+    virtual void exec( DatabaseImpl* lib );
+
+signals:
+    void results( Tomahawk::QID qid, QString resolver, QList<Tomahawk::result_ptr> results );
+
+private:
+    QList< Tomahawk::query_ptr > m_queries;
+};
+
+#endif // DATABASECOMMAND_LOADRESOLVECACHE_H
@@ -0,0 +1,100 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "databasecommand_loadsnapshot.h"
+
+#include <qjson/serializer.h>
+
+#include "databaseimpl.h"
+#include "tomahawksqlquery.h"
+#include "utils/logger.h"
+
+// files per addfiles op, and ops per chunk
+#define FILES_PER_OP 1000
+#define OPS_PER_CHUNK 10
+
+
+void
+DatabaseCommand_LoadSnapshot::exec( DatabaseImpl* dbi )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.setForwardOnly( true );
+    query.prepare( "SELECT file.id, file.size, file.mtime, file.md5, file.mimetype, file.duration, file.bitrate, "
+                   "artist.name, album.name, track.name, file_join.albumpos, "
+                   "(SELECT v FROM track_attributes WHERE track_attributes.id = track.id AND k = 'releaseyear' LIMIT 1) "
+                   "FROM file "
+                   "JOIN file_join ON file_join.file = file.id "
+                   "JOIN artist ON artist.id = file_join.artist "
+                   "JOIN track ON track.id = file_join.track "
+                   "LEFT JOIN album ON album.id = file_join.album "
+                   "WHERE file.source IS NULL AND file.id > ? "
+                   "ORDER BY file.id ASC" );
+    query.addBindValue( m_fromFileId );
+    query.exec();
+
+    QJson::Serializer serializer;
+    QList< dbop_ptr > ops;
+    QVariantList files;
+    unsigned int lastFileId = m_fromFileId;
+    bool more = query.next();
+    while ( more && ops.count() < OPS_PER_CHUNK )
+    {
+        // same fields as DatabaseCommand_AddFiles sends, the url being the file id
+        QVariantMap m;
+        m.insert( "url", query.value( 0 ).toString() );
+        m.insert( "size", query.value( 1 ).toUInt() );
+        m.insert( "mtime", query.value( 2 ).toInt() );
+        m.insert( "hash", query.value( 3 ).toString() );
+        m.insert( "mimetype", query.value( 4 ).toString() );
+        m.insert( "duration", query.value( 5 ).toUInt() );
+        m.insert( "bitrate", query.value( 6 ).toUInt() );
+        m.insert( "artist", query.value( 7 ).toString() );
+        m.insert( "album", query.value( 8 ).toString() );
+        m.insert( "track", query.value( 9 ).toString() );
+        m.insert( "albumpos", query.value( 10 ).toUInt() );
+        m.insert( "year", query.value( 11 ).toInt() );
+        files << m;
+        lastFileId = query.value( 0 ).toUInt();
+
+        more = query.next();
+        if ( files.count() < FILES_PER_OP && more )
+            continue;
+
+        // only the very last op may tell the peer it's got everything
+        const QString guid = more ? uuid() : m_checkpoint;
+
+        QVariantMap cmd;
+        cmd.insert( "command", "addfiles" );
+        cmd.insert( "guid", guid );
+        cmd.insert( "files", files );
+
+        dbop_ptr op( new DBOp );
+        op->guid = guid;
+        op->command = "addfiles";
+        op->payload = serializer.serialize( cmd );
+        op->compressed = false;
+        op->singleton = false;
+        ops << op;
+
+        files.clear();
+    }
+
+    tDebug() << "Loaded collection snapshot chunk after file" << m_fromFileId << "- ops:" << ops.count() << "more:" << more;
+    emit done( ops, lastFileId, more );
+}
@@ -0,0 +1,57 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_LOADSNAPSHOT_H
+#define DATABASECOMMAND_LOADSNAPSHOT_H
+
+#include "typedefs.h"
+#include "databasecommand.h"
+#include "op.h"
+
+#include "dllmacro.h"
+
+/*
+    Describes the local collection as it is now with addfiles ops, for peers
+    that have never synced with us. The last op carries the guid of the
+    snapshot's checkpoint (see DatabaseCommand_loadOps::setSnapshot), so that's
+    where the peer continues from once it applied all of them. The others get
+    guids of their own, which the peer doesn't note as its lastop (see
+    DatabaseCommandLoggable::updatesLastOp). Loads a chunk of files after a
+    file id at a time.
+*/
+class DLLEXPORT DatabaseCommand_LoadSnapshot : public DatabaseCommand
+{
+Q_OBJECT
+public:
+    explicit DatabaseCommand_LoadSnapshot( const QString& checkpoint, unsigned int fromFileId = 0, QObject* parent = 0 )
+        : DatabaseCommand( parent ), m_checkpoint( checkpoint ), m_fromFileId( fromFileId )
+    {}
+
+    virtual void exec( DatabaseImpl* db );
+    virtual bool doesMutates() const { return false; }
+    virtual QString commandname() const { return "loadsnapshot"; }
+
+signals:
+    void done( QList< dbop_ptr > ops, unsigned int lastFileId, bool more );
+
+private:
+    QString m_checkpoint;
+    unsigned int m_fromFileId;
+};
+
+#endif // DATABASECOMMAND_LOADSNAPSHOT_H
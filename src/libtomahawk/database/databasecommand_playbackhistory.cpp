@@ -29,13 +29,12 @@
 void
 DatabaseCommand_PlaybackHistory::exec( DatabaseImpl* dbi )
 {
-    TomahawkSqlQuery query = dbi->newquery();
     QList<Tomahawk::query_ptr> ql;
 
     QString whereToken;
     if ( !source().isNull() )
     {
-        whereToken = QString( "WHERE source %1" ).arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) );
+        whereToken = QString( "WHERE source %1" ).arg( source()->isLocal() ? "IS NULL" : "= ?" );
     }
 
     QString sql = QString(
@@ -44,23 +43,22 @@ DatabaseCommand_PlaybackHistory::exec( DatabaseImpl* dbi )
             "%1 "
             "ORDER BY playtime DESC "
             "%2" ).arg( whereToken )
-                  .arg( m_amount > 0 ? QString( "LIMIT 0, %1" ).arg( m_amount ) : QString() );
+                  .arg( m_amount > 0 ? "LIMIT 0, ?" : QString() );
 
-    query.prepare( sql );
+    TomahawkSqlQuery query = dbi->preparedQuery( sql );
+    if ( !source().isNull() && !source()->isLocal() )
+        query.addBindValue( source()->id() );
+    if ( m_amount > 0 )
+        query.addBindValue( m_amount );
     query.exec();
 
     while( query.next() )
     {
-        TomahawkSqlQuery query_track = dbi->newquery();
-
-        QString sql = QString(
-                "SELECT track.name, artist.name "
-                "FROM track, artist "
-                "WHERE artist.id = track.artist "
-                "AND track.id = %1"
-                ).arg( query.value( 0 ).toUInt() );
-
-        query_track.prepare( sql );
+        TomahawkSqlQuery query_track = dbi->preparedQuery( "SELECT track.name, artist.name "
+                                                           "FROM track, artist "
+                                                           "WHERE artist.id = track.artist "
+                                                           "AND track.id = ?" );
+        query_track.addBindValue( query.value( 0 ).toUInt() );
         query_track.exec();
 
         if ( query_track.next() )
@@ -0,0 +1,271 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "databasecommand_resolvebatch.h"
+
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include "artist.h"
+#include "album.h"
+#include "sourcelist.h"
+#include "utils/logger.h"
+
+using namespace Tomahawk;
+
+
+// Per query we keep the candidate names found in the search index
+struct ResolveCandidates
+{
+    QHash< int, float > artists;
+    QHash< int, float > tracks;
+    bool fullText;
+};
+
+
+// Ids are bound to IN () lists in groups of this size, unused places bound to
+// an id no row has. So there's just one statement to prepare per lookup, which
+// the connection caches.
+#define ID_GROUP_SIZE 64
+
+
+static QString
+idPlaceholders()
+{
+    QStringList sl;
+    for ( int i = 0; i < ID_GROUP_SIZE; i++ )
+        sl << "?";
+
+    return sl.join( "," );
+}
+
+
+static void
+bindIdGroup( TomahawkSqlQuery& query, const QList< int >& ids, int from )
+{
+    for ( int i = from; i < from + ID_GROUP_SIZE; i++ )
+        query.addBindValue( i < ids.count() ? ids.at( i ) : -1 );
+}
+
+
+DatabaseCommand_ResolveBatch::DatabaseCommand_ResolveBatch( const QList< query_ptr >& queries )
+    : DatabaseCommand()
+    , m_queries( queries )
+{
+}
+
+
+DatabaseCommand_ResolveBatch::~DatabaseCommand_ResolveBatch()
+{}
+
+
+QList< QPair<int, float> >
+DatabaseCommand_ResolveBatch::searchTable( DatabaseImpl* lib, const QString& table, const QString& name )
+{
+    // playlists tend to ask for the same artists over and over again
+    const QString key = table + '\t' + name;
+    QHash< QString, QList< QPair<int, float> > >::const_iterator it = m_searchCache.constFind( key );
+    if ( it != m_searchCache.constEnd() )
+        return it.value();
+
+    QList< QPair<int, float> > res = lib->searchTable( table, name, 10 );
+    m_searchCache.insert( key, res );
+    return res;
+}
+
+
+void
+DatabaseCommand_ResolveBatch::exec( DatabaseImpl* lib )
+{
+    /*
+     *        Resolve many queries at once:
+     *        1) find list of trk/art IDs that are reasonable matches for each query
+     *        2) fetch the files of all candidate tracks with a single query and hand
+     *           each row to the queries it is a candidate for
+     *        3) fetch the attributes of all found tracks with a single query
+     */
+
+    QHash< QID, QList< result_ptr > > resultsByQuery;
+    QVector< ResolveCandidates > candidates( m_queries.count() );
+    QHash< int, QList<int> > queriesByTrack;
+    QSet< int > allTracks;
+
+    // STEP 1
+    for ( int i = 0; i < m_queries.count(); i++ )
+    {
+        const query_ptr& query = m_queries.at( i );
+        resultsByQuery.insert( query->id(), QList< result_ptr >() );
+
+        if ( !query->resultHint().isEmpty() )
+        {
+            result_ptr result = lib->resultFromHint( query );
+            if ( !result.isNull() && !result->collection().isNull() && result->collection()->source()->isOnline() )
+            {
+                resultsByQuery[ query->id() ] << result;
+                continue;
+            }
+        }
+
+        ResolveCandidates& c = candidates[ i ];
+        c.fullText = query->isFullTextQuery();
+
+        QList< QPair<int, float> > tracks;
+        if ( c.fullText )
+        {
+            tracks = searchTable( lib, "track", query->fullTextQuery() );
+        }
+        else
+        {
+            QList< QPair<int, float> > artists = searchTable( lib, "artist", query->artist() );
+            if ( artists.isEmpty() )
+                continue;
+
+            tracks = searchTable( lib, "track", query->track() );
+            for ( int k = 0; k < artists.count(); k++ )
+                c.artists.insert( artists.at( k ).first, artists.at( k ).second );
+        }
+
+        for ( int k = 0; k < tracks.count(); k++ )
+        {
+            const int trackId = tracks.at( k ).first;
+            c.tracks.insert( trackId, tracks.at( k ).second );
+            queriesByTrack[ trackId ] << i;
+            allTracks << trackId;
+        }
+    }
+
+    if ( !allTracks.isEmpty() )
+    {
+        // STEP 2
+        const QString sql = QString( "SELECT "
+                               "url, mtime, size, md5, mimetype, duration, bitrate, file_join.artist, file_join.album, file_join.track, "
+                               "artist.name as artname, "
+                               "album.name as albname, "
+                               "track.name as trkname, "
+                               "file.source, "
+                               "file_join.albumpos, "
+                               "artist.id as artid, "
+                               "album.id as albid "
+                               "FROM file, file_join, artist, track "
+                               "LEFT JOIN album ON album.id = file_join.album "
+                               "WHERE "
+                               "artist.id = file_join.artist AND "
+                               "track.id = file_join.track AND "
+                               "file.id = file_join.file AND "
+                               "file_join.track IN (%1)" )
+                      .arg( idPlaceholders() );
+
+        const QList< int > trackIds = allTracks.toList();
+        QList< result_ptr > found;
+        QSet< int > foundTracks;
+        for ( int from = 0; from < trackIds.count(); from += ID_GROUP_SIZE )
+        {
+            TomahawkSqlQuery files_query = lib->preparedQuery( sql );
+            bindIdGroup( files_query, trackIds, from );
+            files_query.exec();
+
+            while ( files_query.next() )
+            {
+                const int artistId = files_query.value( 7 ).toInt();
+                const int trackId = files_query.value( 9 ).toInt();
+
+                QList<int> matching;
+                foreach ( int i, queriesByTrack.value( trackId ) )
+                {
+                    if ( candidates.at( i ).fullText || candidates.at( i ).artists.contains( artistId ) )
+                        matching << i;
+                }
+                if ( matching.isEmpty() )
+                    continue;
+
+                source_ptr s;
+                QString url = files_query.value( 0 ).toString();
+
+                if ( files_query.value( 13 ).toUInt() == 0 )
+                {
+                    s = SourceList::instance()->getLocal();
+                }
+                else
+                {
+                    s = SourceList::instance()->get( files_query.value( 13 ).toUInt() );
+                    if ( s.isNull() )
+                    {
+                        qDebug() << "Could not find source" << files_query.value( 13 ).toUInt();
+                        continue;
+                    }
+
+                    url = QString( "servent://%1\t%2" ).arg( s->userName() ).arg( url );
+                }
+
+                Tomahawk::result_ptr result = Tomahawk::Result::get( url );
+                Tomahawk::artist_ptr artist = Tomahawk::Artist::get( files_query.value( 15 ).toUInt(), files_query.value( 10 ).toString() );
+                Tomahawk::album_ptr album = Tomahawk::Album::get( files_query.value( 16 ).toUInt(), files_query.value( 11 ).toString(), artist );
+
+                result->setModificationTime( files_query.value( 1 ).toUInt() );
+                result->setSize( files_query.value( 2 ).toUInt() );
+                result->setMimetype( files_query.value( 4 ).toString() );
+                result->setDuration( files_query.value( 5 ).toUInt() );
+                result->setBitrate( files_query.value( 6 ).toUInt() );
+                result->setArtist( artist );
+                result->setAlbum( album );
+                result->setTrack( files_query.value( 12 ).toString() );
+                result->setRID( uuid() );
+                result->setAlbumPos( files_query.value( 14 ).toUInt() );
+                result->setTrackId( trackId );
+                result->setCollection( s->collection() );
+
+                foreach ( int i, matching )
+                {
+                    if ( candidates.at( i ).fullText )
+                        result->setScore( candidates.at( i ).tracks.value( trackId ) );
+
+                    resultsByQuery[ m_queries.at( i )->id() ] << result;
+                }
+
+                found << result;
+                foundTracks << trackId;
+            }
+        }
+
+        // STEP 3
+        if ( !foundTracks.isEmpty() )
+        {
+            QHash< int, QVariantMap > attributes;
+
+            const QString attrSql = QString( "SELECT id, k, v FROM track_attributes WHERE id IN (%1)" ).arg( idPlaceholders() );
+            const QList< int > attrIds = foundTracks.toList();
+            for ( int from = 0; from < attrIds.count(); from += ID_GROUP_SIZE )
+            {
+                TomahawkSqlQuery attrQuery = lib->preparedQuery( attrSql );
+                bindIdGroup( attrQuery, attrIds, from );
+                attrQuery.exec();
+                while ( attrQuery.next() )
+                {
+                    attributes[ attrQuery.value( 0 ).toInt() ][ attrQuery.value( 1 ).toString() ] = attrQuery.value( 2 ).toString();
+                }
+            }
+
+            foreach ( const result_ptr& result, found )
+                result->setAttributes( attributes.value( result->trackId() ) );
+        }
+    }
+
+    foreach ( const query_ptr& query, m_queries )
+        emit results( query->id(), resultsByQuery.value( query->id() ) );
+}
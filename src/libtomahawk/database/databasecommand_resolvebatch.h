@@ -16,8 +16,8 @@
  *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef DATABASECOMMAND_RESOLVE_H
-#define DATABASECOMMAND_RESOLVE_H
+#ifndef DATABASECOMMAND_RESOLVEBATCH_H
+#define DATABASECOMMAND_RESOLVEBATCH_H
 
 #include "databasecommand.h"
 #include "databaseimpl.h"
@@ -27,14 +27,19 @@
 
 #include "dllmacro.h"
 
-class DLLEXPORT DatabaseCommand_Resolve : public DatabaseCommand
+/*
+    Resolves a whole list of queries in one go: the fuzzy lookups are shared between
+    queries asking for the same names, and files and their attributes are fetched
+    with one set-based query each, instead of one query per candidate.
+*/
+class DLLEXPORT DatabaseCommand_ResolveBatch : public DatabaseCommand
 {
 Q_OBJECT
 public:
-    explicit DatabaseCommand_Resolve( const Tomahawk::query_ptr& query );
-    virtual ~DatabaseCommand_Resolve();
+    explicit DatabaseCommand_ResolveBatch( const QList< Tomahawk::query_ptr >& queries );
+    virtual ~DatabaseCommand_ResolveBatch();
 
-    virtual QString commandname() const { return "dbresolve"; }
+    virtual QString commandname() const { return "dbresolvebatch"; }
     virtual bool doesMutates() const { return false; }
 
     virtual void exec( DatabaseImpl *lib );
@@ -42,15 +47,13 @@ public:
 signals:
     void results( Tomahawk::QID qid, QList<Tomahawk::result_ptr> results );
 
-public slots:
-
 private:
-    DatabaseCommand_Resolve();
+    DatabaseCommand_ResolveBatch();
 
-    void fullTextResolve( DatabaseImpl* lib );
-    void resolve( DatabaseImpl* lib );
+    QList< QPair<int, float> > searchTable( DatabaseImpl* lib, const QString& table, const QString& name );
 
-    Tomahawk::query_ptr m_query;
+    QList< Tomahawk::query_ptr > m_queries;
+    QHash< QString, QList< QPair<int, float> > > m_searchCache;
 };
 
-#endif // DATABASECOMMAND_RESOLVE_H
+#endif // DATABASECOMMAND_RESOLVEBATCH_H
@@ -22,6 +22,7 @@
 
 #include "source.h"
 #include "databaseimpl.h"
+#include "playlistrevisionstore.h"
 #include "tomahawksqlquery.h"
 #include "network/servent.h"
 #include "utils/logger.h"
@@ -108,10 +109,6 @@ DatabaseCommand_SetPlaylistRevision::exec( DatabaseImpl* lib )
         return;
     }
 
-    QVariantList vlist = m_orderedguids;
-    QJson::Serializer ser;
-    const QByteArray entries = ser.serialize( vlist );
-
     // add any new items:
     TomahawkSqlQuery adde = lib->newquery();
     if ( m_localOnly )
@@ -163,19 +160,22 @@ DatabaseCommand_SetPlaylistRevision::exec( DatabaseImpl* lib )
         }
     }
 
+    QStringList orderedguids;
+    foreach( const QVariant& v, m_orderedguids )
+        orderedguids << v.toString();
+
+    // the new revision is stored as a delta to the one it's based on, so we need that one anyway.
+    // Usually it's the one we stored last, otherwise replay its delta chain
+    QStringList previousEntries;
+    const bool havePrevious = !m_oldrev.isEmpty() &&
+                              ( lib->lastRevision( m_playlistguid, m_oldrev, previousEntries ) ||
+                                PlaylistRevisionStore::load( lib, m_oldrev, previousEntries ) );
+
     // add / update the revision:
-    TomahawkSqlQuery query = lib->newquery();
-    QString sql = "INSERT INTO playlist_revision(guid, playlist, entries, author, timestamp, previous_revision) "
-                  "VALUES(?, ?, ?, ?, ?, ?)";
-    query.prepare( sql );
-
-    query.addBindValue( m_newrev );
-    query.addBindValue( m_playlistguid );
-    query.addBindValue( entries );
-    query.addBindValue( source()->isLocal() ? QVariant(QVariant::Int) : source()->id() );
-    query.addBindValue( 0 ); //ts
-    query.addBindValue( m_oldrev.isEmpty() ? QVariant(QVariant::String) : m_oldrev );
-    query.exec();
+    PlaylistRevisionStore::insert( lib, m_newrev, m_playlistguid,
+                                   source()->isLocal() ? QVariant(QVariant::Int) : source()->id(),
+                                   m_oldrev, orderedguids, havePrevious ? &previousEntries : 0 );
+    lib->setLastRevision( m_playlistguid, m_newrev, orderedguids );
 
     qDebug() << "Currentrevision:" << m_currentRevision << "oldrev:" << m_oldrev;
     // if optimistic locking is ok, update current revision to this new one
@@ -191,23 +191,8 @@ DatabaseCommand_SetPlaylistRevision::exec( DatabaseImpl* lib )
 
         m_applied = true;
 
-        // load previous revision entries, which we need to pass on
-        // so the change can be diffed
-        TomahawkSqlQuery query_entries = lib->newquery();
-        query_entries.prepare( "SELECT entries, playlist, author, timestamp, previous_revision "
-                               "FROM playlist_revision "
-                               "WHERE guid = :guid" );
-        query_entries.bindValue( ":guid", m_oldrev );
-        query_entries.exec();
-        if ( query_entries.next() )
-        {
-            bool ok;
-            QJson::Parser parser;
-            QVariant v = parser.parse( query_entries.value( 0 ).toByteArray(), &ok );
-            Q_ASSERT( ok && v.type() == QVariant::List ); //TODO
-
-            m_previous_rev_orderedguids = v.toStringList();
-        }
+        // pass on the previous revision entries, so the change can be diffed
+        m_previous_rev_orderedguids = previousEntries;
     }
     else if ( !m_oldrev.isEmpty() )
     {
@@ -36,4 +36,8 @@ DatabaseCommand_SourceOffline::exec( DatabaseImpl* lib )
     TomahawkSqlQuery q = lib->newquery();
     q.exec( QString( "UPDATE source SET isonline = 'false' WHERE id = %1" )
             .arg( m_id ) );
+
+    // results found in its collection aren't playable anymore
+    q.exec( QString( "DELETE FROM resolve_cache WHERE source = %1" )
+            .arg( m_id ) );
 }
@@ -0,0 +1,260 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "databasecommand_trackpage.h"
+
+#include <QSqlQuery>
+
+#include "databaseimpl.h"
+#include "source.h"
+#include "utils/logger.h"
+
+#define FIXED_COLUMNS 16
+
+static const char* s_tracksFrom =
+        "FROM file, artist, track, file_join "
+        "LEFT OUTER JOIN album "
+        "ON file_join.album = album.id "
+        "WHERE file.id = file_join.file "
+        "AND file_join.artist = artist.id "
+        "AND file_join.track = track.id ";
+
+
+static QString
+sourceCondition( const QString& column, const QList< Tomahawk::collection_ptr >& collections, QVariantList& binds )
+{
+    if ( collections.isEmpty() )
+        return QString();
+
+    QStringList conditions, remotes;
+    foreach ( const Tomahawk::collection_ptr& collection, collections )
+    {
+        if ( collection->source()->isLocal() )
+            conditions << QString( "%1 IS NULL" ).arg( column );
+        else
+        {
+            remotes << "?";
+            binds << collection->source()->id();
+        }
+    }
+    if ( !remotes.isEmpty() )
+        conditions << QString( "%1 IN ( %2 )" ).arg( column ).arg( remotes.join( ", " ) );
+
+    return QString( "AND ( %1 )" ).arg( conditions.join( " OR " ) );
+}
+
+
+// The columns a page is ordered by. The last one is always the file id, so
+// the order is total and a page can be continued after the last row's key.
+QStringList
+DatabaseCommand_TrackPage::sortKeys() const
+{
+    QStringList keys;
+    switch ( m_sortColumn )
+    {
+        case Artist:
+            keys << "artist.sortname" << "IFNULL( album.sortname, '' )" << "file_join.albumpos";
+            break;
+
+        case Track:
+            keys << "track.sortname" << "artist.sortname";
+            break;
+
+        case Album:
+            keys << "IFNULL( album.sortname, '' )" << "file_join.albumpos";
+            break;
+
+        case Duration:
+            keys << "file.duration";
+            break;
+
+        case Bitrate:
+            keys << "file.bitrate";
+            break;
+
+        case ModificationTime:
+            keys << "file.mtime";
+            break;
+
+        case Filesize:
+            keys << "file.size";
+            break;
+    }
+
+    keys << "file.id";
+    return keys;
+}
+
+
+void
+DatabaseCommand_TrackPage::exec( DatabaseImpl* dbi )
+{
+    TrackPage page;
+    page.offset = m_offset;
+
+    // everything but the paging is shared between the count and the page itself
+    QVariantList filterBinds;
+    QString filterToken = sourceCondition( "file.source", m_collections, filterBinds );
+
+    if ( m_recent > 0 )
+    {
+        filterToken += QString( " AND file.id IN ( SELECT recent.id FROM file AS recent WHERE 1 %1 ORDER BY recent.mtime DESC LIMIT ? )" )
+                          .arg( sourceCondition( "recent.source", m_collections, filterBinds ) );
+        filterBinds << m_recent;
+    }
+
+    filterToken += " " + dbi->filterCondition( "file.id", m_filter, filterBinds );
+
+    if ( m_countTotal )
+    {
+        TomahawkSqlQuery query = dbi->preparedQuery( QString( "SELECT COUNT(*) FROM file, file_join WHERE file.id = file_join.file %1" )
+                                                        .arg( filterToken ) );
+        foreach ( const QVariant& value, filterBinds )
+            query.addBindValue( value );
+        query.exec();
+
+        page.total = query.next() ? query.value( 0 ).toInt() : 0;
+    }
+
+    const QStringList keys = sortKeys();
+    const QString direction = m_sortDescending ? "DESC" : "ASC";
+    QStringList orderBy;
+    foreach ( const QString& key, keys )
+        orderBy << QString( "%1 %2" ).arg( key ).arg( direction );
+
+    QVariantList binds = filterBinds;
+    QString keysetToken;
+    unsigned int offset = m_offset;
+    if ( m_offset > 0 && m_lastKey.count() == keys.count() )
+    {
+        keysetToken = keysetCondition( keys, m_lastKey, true, binds );
+        offset = 0;
+    }
+    binds << m_amount << offset;
+
+    QString sql = QString(
+            "SELECT file.id, file.source, file.url, file.size, file.duration, file.bitrate, file.mtime, file.mimetype, "
+                   "artist.id, artist.name, album.id, album.name, track.id, track.name, file_join.albumpos, "
+                   "( SELECT v FROM track_attributes WHERE track_attributes.id = track.id AND k = 'releaseyear' LIMIT 1 ), "
+                   "%1 "
+            "%2 "
+            "%3 %4 "
+            "ORDER BY %5 "
+            "LIMIT ? OFFSET ?"
+            ).arg( keys.join( ", " ) )
+             .arg( s_tracksFrom )
+             .arg( filterToken )
+             .arg( keysetToken )
+             .arg( orderBy.join( ", " ) );
+
+    TomahawkSqlQuery query = dbi->preparedQuery( sql );
+    foreach ( const QVariant& value, binds )
+        query.addBindValue( value );
+    query.exec();
+
+    page.fileIds.reserve( m_amount );
+    while ( query.next() )
+    {
+        page.fileIds << query.value( 0 ).toUInt();
+        page.sourceIds << query.value( 1 ).toUInt();
+        page.urls << query.value( 2 ).toString();
+        page.sizes << query.value( 3 ).toUInt();
+        page.durations << query.value( 4 ).toUInt();
+        page.bitrates << query.value( 5 ).toUInt();
+        page.mtimes << query.value( 6 ).toUInt();
+        page.mimetypes << query.value( 7 ).toString();
+        page.artistIds << query.value( 8 ).toUInt();
+        page.artists << query.value( 9 ).toString();
+        page.albumIds << query.value( 10 ).toUInt();
+        page.albums << query.value( 11 ).toString();
+        page.trackIds << query.value( 12 ).toUInt();
+        page.tracks << query.value( 13 ).toString();
+        page.albumpos << query.value( 14 ).toUInt();
+        page.years << query.value( 15 ).toUInt();
+
+        if ( page.fileIds.count() == (int)m_amount )
+        {
+            for ( int i = 0; i < keys.count(); i++ )
+                page.lastKey << query.value( FIXED_COLUMNS + i );
+        }
+    }
+
+    if ( m_locateFileId > 0 )
+    {
+        // the file's sort key, then the number of rows sorting before it
+        QVariantList locateBinds;
+        locateBinds << m_locateFileId << filterBinds;
+        TomahawkSqlQuery query = dbi->preparedQuery( QString( "SELECT %1 %2 AND file.id = ? %3" )
+                                                        .arg( keys.join( ", " ) )
+                                                        .arg( s_tracksFrom )
+                                                        .arg( filterToken ) );
+        foreach ( const QVariant& value, locateBinds )
+            query.addBindValue( value );
+        query.exec();
+
+        if ( query.next() )
+        {
+            QVariantList key;
+            for ( int i = 0; i < keys.count(); i++ )
+                key << query.value( i );
+
+            QVariantList countBinds = filterBinds;
+            const QString before = keysetCondition( keys, key, false, countBinds );
+            TomahawkSqlQuery count = dbi->preparedQuery( QString( "SELECT COUNT(*) %1 %2 %3" )
+                                                            .arg( s_tracksFrom )
+                                                            .arg( filterToken )
+                                                            .arg( before ) );
+            foreach ( const QVariant& value, countBinds )
+                count.addBindValue( value );
+            count.exec();
+
+            if ( count.next() )
+                page.located = count.value( 0 ).toInt();
+        }
+    }
+
+    emit tracks( page, data() );
+}
+
+
+// Matches the rows sorting after (or before) \a key:
+// k1 >= ? AND ( ( k1 > ? ) OR ( k1 = ? AND k2 > ? ) OR ... ).
+// The leading range on the first key lets sqlite walk its index.
+QString
+DatabaseCommand_TrackPage::keysetCondition( const QStringList& keys, const QVariantList& key, bool after, QVariantList& binds ) const
+{
+    const QString op = ( after != m_sortDescending ) ? ">" : "<";
+    binds << key.at( 0 );
+
+    QStringList alternatives;
+    for ( int i = 0; i < keys.count(); i++ )
+    {
+        QStringList terms;
+        for ( int j = 0; j < i; j++ )
+        {
+            terms << QString( "%1 = ?" ).arg( keys.at( j ) );
+            binds << key.at( j );
+        }
+        terms << QString( "%1 %2 ?" ).arg( keys.at( i ) ).arg( op );
+        binds << key.at( i );
+
+        alternatives << QString( "( %1 )" ).arg( terms.join( " AND " ) );
+    }
+
+    return QString( "AND %1 %2= ? AND ( %3 )" ).arg( keys.at( 0 ) ).arg( op ).arg( alternatives.join( " OR " ) );
+}
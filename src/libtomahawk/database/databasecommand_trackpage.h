@@ -0,0 +1,134 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_TRACKPAGE_H
+#define DATABASECOMMAND_TRACKPAGE_H
+
+#include <QObject>
+#include <QMetaType>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+
+#include "databasecommand.h"
+#include "collection.h"
+#include "typedefs.h"
+
+#include "dllmacro.h"
+
+/// One window of rows out of a collection, stored column by column so a page
+/// costs a handful of allocations rather than a query/result object per track.
+struct TrackPage
+{
+    TrackPage() : offset( 0 ), total( -1 ), located( -1 ) {}
+
+    int count() const { return fileIds.count(); }
+
+    unsigned int offset;
+    int total;          // matching rows, or -1 if it wasn't counted
+    QVariantList lastKey;  // sort key of the last row, to continue after it
+    int located;        // row of the file asked for with setLocate(), or -1
+
+    QVector< unsigned int > fileIds;
+    QVector< unsigned int > sourceIds;
+    QVector< unsigned int > artistIds;
+    QVector< unsigned int > albumIds;
+    QVector< unsigned int > trackIds;
+    QStringList urls;
+    QStringList artists;
+    QStringList albums;
+    QStringList tracks;
+    QStringList mimetypes;
+    QVector< unsigned int > sizes;
+    QVector< unsigned int > durations;
+    QVector< unsigned int > bitrates;
+    QVector< unsigned int > mtimes;
+    QVector< unsigned int > albumpos;
+    QVector< unsigned int > years;
+};
+
+Q_DECLARE_METATYPE( TrackPage )
+
+class DLLEXPORT DatabaseCommand_TrackPage : public DatabaseCommand
+{
+Q_OBJECT
+public:
+    enum SortColumn {
+        Artist = 0,
+        Track = 1,
+        Album = 2,
+        Duration = 3,
+        Bitrate = 4,
+        ModificationTime = 5,
+        Filesize = 6
+    };
+
+    explicit DatabaseCommand_TrackPage( const QList< Tomahawk::collection_ptr >& collections, QObject* parent = 0 )
+        : DatabaseCommand( parent )
+        , m_collections( collections )
+        , m_sortColumn( DatabaseCommand_TrackPage::Artist )
+        , m_sortDescending( false )
+        , m_offset( 0 )
+        , m_amount( 0 )
+        , m_recent( 0 )
+        , m_countTotal( false )
+        , m_locateFileId( 0 )
+    {}
+
+    virtual void exec( DatabaseImpl* );
+
+    virtual bool doesMutates() const { return false; }
+    virtual QString commandname() const { return "trackpage"; }
+
+    void setSortColumn( DatabaseCommand_TrackPage::SortColumn column ) { m_sortColumn = column; }
+    void setSortDescending( bool descending ) { m_sortDescending = descending; }
+    void setFilter( const QString& filter ) { m_filter = filter; }
+
+    /// Fetches \a amount rows starting at row \a offset. If \a lastKey is the sort
+    /// key of the row right before \a offset, the page is found through the sort
+    /// key instead of making sqlite step over all the preceding rows.
+    void setRange( unsigned int offset, unsigned int amount, const QVariantList& lastKey = QVariantList() )
+    { m_offset = offset; m_amount = amount; m_lastKey = lastKey; }
+
+    /// Restricts the rows to the \a amount most recently modified files.
+    void setRecent( unsigned int amount ) { m_recent = amount; }
+    void setCountTotal( bool count ) { m_countTotal = count; }
+    /// Also finds the row the file with id \a fileId is at now, if it matches.
+    void setLocate( unsigned int fileId ) { m_locateFileId = fileId; }
+
+signals:
+    void tracks( const TrackPage& page, const QVariant& data );
+
+private:
+    QStringList sortKeys() const;
+    QString keysetCondition( const QStringList& keys, const QVariantList& key, bool after, QVariantList& binds ) const;
+
+    QList< Tomahawk::collection_ptr > m_collections;
+    DatabaseCommand_TrackPage::SortColumn m_sortColumn;
+    bool m_sortDescending;
+    QString m_filter;
+
+    unsigned int m_offset;
+    unsigned int m_amount;
+    QVariantList m_lastKey;
+    unsigned int m_recent;
+    bool m_countTotal;
+    unsigned int m_locateFileId;
+};
+
+#endif // DATABASECOMMAND_TRACKPAGE_H
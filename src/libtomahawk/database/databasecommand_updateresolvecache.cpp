@@ -0,0 +1,171 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "databasecommand_updateresolvecache.h"
+
+#include <QDateTime>
+
+#include "databaseimpl.h"
+#include "tomahawksqlquery.h"
+#include "artist.h"
+#include "album.h"
+#include "collection.h"
+#include "query.h"
+#include "result.h"
+#include "source.h"
+#include "utils/logger.h"
+
+// how many results of each resolver we remember per query
+#define MAX_CACHED_RESULTS 3
+
+using namespace Tomahawk;
+
+
+static bool
+scoreSorter( const result_ptr& left, const result_ptr& right )
+{
+    return left->score() > right->score();
+}
+
+
+DatabaseCommand_UpdateResolveCache::DatabaseCommand_UpdateResolveCache( QObject* parent )
+    : DatabaseCommand( parent )
+{
+}
+
+
+void
+DatabaseCommand_UpdateResolveCache::addResults( const query_ptr& query, const QString& resolver, unsigned int ttl,
+                                                const QList< result_ptr >& results )
+{
+    Entry entry;
+    entry.artist = query->artistSortname();
+    entry.track = query->trackSortname();
+    entry.album = query->albumSortname();
+    entry.resolver = resolver;
+    entry.expires = QDateTime::currentDateTime().toTime_t() + ttl;
+
+    QList< result_ptr > best = results;
+    qStableSort( best.begin(), best.end(), scoreSorter );
+
+    foreach ( const result_ptr& r, best.mid( 0, MAX_CACHED_RESULTS ) )
+    {
+        CachedResult cr;
+        cr.source = r->collection().isNull() ? QVariant( QVariant::Int ) : QVariant( r->collection()->source()->id() );
+
+        cr.url = r->url();
+        cr.artist = r->artist().isNull() ? QString() : r->artist()->name();
+        cr.album = r->album().isNull() ? QString() : r->album()->name();
+        cr.track = r->track();
+        cr.mimetype = r->mimetype();
+        cr.duration = r->duration();
+        cr.bitrate = r->bitrate();
+        cr.size = r->size();
+        cr.friendlySource = r->friendlySource();
+        cr.score = r->score();
+
+        entry.results << cr;
+    }
+
+    m_entries << entry;
+}
+
+
+void
+DatabaseCommand_UpdateResolveCache::removeResult( const query_ptr& query, const QString& resolver, const result_ptr& result )
+{
+    RemovedResult removed;
+    removed.artist = query->artistSortname();
+    removed.track = query->trackSortname();
+    removed.album = query->albumSortname();
+    removed.resolver = resolver;
+    removed.url = result->url();
+
+    m_removedResults << removed;
+}
+
+
+void
+DatabaseCommand_UpdateResolveCache::exec( DatabaseImpl* lib )
+{
+    TomahawkSqlQuery query = lib->newquery();
+
+    foreach ( const QString& resolver, m_removedResolvers )
+    {
+        query.prepare( "DELETE FROM resolve_cache WHERE resolver = ?" );
+        query.bindValue( 0, resolver );
+        query.exec();
+    }
+
+    TomahawkSqlQuery deleteQuery = lib->newquery();
+    deleteQuery.prepare( "DELETE FROM resolve_cache WHERE artist = ? AND track = ? AND album = ? AND resolver = ?" );
+
+    TomahawkSqlQuery insertQuery = lib->newquery();
+    insertQuery.prepare( "INSERT INTO resolve_cache(artist, track, album, resolver, source, url, "
+                         "artistname, albumname, trackname, mimetype, duration, bitrate, size, "
+                         "friendlysource, score, expires) "
+                         "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)" );
+
+    foreach ( const Entry& entry, m_entries )
+    {
+        if ( m_removedResolvers.contains( entry.resolver ) )
+            continue;
+
+        deleteQuery.bindValue( 0, entry.artist );
+        deleteQuery.bindValue( 1, entry.track );
+        deleteQuery.bindValue( 2, entry.album );
+        deleteQuery.bindValue( 3, entry.resolver );
+        deleteQuery.exec();
+
+        foreach ( const CachedResult& cr, entry.results )
+        {
+            insertQuery.bindValue( 0, entry.artist );
+            insertQuery.bindValue( 1, entry.track );
+            insertQuery.bindValue( 2, entry.album );
+            insertQuery.bindValue( 3, entry.resolver );
+            insertQuery.bindValue( 4, cr.source );
+            insertQuery.bindValue( 5, cr.url );
+            insertQuery.bindValue( 6, cr.artist );
+            insertQuery.bindValue( 7, cr.album );
+            insertQuery.bindValue( 8, cr.track );
+            insertQuery.bindValue( 9, cr.mimetype );
+            insertQuery.bindValue( 10, cr.duration );
+            insertQuery.bindValue( 11, cr.bitrate );
+            insertQuery.bindValue( 12, cr.size );
+            insertQuery.bindValue( 13, cr.friendlySource );
+            insertQuery.bindValue( 14, cr.score );
+            insertQuery.bindValue( 15, entry.expires );
+            insertQuery.exec();
+        }
+    }
+
+    TomahawkSqlQuery removeQuery = lib->newquery();
+    removeQuery.prepare( "DELETE FROM resolve_cache WHERE artist = ? AND track = ? AND album = ? AND resolver = ? AND url = ?" );
+
+    foreach ( const RemovedResult& removed, m_removedResults )
+    {
+        removeQuery.bindValue( 0, removed.artist );
+        removeQuery.bindValue( 1, removed.track );
+        removeQuery.bindValue( 2, removed.album );
+        removeQuery.bindValue( 3, removed.resolver );
+        removeQuery.bindValue( 4, removed.url );
+        removeQuery.exec();
+    }
+
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Cached results of" << m_entries.count() << "queries, dropped" << m_removedResults.count() << "stale ones";
+}
@@ -0,0 +1,96 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_UPDATERESOLVECACHE_H
+#define DATABASECOMMAND_UPDATERESOLVECACHE_H
+
+#include <QStringList>
+#include <QVariant>
+
+#include "databasecommand.h"
+#include "typedefs.h"
+
+#include "dllmacro.h"
+
+/*
+    Stores the best results resolvers found for queries in the resolve cache,
+    replacing what the same resolver found for those queries before.
+    Also drops cached results their resolver didn't find again, and everything
+    of resolvers which got removed.
+*/
+class DLLEXPORT DatabaseCommand_UpdateResolveCache : public DatabaseCommand
+{
+Q_OBJECT
+
+public:
+    explicit DatabaseCommand_UpdateResolveCache( QObject* parent = 0 );
+
+    virtual QString commandname() const { return "updateresolvecache"; }
+
+    virtual bool doesMutates() const { return true; }
+    virtual void exec( DatabaseImpl* lib );
+
+    // call from the thread owning the results, before enqueueing the command
+    void addResults( const Tomahawk::query_ptr& query, const QString& resolver, unsigned int ttl,
+                     const QList< Tomahawk::result_ptr >& results );
+    void removeResult( const Tomahawk::query_ptr& query, const QString& resolver, const Tomahawk::result_ptr& result );
+    void removeResolver( const QString& resolver ) { m_removedResolvers << resolver; }
+
+    bool isEmpty() const { return m_entries.isEmpty() && m_removedResults.isEmpty() && m_removedResolvers.isEmpty(); }
+
+private:
+    struct CachedResult
+    {
+        QVariant source;
+        QString url;
+        QString artist;
+        QString album;
+        QString track;
+        QString mimetype;
+        unsigned int duration;
+        unsigned int bitrate;
+        unsigned int size;
+        QString friendlySource;
+        float score;
+    };
+
+    struct Entry
+    {
+        QString artist;
+        QString track;
+        QString album;
+        QString resolver;
+        unsigned int expires;
+        QList< CachedResult > results;
+    };
+
+    struct RemovedResult
+    {
+        QString artist;
+        QString track;
+        QString album;
+        QString resolver;
+        QString url;
+    };
+
+    QList< Entry > m_entries;
+    QList< RemovedResult > m_removedResults;
+    QStringList m_removedResolvers;
+};
+
+#endif // DATABASECOMMAND_UPDATERESOLVECACHE_H
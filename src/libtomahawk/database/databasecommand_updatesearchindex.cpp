@@ -19,7 +19,6 @@
 #include "databasecommand_updatesearchindex.h"
 
 #include "databaseimpl.h"
-#include "tomahawksqlquery.h"
 #include "utils/logger.h"
 
 
@@ -30,34 +29,8 @@ DatabaseCommand_UpdateSearchIndex::DatabaseCommand_UpdateSearchIndex()
 }
 
 
-void
-DatabaseCommand_UpdateSearchIndex::indexTable( DatabaseImpl* db, const QString& table )
-{
-    qDebug() << Q_FUNC_INFO;
-
-    TomahawkSqlQuery query = db->newquery();
-    qDebug() << "Building index for" << table;
-    query.exec( QString( "SELECT id, name FROM %1" ).arg( table ) );
-
-    QMap< unsigned int, QString > fields;
-    while ( query.next() )
-    {
-        fields.insert( query.value( 0 ).toUInt(), query.value( 1 ).toString() );
-    }
-
-    db->m_fuzzyIndex->appendFields( table, fields );
-    qDebug() << "Building index for" << table << "finished.";
-}
-
-
 void
 DatabaseCommand_UpdateSearchIndex::exec( DatabaseImpl* db )
 {
-    db->m_fuzzyIndex->beginIndexing();
-
-    indexTable( db, "artist" );
-    indexTable( db, "album" );
-    indexTable( db, "track" );
-
-    db->m_fuzzyIndex->endIndexing();
+    db->m_fuzzyIndex->rebuild( db );
 }
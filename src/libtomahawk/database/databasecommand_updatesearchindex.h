@@ -34,11 +34,6 @@ public:
 
 signals:
     void indexUpdated();
-
-private:
-    void indexTable( DatabaseImpl* db, const QString& table );
-
-    QString table;
 };
 
 #endif // DATABASECOMMAND_UPDATESEARCHINDEX_H
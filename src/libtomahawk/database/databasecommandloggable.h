@@ -32,14 +32,23 @@ Q_PROPERTY(QString command READ commandname)
 public:
 
     explicit DatabaseCommandLoggable( QObject* parent = 0 )
-        : DatabaseCommand( parent )
+        : DatabaseCommand( parent ), m_updatesLastOp( true )
     {}
 
     explicit DatabaseCommandLoggable( const Tomahawk::source_ptr& s, QObject* parent = 0 )
-        : DatabaseCommand( s, parent )
+        : DatabaseCommand( s, parent ), m_updatesLastOp( true )
     {}
 
     virtual bool loggable() const { return true; }
+
+    // Once applied, an op synced from a peer becomes its source's lastop, which
+    // the next sync continues from. A snapshot only counts once it got applied
+    // completely, so all of its ops but the last one leave lastop alone.
+    bool updatesLastOp() const { return m_updatesLastOp; }
+    void setUpdatesLastOp( bool updates ) { m_updatesLastOp = updates; }
+
+private:
+    bool m_updatesLastOp;
 };
 
 #endif // DATABASECOMMANDLOGGABLE_H
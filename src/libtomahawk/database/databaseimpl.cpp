@@ -20,13 +20,18 @@
 #include "databaseimpl.h"
 
 #include <QCoreApplication>
+#include <QAtomicInt>
+#include <QDateTime>
 #include <QRegExp>
 #include <QStringList>
+#include <QTime>
 #include <QtAlgorithms>
 #include <QFile>
+#include <QMutex>
 
 #include "database/database.h"
 #include "databasecommand_updatesearchindex.h"
+#include "idcache.h"
 #include "sourcelist.h"
 #include "result.h"
 #include "artist.h"
@@ -40,14 +45,32 @@
 */
 #include "schema.sql.h"
 
-#define CURRENT_SCHEMA_VERSION 27
+#define CURRENT_SCHEMA_VERSION 32
 
+// page cache per connection, in KiB (negative values for PRAGMA cache_size)
+#define MASTER_CACHE_SIZE 16384
+#define READER_CACHE_SIZE 8192
+// memory-mapped I/O window per connection, in bytes
+#define MMAP_SIZE 268435456
+// how long a reader waits on a locked database (e.g. during a checkpoint), in ms
+#define BUSY_TIMEOUT 5000
+// prepared statements kept per connection
+#define MAX_CACHED_STATEMENTS 128
+// playlists whose last stored revision the writer keeps around
+#define MAX_CACHED_REVISIONS 64
 
-DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent )
+
+DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent, const QString& dbid )
     : QObject( (QObject*) parent )
+    , m_valid( true )
+    , m_hasFullTextIndex( false )
+    , m_connectionName( "tomahawk" )
+    , m_workerThread( 0 )
     , m_lastartid( 0 )
     , m_lastalbid( 0 )
     , m_lasttrkid( 0 )
+    , m_fuzzyIndex( 0 )
+    , m_isMaster( true )
 {
     bool schemaUpdated = false;
     int version = getDatabaseVersion( dbname );
@@ -66,7 +89,11 @@ DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent )
             db = QSqlDatabase::addDatabase( "QSQLITE", "tomahawk" );
             db.setDatabaseName( dbname );
             if( !db.open() )
-                throw "db moving failed";
+            {
+                tLog() << "Failed to open database for migration" << dbname << db.lastError().text();
+                m_valid = false;
+                return;
+            }
 
             TomahawkSqlQuery query = newquery();
             query.exec( "PRAGMA auto_vacuum = FULL" );
@@ -75,7 +102,8 @@ DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent )
             if ( !schemaUpdated )
             {
                 Q_ASSERT( false );
-                QTimer::singleShot( 0, qApp, SLOT( quit() ) );
+                // we're not necessarily running in the gui thread here
+                QMetaObject::invokeMethod( qApp, "quit", Qt::QueuedConnection );
             }
         }
     }
@@ -85,8 +113,9 @@ DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent )
         db.setDatabaseName( dbname );
         if ( !db.open() )
         {
-            tLog() << "Failed to open database" << dbname;
-            throw "failed to open db"; // TODO
+            tLog() << "Failed to open database" << dbname << db.lastError().text();
+            m_valid = false;
+            return;
         }
 
         if ( version < 0 )
@@ -101,34 +130,184 @@ DatabaseImpl::DatabaseImpl( const QString& dbname, Database* parent )
     }
     else
     {
-        m_dbid = uuid();
+        m_dbid = dbid.isEmpty() ? uuid() : dbid;
         query.exec( QString( "INSERT INTO settings(k,v) VALUES('dbid','%1')" ).arg( m_dbid ) );
     }
     tLog() << "Database ID:" << m_dbid;
 
-     // make sqlite behave how we want:
-    query.exec( "PRAGMA synchronous  = ON" );
-    query.exec( "PRAGMA foreign_keys = ON" );
-    //query.exec( "PRAGMA temp_store = MEMORY" );
+    setupConnection( true );
+    setupFullTextIndex();
 
     // in case of unclean shutdown last time:
     query.exec( "UPDATE source SET isonline = 'false'" );
+    // cached results of other sources are only valid while they're online
+    query.exec( QString( "DELETE FROM resolve_cache WHERE source IS NOT NULL OR expires <= %1" )
+                .arg( QDateTime::currentDateTime().toTime_t() ) );
+
+    m_fuzzyIndex = new FuzzyIndex( *this );
+    // so it follows us to the thread we get moved to
+    m_fuzzyIndex->setParent( this );
+    connect( m_fuzzyIndex, SIGNAL( indexReady() ), SIGNAL( indexReady() ) );
+}
+
+
+DatabaseImpl::DatabaseImpl( const DatabaseImpl* master )
+    : QObject()
+    , m_valid( true )
+    , m_hasFullTextIndex( master->m_hasFullTextIndex )
+    , m_workerThread( 0 )
+    , m_lastartid( 0 )
+    , m_lastalbid( 0 )
+    , m_lasttrkid( 0 )
+    , m_dbid( master->m_dbid )
+    , m_fuzzyIndex( master->m_fuzzyIndex )
+    , m_isMaster( false )
+{
+    static QAtomicInt connectionCounter;
+    m_connectionName = QString( "tomahawk_%1" ).arg( connectionCounter.fetchAndAddOrdered( 1 ) );
+
+    db = QSqlDatabase::addDatabase( "QSQLITE", m_connectionName );
+    db.setDatabaseName( master->db.databaseName() );
+    db.setConnectOptions( QString( "QSQLITE_BUSY_TIMEOUT=%1" ).arg( BUSY_TIMEOUT ) );
+    if ( !db.open() )
+    {
+        tLog() << "Failed to open database connection" << m_connectionName << db.lastError().text();
+        m_valid = false;
+        return;
+    }
 
-    m_fuzzyIndex = new FuzzyIndex( *this, schemaUpdated );
+    setupConnection( false );
 }
 
 
 DatabaseImpl::~DatabaseImpl()
 {
-    delete m_fuzzyIndex;
+    // they keep sqlite statements open, which would keep the connection busy
+    m_statements.clear();
+
+    if ( m_isMaster )
+    {
+        delete m_fuzzyIndex;
+        return;
+    }
+
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase( m_connectionName );
+}
+
+
+DatabaseImpl*
+DatabaseImpl::newConnection() const
+{
+    return new DatabaseImpl( this );
+}
+
+
+TomahawkSqlQuery
+DatabaseImpl::preparedQuery( const QString& sql )
+{
+    if ( QThread::currentThread() != m_workerThread )
+    {
+        TomahawkSqlQuery query = newquery();
+        query.prepare( sql );
+        return query;
+    }
+
+    QHash< QString, TomahawkSqlQuery >::iterator it = m_statements.find( sql );
+    if ( it != m_statements.end() )
+    {
+        // reset the statement in case the last user didn't step through all rows
+        it.value().finish();
+        return it.value();
+    }
+
+    if ( m_statements.count() >= MAX_CACHED_STATEMENTS )
+        m_statements.clear();
+
+    TomahawkSqlQuery query = newquery();
+    if ( !query.prepare( sql ) )
+        return query;
+
+    m_statements.insert( sql, query );
+    return query;
+}
+
+
+void
+DatabaseImpl::resetStatements()
+{
+    QHash< QString, TomahawkSqlQuery >::iterator it;
+    for ( it = m_statements.begin(); it != m_statements.end(); ++it )
+        it.value().finish();
 }
 
 
 void
-DatabaseImpl::loadIndex()
+DatabaseImpl::setupConnection( bool master )
 {
-    connect( m_fuzzyIndex, SIGNAL( indexReady() ), SIGNAL( indexReady() ) );
-    m_fuzzyIndex->loadLuceneIndex();
+    TomahawkSqlQuery query = newquery();
+
+    // WAL is persistent in the database file and lets the readers run
+    // concurrently with the single writer, so only the master sets it.
+    if ( master )
+    {
+        query.exec( "PRAGMA journal_mode = WAL" );
+        if ( query.next() )
+            tLog() << "Database journal mode:" << query.value( 0 ).toString();
+    }
+
+    // make sqlite behave how we want:
+    query.exec( "PRAGMA synchronous  = ON" );
+    query.exec( "PRAGMA foreign_keys = ON" );
+    query.exec( "PRAGMA temp_store = MEMORY" );
+    query.exec( QString( "PRAGMA cache_size = -%1" ).arg( master ? MASTER_CACHE_SIZE : READER_CACHE_SIZE ) );
+    query.exec( QString( "PRAGMA mmap_size = %1" ).arg( MMAP_SIZE ) );
+}
+
+
+void
+DatabaseImpl::setupFullTextIndex()
+{
+    // Qt's bundled sqlite is often built without fts, so try it on a throwaway
+    // table. Not a TomahawkSqlQuery, which would treat the failure as an error.
+    QSqlQuery probe( db );
+    m_hasFullTextIndex = probe.exec( "CREATE VIRTUAL TABLE temp.fts_probe USING fts4( x )" );
+
+    TomahawkSqlQuery query = newquery();
+    if ( !m_hasFullTextIndex )
+    {
+        tLog() << "SQLite lacks FTS4, filtering collections without full text index";
+
+        // the trigger would make every file delete fail without the fts module.
+        // Without it a stale file_fts gets rebuilt once fts4 is back.
+        query.exec( "DROP TRIGGER IF EXISTS file_fts_delete" );
+        return;
+    }
+    query.exec( "DROP TABLE temp.fts_probe" );
+
+    // the trigger keeps file_fts in sync with file, so if it's there the index is fine
+    query.exec( "SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = 'file_fts_delete'" );
+    if ( query.next() )
+        return;
+
+    tLog() << "Building full text index...";
+    db.transaction();
+
+    query.exec( "DROP TABLE IF EXISTS file_fts" );
+    query.exec( "CREATE VIRTUAL TABLE file_fts USING fts4( artist, album, track )" );
+    query.exec( "INSERT INTO file_fts(docid, artist, album, track) "
+                "SELECT file_join.file, artist.sortname, album.sortname, track.sortname "
+                "FROM file_join "
+                "JOIN artist ON artist.id = file_join.artist "
+                "JOIN track ON track.id = file_join.track "
+                "LEFT JOIN album ON album.id = file_join.album" );
+
+    // also catches files going away along with their source
+    query.exec( "CREATE TRIGGER file_fts_delete AFTER DELETE ON file "
+                "BEGIN DELETE FROM file_fts WHERE docid = old.id; END" );
+
+    db.commit();
 }
 
 
@@ -165,6 +344,11 @@ DatabaseImpl::updateSchema( int oldVersion )
         {
             cur++;
 
+            // sortnames are computed in code, so the new ones have to be in
+            // place before the script merges what became duplicates
+            if ( cur == 30 )
+                rebuildSortnames();
+
             QString path = QString( RESPATH "sql/dbmigrate-%1_to_%2.sql" ).arg( cur - 1 ).arg( cur );
             QFile script( path );
             if ( !script.exists() || !script.open( QIODevice::ReadOnly ) )
@@ -193,6 +377,44 @@ DatabaseImpl::updateSchema( int oldVersion )
 }
 
 
+void
+DatabaseImpl::rebuildSortnames()
+{
+    // the unique indexes are recreated by the migration script
+    TomahawkSqlQuery query = newquery();
+    query.exec( "DROP INDEX IF EXISTS artist_sortname" );
+    query.exec( "DROP INDEX IF EXISTS track_artist_sortname" );
+    query.exec( "DROP INDEX IF EXISTS album_artist_sortname" );
+
+    QStringList tables;
+    tables << "artist" << "track" << "album";
+    foreach ( const QString& table, tables )
+    {
+        TomahawkSqlQuery select = newquery();
+        select.setForwardOnly( true );
+        select.exec( QString( "SELECT id, name, sortname FROM %1" ).arg( table ) );
+
+        TomahawkSqlQuery update = newquery();
+        update.prepare( QString( "UPDATE %1 SET sortname = ? WHERE id = ?" ).arg( table ) );
+
+        int changed = 0;
+        while ( select.next() )
+        {
+            const QString s = normalizeName( select.value( 1 ).toString(), StripDiacritics | StripPunctuation );
+            if ( s == select.value( 2 ).toString() )
+                continue;
+
+            update.addBindValue( s );
+            update.addBindValue( select.value( 0 ) );
+            update.exec();
+            changed++;
+        }
+
+        tLog() << "Rebuilt sortnames of" << table << "- changed:" << changed;
+    }
+}
+
+
 QString
 DatabaseImpl::cleanSql( const QString& sql )
 {
@@ -207,16 +429,16 @@ Tomahawk::result_ptr
 DatabaseImpl::file( int fid )
 {
     Tomahawk::result_ptr r;
-    TomahawkSqlQuery query = newquery();
-    query.exec( QString( "SELECT url, mtime, size, md5, mimetype, duration, bitrate, "
-                         "file_join.artist, file_join.album, file_join.track, "
-                         "(select name from artist where id = file_join.artist) as artname, "
-                         "(select name from album  where id = file_join.album)  as albname, "
-                         "(select name from track  where id = file_join.track)  as trkname, "
-                         "source "
-                         "FROM file, file_join "
-                         "WHERE file.id = file_join.file AND file.id = %1" )
-                .arg( fid ) );
+    TomahawkSqlQuery query = preparedQuery( "SELECT url, mtime, size, md5, mimetype, duration, bitrate, "
+                                            "file_join.artist, file_join.album, file_join.track, "
+                                            "(select name from artist where id = file_join.artist) as artname, "
+                                            "(select name from album  where id = file_join.album)  as albname, "
+                                            "(select name from track  where id = file_join.track)  as trkname, "
+                                            "source "
+                                            "FROM file, file_join "
+                                            "WHERE file.id = file_join.file AND file.id = ?" );
+    query.addBindValue( fid );
+    query.exec();
 
     if ( query.next() )
     {
@@ -260,22 +482,97 @@ DatabaseImpl::file( int fid )
 }
 
 
+void
+DatabaseImpl::loadIdCache()
+{
+    QTime t;
+    t.start();
+
+    TomahawkSqlQuery query = newquery();
+    query.exec( "SELECT id, sortname FROM artist" );
+    while ( query.next() )
+        IdCache::artists()->insert( query.value( 1 ).toString(), query.value( 0 ).toInt() );
+
+    query.exec( "SELECT id, artist, sortname FROM album" );
+    while ( query.next() )
+        IdCache::albums()->insert( IdCache::albumKey( query.value( 1 ).toInt(), query.value( 2 ).toString() ), query.value( 0 ).toInt() );
+
+    IdCache::artists()->setLoaded();
+    IdCache::albums()->setLoaded();
+
+    tDebug() << "Loaded" << IdCache::artists()->count() << "artist and" << IdCache::albums()->count() << "album ids in" << t.elapsed() << "ms";
+}
+
+
+void
+DatabaseImpl::publishIds()
+{
+    for ( int i = 0; i < m_newArtistIds.count(); i++ )
+        IdCache::artists()->insert( m_newArtistIds.at( i ).first, m_newArtistIds.at( i ).second );
+    for ( int i = 0; i < m_newAlbumIds.count(); i++ )
+        IdCache::albums()->insert( m_newAlbumIds.at( i ).first, m_newAlbumIds.at( i ).second );
+
+    m_newArtistIds.clear();
+    m_newAlbumIds.clear();
+}
+
+
+void
+DatabaseImpl::discardIds()
+{
+    m_newArtistIds.clear();
+    m_newAlbumIds.clear();
+
+    // they may point to rows that are gone now
+    m_lastart.clear();
+    m_lastartid = 0;
+    m_lastalb.clear();
+    m_lastalbid = 0;
+    m_lastRevisions.clear();
+}
+
+
+bool
+DatabaseImpl::lastRevision( const QString& playlistguid, const QString& revguid, QStringList& entries ) const
+{
+    QHash< QString, QPair< QString, QStringList > >::const_iterator it = m_lastRevisions.constFind( playlistguid );
+    if ( it == m_lastRevisions.constEnd() || it.value().first != revguid )
+        return false;
+
+    entries = it.value().second;
+    return true;
+}
+
+
+void
+DatabaseImpl::setLastRevision( const QString& playlistguid, const QString& revguid, const QStringList& entries )
+{
+    if ( m_lastRevisions.count() >= MAX_CACHED_REVISIONS && !m_lastRevisions.contains( playlistguid ) )
+        m_lastRevisions.clear();
+
+    m_lastRevisions.insert( playlistguid, qMakePair( revguid, entries ) );
+}
+
+
 int
 DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
 {
     if ( m_lastart == name_orig )
         return m_lastartid;
 
-    int id = 0;
     QString sortname = DatabaseImpl::sortname( name_orig );
-
-    TomahawkSqlQuery query = newquery();
-    query.prepare( "SELECT id FROM artist WHERE sortname = ?" );
-    query.addBindValue( sortname );
-    query.exec();
-    if ( query.next() )
+    int id = IdCache::artists()->value( sortname );
+    if ( !id )
     {
-        id = query.value( 0 ).toInt();
+        TomahawkSqlQuery query = preparedQuery( "SELECT id FROM artist WHERE sortname = ?" );
+        query.addBindValue( sortname );
+        query.exec();
+        if ( query.next() )
+        {
+            // might have been inserted by this very transaction
+            id = query.value( 0 ).toInt();
+            m_newArtistIds << qMakePair( sortname, id );
+        }
     }
     if ( id )
     {
@@ -287,7 +584,7 @@ DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
     if ( autoCreate )
     {
         // not found, insert it.
-        query.prepare( "INSERT INTO artist(id,name,sortname) VALUES(NULL,?,?)" );
+        TomahawkSqlQuery query = preparedQuery( "INSERT INTO artist(id,name,sortname) VALUES(NULL,?,?)" );
         query.addBindValue( name_orig );
         query.addBindValue( sortname );
         if ( !query.exec() )
@@ -297,6 +594,7 @@ DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
         }
 
         id = query.lastInsertId().toInt();
+        m_newArtistIds << qMakePair( sortname, id );
         m_lastart = name_orig;
         m_lastartid = id;
     }
@@ -312,8 +610,7 @@ DatabaseImpl::trackId( int artistid, const QString& name_orig, bool autoCreate )
     QString sortname = DatabaseImpl::sortname( name_orig );
     //if( ( id = m_artistcache[sortname] ) ) return id;
 
-    TomahawkSqlQuery query = newquery();
-    query.prepare( "SELECT id FROM track WHERE artist = ? AND sortname = ?" );
+    TomahawkSqlQuery query = preparedQuery( "SELECT id FROM track WHERE artist = ? AND sortname = ?" );
     query.addBindValue( artistid );
     query.addBindValue( sortname );
     query.exec();
@@ -331,7 +628,7 @@ DatabaseImpl::trackId( int artistid, const QString& name_orig, bool autoCreate )
     if ( autoCreate )
     {
         // not found, insert it.
-        query.prepare( "INSERT INTO track(id,artist,name,sortname) VALUES(NULL,?,?,?)" );
+        query = preparedQuery( "INSERT INTO track(id,artist,name,sortname) VALUES(NULL,?,?,?)" );
         query.addBindValue( artistid );
         query.addBindValue( name_orig );
         query.addBindValue( sortname );
@@ -360,18 +657,20 @@ DatabaseImpl::albumId( int artistid, const QString& name_orig, bool autoCreate )
     if ( m_lastartid == artistid && m_lastalb == name_orig )
         return m_lastalbid;
 
-    int id = 0;
     QString sortname = DatabaseImpl::sortname( name_orig );
-    //if( ( id = m_albumcache[sortname] ) ) return id;
-
-    TomahawkSqlQuery query = newquery();
-    query.prepare( "SELECT id FROM album WHERE artist = ? AND sortname = ?" );
-    query.addBindValue( artistid );
-    query.addBindValue( sortname );
-    query.exec();
-    if ( query.next() )
+    const QString key = IdCache::albumKey( artistid, sortname );
+    int id = IdCache::albums()->value( key );
+    if ( !id )
     {
-        id = query.value( 0 ).toInt();
+        TomahawkSqlQuery query = preparedQuery( "SELECT id FROM album WHERE artist = ? AND sortname = ?" );
+        query.addBindValue( artistid );
+        query.addBindValue( sortname );
+        query.exec();
+        if ( query.next() )
+        {
+            id = query.value( 0 ).toInt();
+            m_newAlbumIds << qMakePair( key, id );
+        }
     }
     if ( id )
     {
@@ -383,7 +682,7 @@ DatabaseImpl::albumId( int artistid, const QString& name_orig, bool autoCreate )
     if ( autoCreate )
     {
         // not found, insert it.
-        query.prepare( "INSERT INTO album(id,artist,name,sortname) VALUES(NULL,?,?,?)" );
+        TomahawkSqlQuery query = preparedQuery( "INSERT INTO album(id,artist,name,sortname) VALUES(NULL,?,?,?)" );
         query.addBindValue( artistid );
         query.addBindValue( name_orig );
         query.addBindValue( sortname );
@@ -394,6 +693,7 @@ DatabaseImpl::albumId( int artistid, const QString& name_orig, bool autoCreate )
         }
 
         id = query.lastInsertId().toInt();
+        m_newAlbumIds << qMakePair( key, id );
         m_lastalb = name_orig;
         m_lastalbid = id;
     }
@@ -402,6 +702,30 @@ DatabaseImpl::albumId( int artistid, const QString& name_orig, bool autoCreate )
 }
 
 
+unsigned int
+DatabaseImpl::resolveArtistId( const Tomahawk::Artist* artist )
+{
+    if ( artist->id() > 0 || !artist->idPending() )
+        return artist->id();
+
+    return qMax( 0, artistId( artist->name(), false ) );
+}
+
+
+unsigned int
+DatabaseImpl::resolveAlbumId( const Tomahawk::Album* album )
+{
+    if ( album->id() > 0 || !album->idPending() )
+        return album->id();
+
+    const unsigned int artistid = resolveArtistId( album->artist().data() );
+    if ( artistid == 0 )
+        return 0;
+
+    return qMax( 0, albumId( artistid, album->name(), false ) );
+}
+
+
 QList< QPair<int, float> >
 DatabaseImpl::searchTable( const QString& table, const QString& name, uint limit )
 {
@@ -422,6 +746,20 @@ DatabaseImpl::searchTable( const QString& table, const QString& name, uint limit
 }
 
 
+void
+DatabaseImpl::addToSearchIndex( const QString& table, const QMap< unsigned int, QString >& fields )
+{
+    m_fuzzyIndex->updateFields( table, fields );
+}
+
+
+void
+DatabaseImpl::removeFromSearchIndex( const QString& table, const QList< unsigned int >& ids )
+{
+    m_fuzzyIndex->deleteFields( table, ids );
+}
+
+
 QList< int >
 DatabaseImpl::getTrackFids( int tid )
 {
@@ -440,20 +778,248 @@ DatabaseImpl::getTrackFids( int tid )
 }
 
 
+// Letters that have no Unicode decomposition but still are just variants of
+// plain latin letters, as far as matching names goes.
+static const char*
+foldedLetter( ushort c )
+{
+    switch ( c )
+    {
+        case 0x00C6: case 0x00E6: return "ae"; // Æ æ
+        case 0x00D0: case 0x00F0: return "d";  // Ð ð
+        case 0x00D8: case 0x00F8: return "o";  // Ø ø
+        case 0x00DE: case 0x00FE: return "th"; // Þ þ
+        case 0x00DF: return "ss";              // ß
+        case 0x0110: case 0x0111: return "d";  // Đ đ
+        case 0x0131: return "i";               // ı
+        case 0x0141: case 0x0142: return "l";  // Ł ł
+        case 0x0152: case 0x0153: return "oe"; // Œ œ
+        default: return 0;
+    }
+}
+
+
+static void
+appendNormalized( QChar c, QString& out, bool& pendingSpace, DatabaseImpl::SortnameFlags flags, int depth = 0 )
+{
+    const ushort u = c.unicode();
+
+    if ( u < 0x80 )
+    {
+        if ( u >= 'A' && u <= 'Z' )
+            c = QChar( u + ( 'a' - 'A' ) );
+        else if ( u == ' ' || ( u >= '\t' && u <= '\r' ) )
+        {
+            pendingSpace = true;
+            return;
+        }
+        else if ( u < 0x20 || u == 0x7f )
+            return;
+        else if ( ( flags & DatabaseImpl::StripPunctuation ) && c.isPunct() )
+            return;
+    }
+    else
+    {
+        if ( c.isSpace() )
+        {
+            pendingSpace = true;
+            return;
+        }
+        if ( c.category() == QChar::Other_Format || c.category() == QChar::Other_Control )
+            return;
+
+        if ( flags & DatabaseImpl::StripDiacritics )
+        {
+            // combining diacritical marks, as used by latin, greek and cyrillic.
+            // Marks of other scripts (e.g. kana voicing) change the letter, so they stay
+            if ( u >= 0x0300 && u <= 0x036F )
+                return;
+
+            if ( const char* folded = foldedLetter( u ) )
+            {
+                for ( ; *folded; folded++ )
+                    appendNormalized( QLatin1Char( *folded ), out, pendingSpace, flags, depth + 1 );
+                return;
+            }
+
+            // hangul syllables decompose into jamo, which doesn't help matching
+            const bool hangul = ( u >= 0xAC00 && u <= 0xD7A3 );
+            if ( !hangul && depth < 4 && c.decompositionTag() != QChar::NoDecomposition )
+            {
+                const QString decomposed = c.decomposition();
+                for ( int i = 0; i < decomposed.length(); i++ )
+                    appendNormalized( decomposed.at( i ), out, pendingSpace, flags, depth + 1 );
+                return;
+            }
+        }
+
+        if ( ( flags & DatabaseImpl::StripPunctuation ) && c.isPunct() )
+            return;
+
+        c = c.toCaseFolded();
+    }
+
+    if ( pendingSpace )
+    {
+        if ( !out.isEmpty() )
+            out += QLatin1Char( ' ' );
+        pendingSpace = false;
+    }
+    out += c;
+}
+
+
+QString
+DatabaseImpl::normalizeName( const QString& str, SortnameFlags flags )
+{
+    QString s;
+    s.reserve( str.length() );
+
+    bool pendingSpace = false;
+    const QChar* data = str.constData();
+    for ( int i = 0; i < str.length(); i++ )
+        appendNormalized( data[i], s, pendingSpace, flags );
+
+    // names made up of punctuation only ("!!!") would end up empty
+    if ( s.isEmpty() && ( flags & StripPunctuation ) )
+        return normalizeName( str, flags & ~StripPunctuation );
+
+    if ( ( flags & StripArticle ) && s.length() > 4 && s.startsWith( QLatin1String( "the " ) ) )
+        s.remove( 0, 4 );
+
+    s.squeeze();
+    return s;
+}
+
+
+// Memo cache for sortname(), sharded to keep the scanner and resolver threads
+// from contending on a single lock.
+#define SORTNAME_CACHE_SHARDS 16
+#define SORTNAME_CACHE_SHARD_SIZE 2048
+#define SORTNAME_CACHE_MAX_LENGTH 128
+
+struct SortnameCacheShard
+{
+    QMutex mutex;
+    QHash< QString, QString > names[2]; // without / with the article stripped
+};
+
+static SortnameCacheShard s_sortnameCache[ SORTNAME_CACHE_SHARDS ];
+
+
 QString
 DatabaseImpl::sortname( const QString& str, bool replaceArticle )
 {
-    QString s = str.toLower().trimmed().replace( QRegExp( "[\\s]{2,}" ), " " );
+    SortnameFlags flags = StripDiacritics | StripPunctuation;
+    if ( replaceArticle )
+        flags |= StripArticle;
 
-    if ( replaceArticle && s.startsWith( "the " ) )
+    if ( str.length() > SORTNAME_CACHE_MAX_LENGTH )
+        return normalizeName( str, flags );
+
+    SortnameCacheShard& shard = s_sortnameCache[ qHash( str ) % SORTNAME_CACHE_SHARDS ];
+    QHash< QString, QString >& names = shard.names[ replaceArticle ? 1 : 0 ];
     {
-        s = s.right( s.length() - 4 );
+        QMutexLocker lock( &shard.mutex );
+        QHash< QString, QString >::const_iterator it = names.constFind( str );
+        if ( it != names.constEnd() )
+            return it.value();
     }
 
+    const QString s = normalizeName( str, flags );
+
+    QMutexLocker lock( &shard.mutex );
+    if ( names.count() >= SORTNAME_CACHE_SHARD_SIZE )
+        names.clear();
+    names.insert( str, s );
+
     return s;
 }
 
 
+QString
+DatabaseImpl::filterMatchQuery( const QString& filter )
+{
+    // file_fts holds sortnames, so normalize the words the same way
+    QStringList terms;
+    foreach ( const QString& word, sortname( filter ).split( ' ', QString::SkipEmptyParts ) )
+    {
+        // leave out whatever fts would parse as query syntax
+        QString term;
+        foreach ( const QChar& c, word )
+        {
+            if ( c.unicode() > 0x7f || c.isLetterOrNumber() )
+                term += c;
+        }
+
+        if ( !term.isEmpty() )
+            terms << term + QLatin1Char( '*' );
+    }
+
+    return terms.join( " " );
+}
+
+
+QString
+DatabaseImpl::prefixEnd( const QString& prefix )
+{
+    Q_ASSERT( !prefix.isEmpty() );
+
+    // sqlite compares text bytewise, which for utf-8 is code point order
+    QString end = prefix;
+    end[ end.length() - 1 ] = QChar( end.at( end.length() - 1 ).unicode() + 1 );
+    return end;
+}
+
+
+QString
+DatabaseImpl::globEscape( const QString& str )
+{
+    QString escaped;
+    foreach ( const QChar& c, str )
+    {
+        if ( c == '*' || c == '?' || c == '[' )
+            escaped += QString( "[%1]" ).arg( c );
+        else
+            escaped += c;
+    }
+
+    return escaped;
+}
+
+
+QString
+DatabaseImpl::filterCondition( const QString& column, const QString& filter, QVariantList& binds ) const
+{
+    if ( m_hasFullTextIndex )
+    {
+        const QString match = filterMatchQuery( filter );
+        if ( match.isEmpty() )
+            return QString();
+
+        binds << match;
+        return QString( "AND %1 IN ( SELECT docid FROM file_fts WHERE file_fts MATCH ? )" ).arg( column );
+    }
+
+    QStringList words;
+    foreach ( const QString& word, filter.split( ' ', QString::SkipEmptyParts ) )
+    {
+        const QString pattern = QString( "%%1%" ).arg( word );
+        binds << pattern << pattern << pattern;
+        words << "( artist.name LIKE ? OR album.name LIKE ? OR track.name LIKE ? )";
+    }
+
+    if ( words.isEmpty() )
+        return QString();
+
+    return QString( "AND %1 IN ( SELECT file_join.file FROM file_join "
+                    "JOIN artist ON artist.id = file_join.artist "
+                    "JOIN track ON track.id = file_join.track "
+                    "LEFT JOIN album ON album.id = file_join.album "
+                    "WHERE %2 )" ).arg( column ).arg( words.join( " AND " ) );
+}
+
+
 QVariantMap
 DatabaseImpl::artist( int id )
 {
@@ -511,7 +1077,6 @@ Tomahawk::result_ptr
 DatabaseImpl::resultFromHint( const Tomahawk::query_ptr& origquery )
 {
     QString url = origquery->resultHint();
-    TomahawkSqlQuery query = newquery();
     Tomahawk::source_ptr s;
     Tomahawk::result_ptr res;
     QString fileUrl;
@@ -569,10 +1134,12 @@ DatabaseImpl::resultFromHint( const Tomahawk::query_ptr& origquery )
                             "file_join.file = file.id AND "
                             "file.id = track_attributes.id AND "
                             "file.url = ?"
-        ).arg( searchlocal ? "IS NULL" : QString( "= %1" ).arg( s->id() ) );
+        ).arg( searchlocal ? "IS NULL" : "= ?" );
 
-    query.prepare( sql );
-    query.bindValue( 0, fileUrl );
+    TomahawkSqlQuery query = preparedQuery( sql );
+    if ( !searchlocal )
+        query.addBindValue( s->id() );
+    query.addBindValue( fileUrl );
     query.exec();
 
     if( query.next() )
@@ -626,22 +1193,43 @@ DatabaseImpl::getDatabaseVersion( const QString& dbname )
     {
         QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", "tomahawk" );
         db.setDatabaseName( dbname );
-        if ( !db.open() )
+        // opening it again fails the same way, and is reported there
+        if ( db.open() )
         {
-            tLog() << "Failed to open database" << dbname;
-            throw "failed to open db"; // TODO
+            QSqlQuery qry = QSqlQuery( db );
+            qry.exec( "SELECT v FROM settings WHERE k='schema_version'" );
+            if ( qry.next() )
+            {
+                version = qry.value( 0 ).toInt();
+                tLog() << "Database schema of" << dbname << "is" << version;
+            }
         }
+    }
 
-        QSqlQuery qry = QSqlQuery( db );
-        qry.exec( "SELECT v FROM settings WHERE k='schema_version'" );
-        if ( qry.next() )
+    QSqlDatabase::removeDatabase( "tomahawk" );
+
+    return version;
+}
+
+
+QString
+DatabaseImpl::getDatabaseId( const QString& dbname )
+{
+    QString dbid;
+    {
+        // not "tomahawk", the database may be opened on another thread meanwhile
+        QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", "tomahawk_dbid" );
+        db.setDatabaseName( dbname );
+        if ( db.open() )
         {
-            version = qry.value( 0 ).toInt();
-            tLog() << "Database schema of" << dbname << "is" << version;
+            QSqlQuery qry = QSqlQuery( db );
+            qry.exec( "SELECT v FROM settings WHERE k='dbid'" );
+            if ( qry.next() )
+                dbid = qry.value( 0 ).toString();
         }
     }
 
-    QSqlDatabase::removeDatabase( "tomahawk" );
+    QSqlDatabase::removeDatabase( "tomahawk_dbid" );
 
-    return version;
+    return dbid;
 }
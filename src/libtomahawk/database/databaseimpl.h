@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QList>
 #include <QPair>
+#include <QStringList>
 #include <QVariant>
 #include <QVariantMap>
 #include <QSqlDatabase>
@@ -44,22 +45,94 @@ friend class FuzzyIndex;
 friend class DatabaseCommand_UpdateSearchIndex;
 
 public:
+    /// How normalizeName() turns a name into a sortname. Case folding and
+    /// whitespace collapsing always happen.
+    enum SortnameFlag
+    {
+        NoSortnameFlags = 0x0,
+        StripArticle = 0x1,     // "The Beatles" -> "beatles"
+        StripDiacritics = 0x2,  // "Björk" -> "bjork"
+        StripPunctuation = 0x4  // "AC/DC" -> "acdc"
+    };
+    Q_DECLARE_FLAGS( SortnameFlags, SortnameFlag )
+
     static int getDatabaseVersion( const QString& dbname );
+    // the dbid stored in the database, without opening it for real
+    static QString getDatabaseId( const QString& dbname );
 
-    DatabaseImpl( const QString& dbname, Database* parent = 0 );
+    // a database without a dbid yet gets \a dbid, or a fresh one if that's empty
+    DatabaseImpl( const QString& dbname, Database* parent = 0, const QString& dbid = QString() );
     ~DatabaseImpl();
 
+    // Opens a separate connection to the same database file, sharing the search
+    // index and dbid with this instance. Must be called from the thread that is
+    // going to use the returned connection, which the caller owns.
+    DatabaseImpl* newConnection() const;
+
+    // False if the database couldn't be opened. Don't use the instance then.
+    bool isValid() const { return m_valid; }
+
     TomahawkSqlQuery newquery() { return TomahawkSqlQuery( db ); }
     QSqlDatabase& database() { return db; }
 
+    // Returns the statement for sql, prepared only once per connection. Bind
+    // and exec() it like a fresh query, but don't hold on to it: the next
+    // call for the same sql resets it. Only the connection's worker thread
+    // gets cached statements, everybody else a freshly prepared query.
+    TomahawkSqlQuery preparedQuery( const QString& sql );
+    void resetStatements();
+    void setWorkerThread( QThread* thread ) { m_workerThread = thread; }
+
+    // Reads all artist and album ids into the IdCache, see there.
+    void loadIdCache();
+    // artistId() and albumId() hand the ids they find or create to the IdCache
+    // only once the worker has committed, so a rolled back row never ends up
+    // in it. discardIds() also forgets the last ids and revisions looked up.
+    void publishIds();
+    void discardIds();
+
+    // The entries of the revision last stored for a playlist, so storing the
+    // next one doesn't have to replay the delta chain it's based on.
+    bool lastRevision( const QString& playlistguid, const QString& revguid, QStringList& entries ) const;
+    void setLastRevision( const QString& playlistguid, const QString& revguid, const QStringList& entries );
+
     int artistId( const QString& name_orig, bool autoCreate );
     int trackId( int artistid, const QString& name_orig, bool autoCreate );
     int albumId( int artistid, const QString& name_orig, bool autoCreate );
 
+    // The id of an artist or album, looked up by name while the one of its
+    // own is still pending (see Artist::get()), so commands don't take the 0.
+    unsigned int resolveArtistId( const Tomahawk::Artist* artist );
+    unsigned int resolveAlbumId( const Tomahawk::Album* album );
+
     QList< QPair<int, float> > searchTable( const QString& table, const QString& name, uint limit = 10 );
+    void addToSearchIndex( const QString& table, const QMap< unsigned int, QString >& fields );
+    void removeFromSearchIndex( const QString& table, const QList< unsigned int >& ids );
     QList< int > getTrackFids( int tid );
 
+    // Normalized name used as the artist/track/album key, memoized for hot names.
     static QString sortname( const QString& str, bool replaceArticle = false );
+    static QString normalizeName( const QString& str, SortnameFlags flags );
+
+    // FTS query for the file_fts table matching files whose artist, album and
+    // track names contain a word starting with each word of filter. Empty if
+    // the filter has no words to look for.
+    static QString filterMatchQuery( const QString& filter );
+
+    // Exclusive upper bound of the strings starting with prefix, for an exact,
+    // case sensitive "x >= prefix AND x < prefixEnd( prefix )" that can use an
+    // index. Unlike LIKE, which treats _ and % as wildcards and ignores case.
+    static QString prefixEnd( const QString& prefix );
+    // str with the GLOB wildcards escaped, so it only matches itself.
+    static QString globEscape( const QString& str );
+
+    // False if sqlite lacks fts4, file_fts doesn't exist then.
+    bool hasFullTextIndex() const { return m_hasFullTextIndex; }
+
+    // "AND <column> IN ( ... )" restricting file ids to the files matching
+    // filter, appending its values to binds. Goes through file_fts if there
+    // is one, or falls back to LIKE on the names. Empty for an empty filter.
+    QString filterCondition( const QString& column, const QString& filter, QVariantList& binds ) const;
 
     QVariantMap artist( int id );
     QVariantMap album( int id );
@@ -74,25 +147,41 @@ public:
 
     QString dbid() const { return m_dbid; }
 
-    void loadIndex();
-
 signals:
     void indexReady();
 
 public slots:
 
 private:
+    DatabaseImpl( const DatabaseImpl* master );
+
+    void setupConnection( bool master );
+
     QString cleanSql( const QString& sql );
     bool updateSchema( int oldVersion );
+    void setupFullTextIndex();
+    void rebuildSortnames();
 
     bool m_ready;
+    bool m_valid;
+    bool m_hasFullTextIndex;
     QSqlDatabase db;
+    QString m_connectionName;
+
+    QThread* m_workerThread;
+    QHash< QString, TomahawkSqlQuery > m_statements;
 
     QString m_lastart, m_lastalb, m_lasttrk;
     int m_lastartid, m_lastalbid, m_lasttrkid;
+    QList< QPair< QString, int > > m_newArtistIds, m_newAlbumIds;
+    QHash< QString, QPair< QString, QStringList > > m_lastRevisions;
 
+    // shared between all connections, owned by the master connection
     QString m_dbid;
     FuzzyIndex* m_fuzzyIndex;
+    bool m_isMaster;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS( DatabaseImpl::SortnameFlags )
+
 #endif // DATABASEIMPL_H
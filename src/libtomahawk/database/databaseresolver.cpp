@@ -21,10 +21,14 @@
 #include "pipeline.h"
 #include "network/servent.h"
 #include "database/database.h"
-#include "database/databasecommand_resolve.h"
+#include "database/databasecommand_resolvebatch.h"
 
 #include "utils/logger.h"
 
+#include <QTimer>
+
+#define MAX_BATCH_SIZE 500
+
 
 DatabaseResolver::DatabaseResolver( int weight )
     : Resolver()
@@ -36,13 +40,33 @@ DatabaseResolver::DatabaseResolver( int weight )
 void
 DatabaseResolver::resolve( const Tomahawk::query_ptr& query )
 {
-    DatabaseCommand_Resolve* cmd = new DatabaseCommand_Resolve( query );
+    if ( m_pendingIds.contains( query->id() ) )
+        return;
+
+    m_pending << query;
+    m_pendingIds << query->id();
+
+    if ( m_pending.count() >= MAX_BATCH_SIZE )
+        resolvePending();
+    else if ( m_pending.count() == 1 )
+        QTimer::singleShot( 0, this, SLOT( resolvePending() ) );
+}
+
+
+void
+DatabaseResolver::resolvePending()
+{
+    if ( m_pending.isEmpty() )
+        return;
+
+    DatabaseCommand_ResolveBatch* cmd = new DatabaseCommand_ResolveBatch( m_pending );
+    m_pending.clear();
+    m_pendingIds.clear();
 
     connect( cmd, SIGNAL( results( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ),
                     SLOT( gotResults( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ), Qt::QueuedConnection );
 
     Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
-
 }
 
 
@@ -55,6 +79,22 @@ DatabaseResolver::gotResults( const Tomahawk::QID qid, QList< Tomahawk::result_p
 }
 
 
+unsigned int
+DatabaseResolver::maxConcurrentQueries() const
+{
+    // we resolve in batches, so let the pipeline hand us a whole batch at once
+    return MAX_BATCH_SIZE;
+}
+
+
+unsigned int
+DatabaseResolver::resultCacheTtl() const
+{
+    // only results from other sources get cached, and those are dropped when the source goes offline
+    return 60 * 60;
+}
+
+
 QString
 DatabaseResolver::name() const
 {
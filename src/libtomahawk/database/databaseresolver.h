@@ -19,6 +19,8 @@
 #ifndef DATABASERESOLVER_H
 #define DATABASERESOLVER_H
 
+#include <QSet>
+
 #include "resolver.h"
 #include "result.h"
 
@@ -35,15 +37,22 @@ public:
     virtual unsigned int weight() const { return m_weight; }
     virtual unsigned int preference() const { return 100; }
     virtual unsigned int timeout() const { return 0; }
+    virtual unsigned int maxConcurrentQueries() const;
+    virtual unsigned int resultCacheTtl() const;
 
 public slots:
     virtual void resolve( const Tomahawk::query_ptr& query );
 
 private slots:
+    void resolvePending();
     void gotResults( const Tomahawk::QID qid, QList< Tomahawk::result_ptr> results );
 
 private:
     int m_weight;
+
+    // queries dispatched to us during this event loop iteration, resolved as one batch
+    QList< Tomahawk::query_ptr > m_pending;
+    QSet< Tomahawk::QID > m_pendingIds;
 };
 
 #endif // DATABASERESOLVER_H
@@ -35,12 +35,13 @@
 
 DatabaseWorker::DatabaseWorker( DatabaseImpl* lib, Database* db, bool mutates )
     : QThread()
+    , m_db( db )
     , m_dbimpl( lib )
+    , m_connection( 0 )
+    , m_mutates( mutates )
     , m_outstanding( 0 )
+    , m_failed( 0 )
 {
-    Q_UNUSED( db );
-    Q_UNUSED( mutates );
-
     moveToThread( this );
 
     qDebug() << "CTOR DatabaseWorker" << this->thread();
@@ -67,7 +68,35 @@ DatabaseWorker::~DatabaseWorker()
 void
 DatabaseWorker::run()
 {
+    // Read-only workers get their own sqlite connection, so they don't serialize
+    // on the master connection used by the RW worker. QSqlDatabase connections
+    // may only be used from the thread that created them, hence we open it here.
+    if ( !m_mutates )
+    {
+        m_connection = m_dbimpl->newConnection();
+        if ( m_connection->isValid() )
+        {
+            m_dbimpl = m_connection;
+        }
+        else
+        {
+            tLog() << "Read-only database worker has no connection, handing its commands to the rw worker";
+            delete m_connection;
+            m_connection = 0;
+            m_failed = 1;
+        }
+    }
+    if ( !m_failed )
+        m_dbimpl->setWorkerThread( this );
+
     exec();
+
+    if ( m_connection )
+    {
+        delete m_connection;
+        m_connection = 0;
+    }
+
     qDebug() << Q_FUNC_INFO << "DatabaseWorker finishing...";
 }
 
@@ -96,9 +125,33 @@ DatabaseWorker::enqueue( const QSharedPointer<DatabaseCommand>& cmd )
 }
 
 
+void
+DatabaseWorker::handOver()
+{
+    QList< QSharedPointer<DatabaseCommand> > cmds;
+    {
+        QMutexLocker lock( &m_mut );
+        cmds = m_commands;
+        m_commands.clear();
+        m_outstanding = 0;
+    }
+    if ( cmds.isEmpty() )
+        return;
+
+    // the master connection must only be used from the rw worker's thread
+    m_db->workerRW()->enqueue( cmds );
+}
+
+
 void
 DatabaseWorker::doWork()
 {
+    if ( m_failed )
+    {
+        handOver();
+        return;
+    }
+
     /*
         Run the dbcmd. Only inside a transaction if the cmd does mutates.
 
@@ -155,10 +208,9 @@ DatabaseWorker::doWork()
                         // Make a note of the last guid we applied for this source
                         // so we can always request just the newer ops in future.
                         //
-                        if ( !cmd->singletonCmd() )
+                        if ( !cmd->singletonCmd() && ( (DatabaseCommandLoggable*)cmd.data() )->updatesLastOp() )
                         {
-                            TomahawkSqlQuery query = m_dbimpl->newquery();
-                            query.prepare( "UPDATE source SET lastop = ? WHERE id = ?" );
+                            TomahawkSqlQuery query = m_dbimpl->preparedQuery( "UPDATE source SET lastop = ? WHERE id = ?" );
                             query.addBindValue( cmd->guid() );
                             query.addBindValue( cmd->source()->id() );
 
@@ -187,6 +239,9 @@ DatabaseWorker::doWork()
                     finished = true;
             }
 
+            // don't keep read transactions open with half-stepped statements
+            m_dbimpl->resetStatements();
+
             if ( cmd->doesMutates() )
             {
                 qDebug() << "Committing" << cmd->commandname() << cmd->guid();
@@ -197,6 +252,9 @@ DatabaseWorker::doWork()
                 }
             }
 
+            // only now that they're committed can others see the new ids
+            m_dbimpl->publishIds();
+
 #ifdef DEBUG_TIMING
             uint duration = timer.elapsed();
             tDebug() << "DBCmd Duration:" << duration << "ms, now running postcommit for" << cmd->commandname();
@@ -222,6 +280,12 @@ DatabaseWorker::doWork()
 
         if ( cmd->doesMutates() )
             m_dbimpl->database().rollback();
+        m_dbimpl->discardIds();
+
+        // whoever waits for the failed command (and the rest of the rolled back group)
+        // must still hear that it's done, it just didn't get committed
+        if ( !cmdGroup.contains( cmd ) )
+            cmdGroup << cmd;
 
         Q_ASSERT( false );
     }
@@ -230,6 +294,12 @@ DatabaseWorker::doWork()
         qDebug() << "Uncaught exception processing dbcmd";
         if ( cmd->doesMutates() )
             m_dbimpl->database().rollback();
+        m_dbimpl->discardIds();
+
+        if ( !cmdGroup.contains( cmd ) )
+            cmdGroup << cmd;
+        foreach ( QSharedPointer<DatabaseCommand> c, cmdGroup )
+            c->emitFinished();
 
         Q_ASSERT( false );
         throw;
@@ -249,9 +319,8 @@ DatabaseWorker::doWork()
 void
 DatabaseWorker::logOp( DatabaseCommandLoggable* command )
 {
-    TomahawkSqlQuery oplogquery = m_dbimpl->newquery();
-    oplogquery.prepare( "INSERT INTO oplog(source, guid, command, singleton, compressed, json) "
-                        "VALUES(?, ?, ?, ?, ?, ?)" );
+    TomahawkSqlQuery oplogquery = m_dbimpl->preparedQuery( "INSERT INTO oplog(source, guid, command, singleton, compressed, json) "
+                                                           "VALUES(?, ?, ?, ?, ?, ?)" );
 
     QVariantMap variant = QJson::QObjectHelper::qobject2qvariant( command );
     QByteArray ba = m_serializer.serialize( variant );
@@ -19,6 +19,7 @@
 #ifndef DATABASEWORKER_H
 #define DATABASEWORKER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include <QThread>
 #include <QMutex>
@@ -42,6 +43,10 @@ public:
     DatabaseWorker( DatabaseImpl*, Database*, bool mutates );
     ~DatabaseWorker();
 
+    // False once a read-only worker failed to open its own connection. It
+    // then hands all its commands over to the read-write worker.
+    bool isValid() const { return !m_failed; }
+
     bool busy() const { return m_outstanding > 0; }
     unsigned int outstandingJobs() const { return m_outstanding; }
 
@@ -57,11 +62,16 @@ private slots:
 
 private:
     void logOp( DatabaseCommandLoggable* command );
+    void handOver();
 
     QMutex m_mut;
+    Database* m_db;
     DatabaseImpl* m_dbimpl;
+    DatabaseImpl* m_connection;
+    bool m_mutates;
     QList< QSharedPointer<DatabaseCommand> > m_commands;
     int m_outstanding;
+    QAtomicInt m_failed;
 
     QJson::Serializer m_serializer;
 };
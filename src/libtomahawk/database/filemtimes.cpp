@@ -0,0 +1,169 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "filemtimes.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+struct FileMtimes::NameLess
+{
+    explicit NameLess( const QByteArray& names ) : m_names( names.constData() ) {}
+
+    bool operator()( const File& a, const File& b ) const
+    {
+        return compare( m_names + a.nameOffset, a.nameLength, m_names + b.nameOffset, b.nameLength ) < 0;
+    }
+
+    bool operator()( const File& a, const QByteArray& b ) const
+    {
+        return compare( m_names + a.nameOffset, a.nameLength, b.constData(), b.length() ) < 0;
+    }
+
+    static int compare( const char* a, unsigned int alen, const char* b, unsigned int blen )
+    {
+        const int r = memcmp( a, b, qMin( alen, blen ) );
+        if ( r != 0 )
+            return r;
+
+        return alen < blen ? -1 : ( alen > blen ? 1 : 0 );
+    }
+
+    const char* m_names;
+};
+
+
+FileMtimes::FileMtimes()
+    : m_count( 0 )
+{
+}
+
+
+void
+FileMtimes::split( const QString& path, QString* dir, QByteArray* name )
+{
+    const int start = path.startsWith( "file://" ) ? 7 : 0;
+    const int slash = path.lastIndexOf( '/' );
+
+    *dir = path.mid( start, slash - start );
+    *name = path.mid( slash + 1 ).toUtf8();
+}
+
+
+void
+FileMtimes::sort( Dir& dir )
+{
+    std::sort( dir.files.begin(), dir.files.end(), NameLess( dir.names ) );
+    dir.sorted = true;
+}
+
+
+void
+FileMtimes::insert( const QString& path, unsigned int id, unsigned int mtime )
+{
+    QString dirPath;
+    QByteArray name;
+    split( path, &dirPath, &name );
+
+    Dir& dir = m_dirs[ dirPath ];
+
+    File f;
+    f.nameOffset = dir.names.length();
+    f.nameLength = name.length();
+    f.id = id;
+    f.mtime = mtime;
+
+    // only sort dirs that didn't come in order already
+    if ( dir.sorted && !dir.files.isEmpty() )
+    {
+        const File& last = dir.files.last();
+        dir.sorted = NameLess::compare( dir.names.constData() + last.nameOffset, last.nameLength, name.constData(), name.length() ) < 0;
+    }
+
+    dir.names.append( name );
+    dir.files.append( f );
+    m_count++;
+}
+
+
+void
+FileMtimes::squeeze()
+{
+    QHash< QString, Dir >::iterator it = m_dirs.begin();
+    for ( ; it != m_dirs.end(); ++it )
+    {
+        if ( !it.value().sorted )
+            sort( it.value() );
+
+        it.value().names.squeeze();
+        it.value().files.squeeze();
+    }
+
+    m_dirs.squeeze();
+}
+
+
+bool
+FileMtimes::take( const QString& path, unsigned int* id, unsigned int* mtime )
+{
+    QString dirPath;
+    QByteArray name;
+    split( path, &dirPath, &name );
+
+    QHash< QString, Dir >::iterator it = m_dirs.find( dirPath );
+    if ( it == m_dirs.end() )
+        return false;
+
+    Dir& dir = it.value();
+    if ( !dir.sorted )
+        sort( dir );
+
+    NameLess less( dir.names );
+    QVector< File >::iterator f = std::lower_bound( dir.files.begin(), dir.files.end(), name, less );
+    if ( f == dir.files.end() || f->id == 0 ||
+         NameLess::compare( dir.names.constData() + f->nameOffset, f->nameLength, name.constData(), name.length() ) != 0 )
+        return false;
+
+    *id = f->id;
+    *mtime = f->mtime;
+    f->id = 0;
+
+    if ( --m_count == 0 )
+        m_dirs.clear();
+
+    return true;
+}
+
+
+QList< unsigned int >
+FileMtimes::remainingIds() const
+{
+    QList< unsigned int > ids;
+    foreach ( const Dir& dir, m_dirs )
+    {
+        foreach ( const File& f, dir.files )
+        {
+            if ( f.id )
+                ids << f.id;
+        }
+    }
+
+    return ids;
+}
@@ -0,0 +1,82 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FILEMTIMES_H
+#define FILEMTIMES_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+#include "dllmacro.h"
+
+// id and mtime of local files, as last seen by the scanner.
+// Grouped by dir, with each dir's path stored once and its file names packed into a single
+// UTF-8 buffer, so it stays small even for huge collections. Implicitly shared.
+class DLLEXPORT FileMtimes
+{
+public:
+    FileMtimes();
+
+    // path may be a file:// url
+    void insert( const QString& path, unsigned int id, unsigned int mtime );
+    // done inserting, release what we allocated in advance
+    void squeeze();
+
+    // looks up a file and forgets about it, so it won't be part of remainingIds()
+    bool take( const QString& path, unsigned int* id, unsigned int* mtime );
+    // ids of all files that haven't been taken
+    QList< unsigned int > remainingIds() const;
+
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+
+private:
+    struct File
+    {
+        unsigned int nameOffset;
+        unsigned int nameLength;
+        unsigned int id; // 0 once taken
+        unsigned int mtime;
+    };
+
+    struct Dir
+    {
+        Dir() : sorted( true ) {}
+
+        QByteArray names;
+        QVector< File > files;
+        bool sorted;
+    };
+
+    struct NameLess;
+
+    static void split( const QString& path, QString* dir, QByteArray* name );
+    static void sort( Dir& dir );
+
+    QHash< QString, Dir > m_dirs;
+    int m_count;
+};
+
+Q_DECLARE_METATYPE( FileMtimes )
+
+#endif // FILEMTIMES_H
@@ -18,195 +18,462 @@
 
 #include "fuzzyindex.h"
 
-#include <QDir>
-#include <QTime>
+#include <QtAlgorithms>
 
-#include <CLucene.h>
+#include <algorithm>
 
 #include "databaseimpl.h"
-#include "utils/tomahawkutils.h"
 #include "utils/logger.h"
+#include "utils/tomahawkutils.h"
 
-using namespace lucene::analysis;
-using namespace lucene::document;
-using namespace lucene::store;
-using namespace lucene::index;
-using namespace lucene::queryParser;
-using namespace lucene::search;
+// Same threshold lucene's FuzzyQuery used: names have to be at least 50% similar
+#define MIN_SIMILARITY 0.5
+#define MIN_SCORE 0.05
+// edit distances computed per search at most, the ones sharing most trigrams win
+#define MAX_CANDIDATES 1000
+// compact a table once this share of its entries has been removed
+#define MAX_REMOVED_RATIO 0.25
+// merge the delta into the base once it holds this many changes, or
+// this share of the base, whichever is more
+#define MIN_MERGE_CHANGES 1000
+#define MERGE_RATIO 0.125
+
+
+static quint64
+packTrigram( ushort a, ushort b, ushort c )
+{
+    return ( quint64( a ) << 32 ) | ( quint64( b ) << 16 ) | quint64( c );
+}
 
 
-FuzzyIndex::FuzzyIndex( DatabaseImpl& db, bool wipeIndex )
-    : QObject()
-    , m_db( db )
-    , m_luceneReader( 0 )
-    , m_luceneSearcher( 0 )
+// Collects the distinct, sorted trigrams of str. The string is padded with two
+// leading and one trailing sentinel, so even single characters get trigrams.
+static void
+trigrams( const QString& str, QVector< quint64 >& result )
 {
-    QString m_lucenePath = TomahawkUtils::appDataDir().absoluteFilePath( "tomahawk.lucene" );
-    m_luceneDir = FSDirectory::getDirectory( m_lucenePath.toStdString().c_str() );
-    m_analyzer = _CLNEW SimpleAnalyzer();
+    result.clear();
 
-    if ( wipeIndex )
+    const int len = str.length();
+    const ushort* data = str.utf16();
+    ushort a = 0, b = 0;
+    for ( int i = 0; i <= len; i++ )
     {
-        beginIndexing();
-        endIndexing();
+        const ushort c = ( i < len ) ? data[i] : 0;
+        result << packTrigram( a, b, c );
+        a = b;
+        b = c;
     }
+
+    qSort( result );
+    result.erase( std::unique( result.begin(), result.end() ), result.end() );
 }
 
 
-FuzzyIndex::~FuzzyIndex()
+// Lower bound of the distinct trigrams a name of the given length shares with
+// a query it is within distance edits of. Each edit destroys at most three of
+// the length + 1 padded trigrams, and repeated query trigrams only count once.
+static int
+sharedTrigrams( int queryLength, int repeated, int length, int distance )
 {
-    delete m_luceneSearcher;
-    delete m_luceneReader;
-    delete m_analyzer;
-    delete m_luceneDir;
+    return qMax( queryLength, length ) + 1 - 3 * distance - repeated;
 }
 
 
-void
-FuzzyIndex::beginIndexing()
+static bool
+postingSizeSorter( const QVector<int>* left, const QVector<int>* right )
 {
-    m_mutex.lock();
+    return left->count() < right->count();
+}
 
-    try
+
+void
+FuzzyIndexTable::insert( unsigned int id, const QString& sortname )
+{
+    QHash< unsigned int, int >::const_iterator existing = m_entries.constFind( id );
+    if ( existing != m_entries.constEnd() )
     {
-        qDebug() << Q_FUNC_INFO << "Starting indexing.";
-        if ( m_luceneReader != 0 )
-        {
-            qDebug() << "Deleting old lucene stuff.";
-            m_luceneSearcher->close();
-            m_luceneReader->close();
-            delete m_luceneSearcher;
-            delete m_luceneReader;
-            m_luceneSearcher = 0;
-            m_luceneReader = 0;
-        }
+        if ( m_names.at( existing.value() ) == sortname )
+            return;
 
-        qDebug() << "Creating new index writer.";
-        IndexWriter luceneWriter = IndexWriter( m_luceneDir, m_analyzer, true );
+        remove( id );
     }
-    catch( CLuceneError& error )
+
+    const int entry = m_ids.count();
+    m_ids << id;
+    m_names << sortname;
+    m_entries.insert( id, entry );
+
+    QVector< quint64 > grams;
+    trigrams( sortname, grams );
+    foreach ( quint64 gram, grams )
+        m_postings[ gram ] << entry;
+}
+
+
+void
+FuzzyIndexTable::insert( const FuzzyIndexTable& other )
+{
+    for ( int i = 0; i < other.m_ids.count(); i++ )
     {
-        qDebug() << "Caught CLucene error:" << error.what();
-        Q_ASSERT( false );
+        if ( !other.m_names.at( i ).isNull() )
+            insert( other.m_ids.at( i ), other.m_names.at( i ) );
     }
 }
 
 
-void
-FuzzyIndex::endIndexing()
+QString
+FuzzyIndexTable::name( unsigned int id ) const
 {
-    m_mutex.unlock();
-    emit indexReady();
+    const int entry = m_entries.value( id, -1 );
+    if ( entry < 0 )
+        return QString();
+
+    return m_names.at( entry );
 }
 
 
 void
-FuzzyIndex::appendFields( const QString& table, const QMap< unsigned int, QString >& fields )
+FuzzyIndexTable::remove( unsigned int id )
 {
-    try
+    const int entry = m_entries.value( id, -1 );
+    if ( entry < 0 )
+        return;
+
+    // posting lists keep pointing at the dead entry, search() skips it
+    m_names[ entry ] = QString();
+    m_entries.remove( id );
+    m_removed++;
+}
+
+
+FuzzyIndexTable
+FuzzyIndexTable::compacted() const
+{
+    FuzzyIndexTable index;
+    for ( int i = 0; i < m_ids.count(); i++ )
     {
-        qDebug() << "Appending to index:" << fields.count();
-        bool create = !IndexReader::indexExists( TomahawkUtils::appDataDir().absoluteFilePath( "tomahawk.lucene" ).toStdString().c_str() );
-        IndexWriter luceneWriter = IndexWriter( m_luceneDir, m_analyzer, create );
-        Document doc;
+        if ( !m_names.at( i ).isNull() )
+            index.insert( m_ids.at( i ), m_names.at( i ) );
+    }
 
-        QMapIterator< unsigned int, QString > it( fields );
-        while ( it.hasNext() )
-        {
-            it.next();
-            unsigned int id = it.key();
-            QString name = it.value();
+    return index;
+}
 
-            {
-                Field* field = _CLNEW Field( table.toStdWString().c_str(), DatabaseImpl::sortname( name ).toStdWString().c_str(),
-                                            Field::STORE_YES | Field::INDEX_UNTOKENIZED );
-                doc.add( *field );
-            }
 
-            {
-                Field* field = _CLNEW Field( _T( "id" ), QString::number( id ).toStdWString().c_str(),
-                Field::STORE_YES | Field::INDEX_NO );
-                doc.add( *field );
-            }
+QMap< int, float >
+FuzzyIndexTable::search( const QString& sortname ) const
+{
+    QMap< int, float > resultsmap;
 
-            luceneWriter.addDocument( &doc );
-            doc.clear();
+    const int queryLength = sortname.length();
+    const int maxDistance = int( queryLength * ( 1.0 - MIN_SIMILARITY ) );
+
+    QVector< quint64 > grams;
+    trigrams( sortname, grams );
+
+    // the loosest bound over all names that can be within reach at all
+    const int repeated = queryLength + 1 - grams.count();
+    const int minShared = qMax( 1, sharedTrigrams( queryLength, repeated, queryLength, maxDistance ) );
+
+    QVector< const QVector<int>* > lists;
+    foreach ( quint64 gram, grams )
+    {
+        QHash< quint64, QVector<int> >::const_iterator it = m_postings.constFind( gram );
+        if ( it != m_postings.constEnd() )
+            lists << &it.value();
+    }
+    if ( lists.count() < minShared )
+        return resultsmap;
+
+    // Pigeonhole: a candidate has to show up in at least one of the
+    // (lists - minShared + 1) shortest lists. Count those first, then
+    // look the candidates up in the remaining, longer lists.
+    qSort( lists.begin(), lists.end(), postingSizeSorter );
+    const int seedLists = lists.count() - minShared + 1;
+
+    QHash< int, int > seeds;
+    for ( int i = 0; i < seedLists; i++ )
+    {
+        foreach ( int entry, *lists.at( i ) )
+            seeds[ entry ]++;
+    }
+
+    QVector< QPair< int, int > > candidates; // shared trigrams, entry
+    QHash< int, int >::const_iterator it = seeds.constBegin();
+    for ( ; it != seeds.constEnd(); ++it )
+    {
+        const int entry = it.key();
+        const QString& name = m_names.at( entry );
+        if ( name.isNull() )
+            continue;
+
+        // the distance is at least the difference in length
+        const int length = name.length();
+        const int allowed = int( qMin( queryLength, length ) * ( 1.0 - MIN_SIMILARITY ) );
+        if ( qAbs( length - queryLength ) > allowed )
+            continue;
+
+        const int required = qMax( 1, sharedTrigrams( queryLength, repeated, length, allowed ) );
+        int shared = it.value();
+        for ( int i = seedLists; i < lists.count() && shared < required; i++ )
+        {
+            if ( qBinaryFind( lists.at( i )->constBegin(), lists.at( i )->constEnd(), entry ) != lists.at( i )->constEnd() )
+                shared++;
         }
+        if ( shared < required )
+            continue;
 
-        luceneWriter.close();
+        candidates << qMakePair( shared, entry );
     }
-    catch( CLuceneError& error )
+
+    // only verify the most promising ones, short queries match half the collection
+    if ( candidates.count() > MAX_CANDIDATES )
     {
-        qDebug() << "Caught CLucene error:" << error.what();
-        Q_ASSERT( false );
+        std::partial_sort( candidates.begin(), candidates.begin() + MAX_CANDIDATES, candidates.end(),
+                           qGreater< QPair< int, int > >() );
+        candidates.resize( MAX_CANDIDATES );
+    }
+
+    for ( int i = 0; i < candidates.count(); i++ )
+    {
+        const int entry = candidates.at( i ).second;
+        const QString& name = m_names.at( entry );
+
+        float score;
+        if ( name == sortname )
+        {
+            score = 1.0;
+        }
+        else
+        {
+            const int shorter = qMin( queryLength, name.length() );
+            if ( shorter == 0 )
+                continue;
+
+            const int allowed = int( shorter * ( 1.0 - MIN_SIMILARITY ) );
+            const int distance = TomahawkUtils::editDistance( sortname, name, allowed );
+            if ( distance > allowed )
+                continue;
+
+            score = qMin( float( 1.0 - float( distance ) / shorter ), (float)0.99 );
+        }
+
+        if ( score > MIN_SCORE )
+            resultsmap.insert( m_ids.at( entry ), score );
     }
+
+    return resultsmap;
 }
 
 
-void
-FuzzyIndex::loadLuceneIndex()
+FuzzyIndex::FuzzyIndex( DatabaseImpl& db )
+    : QObject()
+    , m_db( db )
 {
-    emit indexReady();
 }
 
 
-QMap< int, float >
-FuzzyIndex::search( const QString& table, const QString& name )
+FuzzyIndex::~FuzzyIndex()
 {
-    QMutexLocker lock( &m_mutex );
+}
 
-    QMap< int, float > resultsmap;
-    try
+
+bool
+FuzzyIndex::rebuild( DatabaseImpl* db )
+{
+    qDebug() << Q_FUNC_INFO << "Starting indexing.";
+
+    bool ok = true;
     {
-        if ( !m_luceneReader )
+        // no update may slip in between reading the tables and swapping them in
+        QMutexLocker writeLock( &m_writeMutex );
+
+        QHash< QString, FuzzyIndexTable > tables;
+        foreach ( const QString& table, QStringList() << "artist" << "album" << "track" )
         {
-            if ( !IndexReader::indexExists( TomahawkUtils::appDataDir().absoluteFilePath( "tomahawk.lucene" ).toStdString().c_str() ) )
+            if ( !loadTable( db, table, tables[ table ] ) )
             {
-                qDebug() << Q_FUNC_INFO << "index didn't exist.";
-                return resultsmap;
+                ok = false;
+                break;
             }
+        }
+
+        if ( ok )
+        {
+            QMutexLocker lock( &m_mutex );
+            m_tables.clear();
 
-            m_luceneReader = IndexReader::open( m_luceneDir );
-            m_luceneSearcher = _CLNEW IndexSearcher( m_luceneReader );
+            QHash< QString, FuzzyIndexTable >::const_iterator it = tables.constBegin();
+            for ( ; it != tables.constEnd(); ++it )
+            {
+                FuzzyIndexSegments* segments = new FuzzyIndexSegments;
+                segments->base = QSharedPointer<const FuzzyIndexTable>( new FuzzyIndexTable( it.value() ) );
+                m_tables.insert( it.key(), QSharedPointer<const FuzzyIndexSegments>( segments ) );
+            }
         }
+        else
+            tLog() << "Rebuilding the search index failed, keeping the previous one";
+    }
 
-        if ( name.isEmpty() )
-            return resultsmap;
+    // searches work either way, just maybe on an outdated index
+    emit indexReady();
+    return ok;
+}
 
-        SimpleAnalyzer analyzer;
-        QueryParser parser( table.toStdWString().c_str(), m_analyzer );
-        Hits* hits = 0;
 
-        FuzzyQuery* qry = _CLNEW FuzzyQuery( _CLNEW Term( table.toStdWString().c_str(), DatabaseImpl::sortname( name ).toStdWString().c_str() ) );
-        hits = m_luceneSearcher->search( qry );
+bool
+FuzzyIndex::loadTable( DatabaseImpl* db, const QString& table, FuzzyIndexTable& index )
+{
+    qDebug() << "Building index for" << table;
 
-        for ( uint i = 0; i < hits->length(); i++ )
-        {
-            Document* d = &hits->doc( i );
+    // not a TomahawkSqlQuery, a failure is handled here
+    QSqlQuery query( db->database() );
+    // only names we have files for are of any use when resolving
+    if ( !query.exec( QString( "SELECT id, name FROM %1 WHERE id IN ( SELECT DISTINCT %1 FROM file_join )" ).arg( table ) ) )
+    {
+        tLog() << "Could not read" << table << "for the search index:" << query.lastError().text();
+        return false;
+    }
 
-            float score = hits->score( i );
-            int id = QString::fromWCharArray( d->get( _T( "id" ) ) ).toInt();
-            QString result = QString::fromWCharArray( d->get( table.toStdWString().c_str() ) );
+    while ( query.next() )
+        index.insert( query.value( 0 ).toUInt(), DatabaseImpl::sortname( query.value( 1 ).toString() ) );
 
-            if ( DatabaseImpl::sortname( result ) == DatabaseImpl::sortname( name ) )
-                score = 1.0;
-            else
-                score = qMin( score, (float)0.99 );
+    qDebug() << "Building index for" << table << "finished:" << index.count();
+    return true;
+}
 
-            if ( score > 0.05 )
-            {
-                resultsmap.insert( id, score );
-//                qDebug() << "Hitres:" << result << id << score << table << name;
-            }
+
+void
+FuzzyIndex::updateFields( const QString& table, const QMap< unsigned int, QString >& fields )
+{
+    if ( fields.isEmpty() )
+        return;
+
+    QMutexLocker lock( &m_writeMutex );
+
+    QSharedPointer<const FuzzyIndexSegments> current = snapshot( table );
+    FuzzyIndexSegments* segments = current.isNull() ? new FuzzyIndexSegments : new FuzzyIndexSegments( *current );
+
+    QMapIterator< unsigned int, QString > it( fields );
+    while ( it.hasNext() )
+    {
+        it.next();
+        const QString sortname = DatabaseImpl::sortname( it.value() );
+
+        if ( !segments->base.isNull() && segments->base->contains( it.key() ) )
+        {
+            if ( !segments->masked.contains( it.key() ) && segments->base->name( it.key() ) == sortname )
+                continue;
+
+            segments->masked.insert( it.key() );
         }
 
-        delete hits;
-        delete qry;
+        segments->delta.insert( it.key(), sortname );
+    }
+
+    publish( table, segments );
+}
+
+
+void
+FuzzyIndex::deleteFields( const QString& table, const QList< unsigned int >& ids )
+{
+    if ( ids.isEmpty() )
+        return;
+
+    QMutexLocker lock( &m_writeMutex );
+
+    QSharedPointer<const FuzzyIndexSegments> current = snapshot( table );
+    if ( current.isNull() )
+        return;
+
+    FuzzyIndexSegments* segments = new FuzzyIndexSegments( *current );
+    foreach ( unsigned int id, ids )
+    {
+        segments->delta.remove( id );
+        if ( !segments->base.isNull() && segments->base->contains( id ) )
+            segments->masked.insert( id );
+    }
+
+    if ( segments->delta.removedCount() > segments->delta.count() * MAX_REMOVED_RATIO )
+        segments->delta = segments->delta.compacted();
+
+    publish( table, segments );
+}
+
+
+void
+FuzzyIndex::publish( const QString& table, FuzzyIndexSegments* segments )
+{
+    // Folding the delta into the base copies the whole table, so only do it
+    // once the delta grew in proportion to the base. That keeps the cost of
+    // updates linear in the number of changes.
+    const int baseCount = segments->base.isNull() ? 0 : segments->base->count();
+    if ( segments->changes() > qMax( MIN_MERGE_CHANGES, int( baseCount * MERGE_RATIO ) ) )
+    {
+        FuzzyIndexTable merged = segments->base.isNull() ? FuzzyIndexTable() : *segments->base;
+        foreach ( unsigned int id, segments->masked )
+            merged.remove( id );
+        merged.insert( segments->delta );
+
+        if ( merged.removedCount() > merged.count() * MAX_REMOVED_RATIO )
+            merged = merged.compacted();
+
+        segments->base = QSharedPointer<const FuzzyIndexTable>( new FuzzyIndexTable( merged ) );
+        segments->delta = FuzzyIndexTable();
+        segments->masked.clear();
+    }
+
+    QSharedPointer<const FuzzyIndexSegments> snapshot( segments );
+
+    QMutexLocker lock( &m_mutex );
+    m_tables.insert( table, snapshot );
+}
+
+
+QSharedPointer<const FuzzyIndexSegments>
+FuzzyIndex::snapshot( const QString& table )
+{
+    QMutexLocker lock( &m_mutex );
+    return m_tables.value( table );
+}
+
+
+QMap< int, float >
+FuzzyIndex::search( const QString& table, const QString& name )
+{
+    QMap< int, float > resultsmap;
+    if ( name.isEmpty() )
+        return resultsmap;
+
+    QSharedPointer<const FuzzyIndexSegments> segments = snapshot( table );
+    if ( segments.isNull() )
+    {
+        qDebug() << Q_FUNC_INFO << "index didn't exist.";
+        return resultsmap;
     }
-    catch( CLuceneError& error )
+
+    const QString sortname = DatabaseImpl::sortname( name );
+    if ( !segments->base.isNull() )
+    {
+        resultsmap = segments->base->search( sortname );
+
+        QMap< int, float >::iterator it = resultsmap.begin();
+        while ( it != resultsmap.end() )
+        {
+            if ( segments->masked.contains( it.key() ) )
+                it = resultsmap.erase( it );
+            else
+                ++it;
+        }
+    }
+
+    // the delta has the current names of whatever it masks in the base
+    QMapIterator< int, float > it( segments->delta.search( sortname ) );
+    while ( it.hasNext() )
     {
-        qDebug() << "Caught CLucene error:" << error.what();
-        Q_ASSERT( false );
+        it.next();
+        resultsmap.insert( it.key(), it.value() );
     }
 
     return resultsmap;
@@ -22,61 +22,104 @@
 #include <QObject>
 #include <QMap>
 #include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QString>
 #include <QMutex>
+#include <QSharedPointer>
 
-namespace lucene
+class DatabaseImpl;
+
+/*
+    In-memory trigram index over the sortnames of one table (artist, album or track).
+
+    Every name is split into padded trigrams, each trigram keeps a sorted posting
+    list of entries containing it. A search collects the candidates sharing enough
+    trigrams with the query to possibly be within the allowed edit distance and
+    verifies them with a bounded Levenshtein distance.
+
+    Instances are plain values with implicitly shared members: copying one is cheap,
+    and a copy can be modified without affecting searches running on the original.
+    Removed entries are only marked dead, compacted() drops them for good.
+*/
+class FuzzyIndexTable
 {
-    namespace analysis
-    {
-      class SimpleAnalyzer;
-    }
-    namespace store
-    {
-      class Directory;
-    }
-    namespace index
-    {
-      class IndexReader;
-      class IndexWriter;
-    }
-    namespace search
-    {
-      class IndexSearcher;
-    }
-}
+public:
+    FuzzyIndexTable() : m_removed( 0 ) {}
+
+    int count() const { return m_entries.count(); }
+    int removedCount() const { return m_removed; }
+
+    bool contains( unsigned int id ) const { return m_entries.contains( id ); }
+    QString name( unsigned int id ) const;
+
+    void insert( unsigned int id, const QString& sortname );
+    void insert( const FuzzyIndexTable& other );
+    void remove( unsigned int id );
+    FuzzyIndexTable compacted() const;
+
+    QMap< int, float > search( const QString& sortname ) const;
+
+private:
+    QVector< unsigned int > m_ids;
+    QVector< QString > m_names;
+    QHash< unsigned int, int > m_entries;
+    QHash< quint64, QVector<int> > m_postings;
+    int m_removed;
+};
+
+
+/*
+    What searches of one table run on: a large base table that is only rebuilt
+    once in a while, and a small delta with the entries changed since. Updates
+    copy just the delta and the ids of the base entries it supersedes.
+*/
+struct FuzzyIndexSegments
+{
+    QSharedPointer<const FuzzyIndexTable> base;
+    FuzzyIndexTable delta;
+    QSet< unsigned int > masked; // ids whose base entry is outdated or deleted
+
+    int changes() const { return delta.count() + masked.count(); }
+};
 
-class DatabaseImpl;
 
 class FuzzyIndex : public QObject
 {
 Q_OBJECT
 
 public:
-    explicit FuzzyIndex( DatabaseImpl& db, bool wipeIndex = false );
+    explicit FuzzyIndex( DatabaseImpl& db );
     ~FuzzyIndex();
 
-    void beginIndexing();
-    void endIndexing();
-    void appendFields( const QString& table, const QMap< unsigned int, QString >& fields );
-    
+    // reads the artist, album and track names from the database and swaps the
+    // rebuilt index in. If reading fails the previous index stays in place
+    bool rebuild( DatabaseImpl* db );
+
+    // incremental updates of the published index, searches keep running on the
+    // previous snapshot until the updated one is swapped in. Only call these
+    // once the names are committed to the database.
+    void updateFields( const QString& table, const QMap< unsigned int, QString >& fields );
+    void deleteFields( const QString& table, const QList< unsigned int >& ids );
+
 signals:
     void indexReady();
 
 public slots:
-    void loadLuceneIndex();
-
     QMap< int, float > search( const QString& table, const QString& name );
 
 private:
+    bool loadTable( DatabaseImpl* db, const QString& table, FuzzyIndexTable& index );
+    QSharedPointer<const FuzzyIndexSegments> snapshot( const QString& table );
+    void publish( const QString& table, FuzzyIndexSegments* segments );
+
     DatabaseImpl& m_db;
-    QMutex m_mutex;
-    QString m_lucenePath;
 
-    lucene::analysis::SimpleAnalyzer* m_analyzer;
-    lucene::store::Directory* m_luceneDir;
-    lucene::index::IndexReader* m_luceneReader;
-    lucene::search::IndexSearcher* m_luceneSearcher;
+    // only guards swapping the published snapshots, searches run without locking
+    QMutex m_mutex;
+    // serializes writers, so no update gets lost between copying and publishing a table
+    QMutex m_writeMutex;
+    QHash< QString, QSharedPointer<const FuzzyIndexSegments> > m_tables;
 };
 
 #endif // FUZZYINDEX_H
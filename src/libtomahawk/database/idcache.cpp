@@ -0,0 +1,150 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "idcache.h"
+
+#include <QHash>
+
+#define INITIAL_SIZE 1024
+
+static IdCache s_artistIds;
+static IdCache s_albumIds;
+
+
+IdCache*
+IdCache::artists()
+{
+    return &s_artistIds;
+}
+
+
+IdCache*
+IdCache::albums()
+{
+    return &s_albumIds;
+}
+
+
+QString
+IdCache::albumKey( int artistId, const QString& sortname )
+{
+    return QString( "%1\t%2" ).arg( artistId ).arg( sortname );
+}
+
+
+IdCache::IdCache()
+    : m_loaded( 0 )
+{
+    Table* table = new Table( INITIAL_SIZE );
+    m_tables << table;
+    m_table = table;
+}
+
+
+IdCache::~IdCache()
+{
+    qDeleteAll( m_entries );
+    qDeleteAll( m_tables );
+}
+
+
+// Returns the slot holding \a key, or the empty one it would go into.
+int
+IdCache::slotFor( const Table* table, const QString& key )
+{
+    const int mask = table->size - 1;
+    int i = qHash( key ) & mask;
+
+    // the table is never more than half full, so this always ends
+    forever
+    {
+        const Entry* entry = table->slots[i];
+        if ( !entry || entry->key == key )
+            return i;
+
+        i = ( i + 1 ) & mask;
+    }
+}
+
+
+int
+IdCache::value( const QString& key ) const
+{
+    const Table* table = m_table;
+    const Entry* entry = table->slots[ slotFor( table, key ) ];
+
+    return entry ? entry->id : 0;
+}
+
+
+void
+IdCache::insert( const QString& key, int id )
+{
+    if ( id < 1 )
+        return;
+
+    QMutexLocker lock( &m_writeMutex );
+
+    Table* table = m_table;
+    int i = slotFor( table, key );
+    const Entry* existing = table->slots[i];
+    if ( existing && existing->id == id )
+        return;
+
+    if ( !existing && ( table->used + 1 ) * 2 > table->size )
+    {
+        table = grow( table );
+        i = slotFor( table, key );
+    }
+
+    Entry* entry = new Entry( key, id );
+    m_entries << entry;
+
+    // a replaced entry stays alive, someone might still be looking at it
+    table->slots[i].fetchAndStoreOrdered( entry );
+    if ( !existing )
+        table->used++;
+}
+
+
+int
+IdCache::count() const
+{
+    const Table* table = m_table;
+    return table->used;
+}
+
+
+IdCache::Table*
+IdCache::grow( Table* table )
+{
+    Table* bigger = new Table( table->size * 2 );
+    for ( int i = 0; i < table->size; i++ )
+    {
+        Entry* entry = table->slots[i];
+        if ( entry )
+            bigger->slots[ slotFor( bigger, entry->key ) ] = entry;
+    }
+    bigger->used = table->used;
+
+    // readers still on the old table keep using it, it's only freed with the cache
+    m_tables << bigger;
+    m_table.fetchAndStoreOrdered( bigger );
+
+    return bigger;
+}
@@ -0,0 +1,94 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDCACHE_H
+#define IDCACHE_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include "dllmacro.h"
+
+/**
+ * Maps artist and album sortnames to their database ids, so they can be
+ * looked up from any thread without going near the database.
+ *
+ * Reading takes no lock at all: the table is open addressed, slots only ever
+ * get filled in, and when it has to grow a bigger copy is published while the
+ * old one stays around for whoever is still reading it. Writers serialize on
+ * a mutex. Nothing is freed before the cache itself goes away: the old tables
+ * add up to less than the current one, but every entry replaced because a
+ * name's row got deleted and recreated with a new id stays around too.
+ */
+class DLLEXPORT IdCache
+{
+public:
+    static IdCache* artists();
+    static IdCache* albums();
+
+    static QString albumKey( int artistId, const QString& sortname );
+
+    IdCache();
+    ~IdCache();
+
+    /// The id stored for \a key, or 0 if there is none.
+    int value( const QString& key ) const;
+    void insert( const QString& key, int id );
+
+    int count() const;
+
+    /// Whether everything in the database has been read in, so a miss means there is no such row.
+    bool isLoaded() const { return m_loaded == 1; }
+    void setLoaded() { m_loaded = 1; }
+
+private:
+    struct Entry
+    {
+        Entry( const QString& k, int i ) : key( k ), id( i ) {}
+
+        const QString key;
+        const int id;
+    };
+
+    struct Table
+    {
+        explicit Table( int s ) : size( s ), used( 0 ), slots( new QAtomicPointer< Entry >[s] ) {}
+        ~Table() { delete[] slots; }
+
+        const int size;
+        int used;
+        QAtomicPointer< Entry >* slots;
+    };
+
+    static int slotFor( const Table* table, const QString& key );
+    Table* grow( Table* table );
+
+    Q_DISABLE_COPY( IdCache )
+
+    QAtomicPointer< Table > m_table;
+    QAtomicInt m_loaded;
+
+    QMutex m_writeMutex;
+    QList< Table* > m_tables;
+    QList< Entry* > m_entries;
+};
+
+#endif // IDCACHE_H
@@ -0,0 +1,277 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "playlistrevisionstore.h"
+
+#include <QHash>
+#include <QVector>
+
+#include "databaseimpl.h"
+#include "tomahawksqlquery.h"
+#include "qjson/parser.h"
+#include "qjson/serializer.h"
+#include "utils/logger.h"
+
+// revisions in a row stored as deltas, before we store a snapshot again
+#define SNAPSHOT_INTERVAL 32
+// give up on chains this long, they can only be the result of a broken db
+#define MAX_CHAIN_LENGTH 4096
+
+
+bool
+PlaylistRevisionStore::load( DatabaseImpl* dbi, const QString& revguid, QStringList& entries, QStringList* previousEntries )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( "SELECT entries, delta, previous_revision "
+                   "FROM playlist_revision "
+                   "WHERE guid = ?" );
+
+    // walk back to the closest snapshot, then replay the deltas from there
+    QList< QByteArray > deltas;
+    QString rev = revguid;
+    QString previousrev;
+    QJson::Parser parser;
+    bool ok = false;
+
+    while ( !rev.isEmpty() && deltas.count() < MAX_CHAIN_LENGTH )
+    {
+        query.bindValue( 0, rev );
+        query.exec();
+        if ( !query.next() )
+            break;
+
+        if ( rev == revguid )
+            previousrev = query.value( 2 ).toString();
+
+        if ( !query.value( 0 ).isNull() )
+        {
+            const QVariant v = parser.parse( query.value( 0 ).toByteArray(), &ok );
+            ok = ok && v.type() == QVariant::List;
+            entries = v.toStringList();
+            break;
+        }
+
+        deltas << query.value( 1 ).toByteArray();
+        rev = query.value( 2 ).toString();
+    }
+
+    if ( !ok )
+    {
+        tLog() << Q_FUNC_INFO << "Could not load entries of playlist revision" << revguid;
+        return false;
+    }
+
+    for ( int i = deltas.count() - 1; i >= 0; i-- )
+    {
+        if ( i == 0 && previousEntries )
+            *previousEntries = entries;
+
+        const QVariant delta = parser.parse( deltas.at( i ), &ok );
+        if ( !ok || !apply( entries, delta.toMap() ) )
+        {
+            tLog() << Q_FUNC_INFO << "Broken delta in the revisions of" << revguid;
+            return false;
+        }
+    }
+
+    // a snapshot doesn't tell us about the previous revision, load that separately
+    if ( previousEntries && deltas.isEmpty() && !previousrev.isEmpty() )
+        return load( dbi, previousrev, *previousEntries );
+
+    return true;
+}
+
+
+void
+PlaylistRevisionStore::insert( DatabaseImpl* dbi, const QString& revguid, const QString& playlistguid, const QVariant& author,
+                               const QString& previousrev, const QStringList& entries, const QStringList* previousEntries )
+{
+    QJson::Serializer ser;
+    QVariantMap delta;
+    int depth = 0;
+
+    if ( previousEntries )
+    {
+        TomahawkSqlQuery query = dbi->newquery();
+        query.prepare( "SELECT depth FROM playlist_revision WHERE guid = ?" );
+        query.addBindValue( previousrev );
+        query.exec();
+        if ( query.next() )
+            depth = query.value( 0 ).toInt() + 1;
+
+        delta = PlaylistRevisionStore::delta( *previousEntries, entries );
+        const int changes = delta.value( "removed" ).toList().count() + delta.value( "inserted" ).toList().count();
+
+        if ( depth == 0 || depth >= SNAPSHOT_INTERVAL || changes > entries.count() / 2 )
+        {
+            delta.clear();
+            depth = 0;
+        }
+    }
+
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( "INSERT INTO playlist_revision(guid, playlist, entries, delta, depth, author, timestamp, previous_revision) "
+                   "VALUES(?, ?, ?, ?, ?, ?, ?, ?)" );
+
+    query.addBindValue( revguid );
+    query.addBindValue( playlistguid );
+    if ( depth == 0 )
+    {
+        QVariantList vlist;
+        foreach ( const QString& guid, entries )
+            vlist << guid;
+
+        query.addBindValue( ser.serialize( vlist ) );
+        query.addBindValue( QVariant( QVariant::String ) );
+    }
+    else
+    {
+        query.addBindValue( QVariant( QVariant::String ) );
+        query.addBindValue( ser.serialize( delta ) );
+    }
+    query.addBindValue( depth );
+    query.addBindValue( author );
+    query.addBindValue( 0 ); //ts
+    query.addBindValue( previousrev.isEmpty() ? QVariant( QVariant::String ) : previousrev );
+    query.exec();
+}
+
+
+QVariantMap
+PlaylistRevisionStore::delta( const QStringList& from, const QStringList& to )
+{
+    QHash< QString, int > oldPos;
+    oldPos.reserve( from.count() );
+    for ( int i = 0; i < from.count(); i++ )
+        oldPos.insert( from.at( i ), i );
+
+    // old positions of the entries still there, in their new order
+    QVector< int > seq;
+    seq.reserve( to.count() );
+    foreach ( const QString& guid, to )
+    {
+        QHash< QString, int >::const_iterator it = oldPos.constFind( guid );
+        if ( it != oldPos.constEnd() )
+            seq << it.value();
+    }
+
+    // the longest increasing run of old positions stays where it is, everything else moves.
+    // tails[ k ] is the index into seq of the smallest tail of a run of length k + 1
+    QVector< int > tails;
+    QVector< int > prev( seq.count(), -1 );
+    for ( int i = 0; i < seq.count(); i++ )
+    {
+        int lo = 0, hi = tails.count();
+        while ( lo < hi )
+        {
+            const int mid = ( lo + hi ) / 2;
+            if ( seq.at( tails.at( mid ) ) < seq.at( i ) )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if ( lo > 0 )
+            prev[ i ] = tails.at( lo - 1 );
+        if ( lo == tails.count() )
+            tails << i;
+        else
+            tails[ lo ] = i;
+    }
+
+    QVector< bool > kept( from.count(), false );
+    QVector< bool > keptSeq( seq.count(), false );
+    for ( int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = prev.at( i ) )
+    {
+        kept[ seq.at( i ) ] = true;
+        keptSeq[ i ] = true;
+    }
+
+    QVariantList removed;
+    for ( int i = 0; i < from.count(); i++ )
+    {
+        if ( !kept.at( i ) )
+            removed << i;
+    }
+
+    QVariantList inserted;
+    for ( int i = 0, k = 0; i < to.count(); i++ )
+    {
+        const bool known = oldPos.contains( to.at( i ) );
+        if ( !known || !keptSeq.at( k ) )
+            inserted << QVariant( QVariantList() << i << to.at( i ) );
+        if ( known )
+            k++;
+    }
+
+    QVariantMap m;
+    m.insert( "removed", removed );
+    m.insert( "inserted", inserted );
+    return m;
+}
+
+
+bool
+PlaylistRevisionStore::apply( QStringList& entries, const QVariantMap& delta )
+{
+    // removed positions are ascending, relative to the old list;
+    // inserted positions are ascending, relative to the new list
+    const QVariantList removed = delta.value( "removed" ).toList();
+    const QVariantList inserted = delta.value( "inserted" ).toList();
+
+    QStringList result;
+    result.reserve( entries.count() - removed.count() + inserted.count() );
+
+    // merge the surviving old entries and the inserted ones in one pass
+    int old = 0, next = 0;
+    for ( int i = 0; i <= inserted.count(); i++ )
+    {
+        int pos = entries.count() + inserted.count();
+        QVariantList insert;
+        if ( i < inserted.count() )
+        {
+            insert = inserted.at( i ).toList();
+            pos = insert.value( 0 ).toInt();
+            if ( insert.count() != 2 || pos < result.count() )
+                return false;
+        }
+
+        while ( result.count() < pos && old < entries.count() )
+        {
+            if ( next < removed.count() && removed.at( next ).toInt() == old )
+                next++;
+            else
+                result << entries.at( old );
+            old++;
+        }
+
+        if ( i < inserted.count() )
+        {
+            if ( result.count() != pos )
+                return false;
+            result << insert.at( 1 ).toString();
+        }
+    }
+
+    if ( next != removed.count() )
+        return false;
+
+    entries = result;
+    return true;
+}
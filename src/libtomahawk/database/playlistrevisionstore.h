@@ -0,0 +1,47 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PLAYLISTREVISIONSTORE_H
+#define PLAYLISTREVISIONSTORE_H
+
+#include <QStringList>
+#include <QVariant>
+
+class DatabaseImpl;
+
+// Stores the ordered entry guids of playlist revisions. Most revisions only store what changed
+// since their previous revision; a full snapshot is kept every so often, and whenever the delta
+// would be about as big as the playlist itself.
+class PlaylistRevisionStore
+{
+public:
+    // loads the entries of a revision, and optionally those of its previous revision.
+    // Returns false if the revision (or one it depends on) is missing
+    static bool load( DatabaseImpl* dbi, const QString& revguid, QStringList& entries, QStringList* previousEntries = 0 );
+
+    // previousEntries are the entries of previousrev, if known
+    static void insert( DatabaseImpl* dbi, const QString& revguid, const QString& playlistguid, const QVariant& author,
+                        const QString& previousrev, const QStringList& entries, const QStringList* previousEntries );
+
+    // what turns from into to: the old positions to remove, then the new positions to insert at
+    static QVariantMap delta( const QStringList& from, const QStringList& to );
+    static bool apply( QStringList& entries, const QVariantMap& delta );
+};
+
+#endif // PLAYLISTREVISIONSTORE_H
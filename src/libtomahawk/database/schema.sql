@@ -94,10 +94,12 @@ CREATE INDEX playlist_item_playlist ON playlist_item(playlist);
 CREATE TABLE IF NOT EXISTS playlist_revision (
     guid TEXT PRIMARY KEY,
     playlist TEXT NOT NULL REFERENCES playlist(guid) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,
-    entries TEXT, -- qlist( guid, guid... )
+    entries TEXT, -- qlist( guid, guid... ), NULL if stored as a delta
     author INTEGER REFERENCES source(id) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,
     timestamp INTEGER NOT NULL DEFAULT 0,
-    previous_revision TEXT REFERENCES playlist_revision(guid) DEFERRABLE INITIALLY DEFERRED
+    previous_revision TEXT REFERENCES playlist_revision(guid) DEFERRABLE INITIALLY DEFERRED,
+    delta TEXT, -- { removed: [ oldpos... ], inserted: [ [ newpos, guid ]... ] } against previous_revision
+    depth INTEGER NOT NULL DEFAULT 0 -- deltas since the last revision with entries
 );
 
 --INSERT INTO playlist_revision(guid, playlist, entries)
@@ -162,6 +164,11 @@ CREATE TABLE IF NOT EXISTS file (
 );
 CREATE UNIQUE INDEX file_url_src_uniq ON file(source, url);
 CREATE INDEX file_source ON file(source);
+-- collection views page through files sorted by these, see DatabaseCommand_TrackPage
+CREATE INDEX file_mtime ON file(mtime);
+CREATE INDEX file_size ON file(size);
+CREATE INDEX file_duration ON file(duration);
+CREATE INDEX file_bitrate ON file(bitrate);
 
 -- mtime of dir when last scanned.
 -- load into memory when rescanning, skip stuff that's unchanged
@@ -181,6 +188,9 @@ CREATE INDEX file_join_track  ON file_join(track);
 CREATE INDEX file_join_artist ON file_join(artist);
 CREATE INDEX file_join_album  ON file_join(album);
 
+-- file_fts, the full text index used to filter collection views, is set up
+-- in code (DatabaseImpl::setupFullTextIndex) as sqlite may lack fts4.
+
 
 
 -- tags, weighted and by source (rock, jazz etc)
@@ -285,6 +295,35 @@ CREATE TABLE IF NOT EXISTS http_client_auth (
 
 
 
+-- recently resolved results, so known tracks are playable right away on the next start
+-- artist, track and album hold the sortnames of the query the results were found for
+-- if source=null, the result doesn't belong to a collection (e.g. a script resolver's result)
+
+CREATE TABLE IF NOT EXISTS resolve_cache (
+    artist TEXT NOT NULL,
+    track TEXT NOT NULL,
+    album TEXT NOT NULL,
+    resolver TEXT NOT NULL,                 -- Resolver::name() of the resolver which found it
+    source INTEGER REFERENCES source(id) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,
+    url TEXT NOT NULL,
+    artistname TEXT NOT NULL,
+    albumname TEXT NOT NULL,
+    trackname TEXT NOT NULL,
+    mimetype TEXT,
+    duration INTEGER,
+    bitrate INTEGER,
+    size INTEGER,
+    friendlysource TEXT,
+    score REAL NOT NULL,
+    expires INTEGER NOT NULL                -- timestamp after which the result is revalidated
+);
+
+CREATE INDEX resolve_cache_query ON resolve_cache(artist, track, album);
+CREATE INDEX resolve_cache_source ON resolve_cache(source);
+CREATE INDEX resolve_cache_expires ON resolve_cache(expires);
+
+
+
 -- Schema version, and misc tomahawk settings relating to the collection db
 
 CREATE TABLE IF NOT EXISTS settings (
@@ -292,4 +331,4 @@ CREATE TABLE IF NOT EXISTS settings (
     v TEXT NOT NULL DEFAULT ''
 );
 
-INSERT INTO settings(k,v) VALUES('schema_version', '27');
+INSERT INTO settings(k,v) VALUES('schema_version', '32');
@@ -1,5 +1,5 @@
 /*
-    This file was automatically generated from schema.sql on Wed Nov 16 22:47:16 EST 2011.
+    This file was automatically generated from ./schema.sql on Fri Oct 16 22:52:11 UTC 2026.
 */
 
 static const char * tomahawk_schema_sql = 
@@ -73,7 +73,9 @@ static const char * tomahawk_schema_sql =
 "    entries TEXT, "
 "    author INTEGER REFERENCES source(id) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,"
 "    timestamp INTEGER NOT NULL DEFAULT 0,"
-"    previous_revision TEXT REFERENCES playlist_revision(guid) DEFERRABLE INITIALLY DEFERRED"
+"    previous_revision TEXT REFERENCES playlist_revision(guid) DEFERRABLE INITIALLY DEFERRED,"
+"    delta TEXT, "
+"    depth INTEGER NOT NULL DEFAULT 0 "
 ");"
 "CREATE TABLE IF NOT EXISTS dynamic_playlist ("
 "    guid TEXT NOT NULL REFERENCES playlist(guid) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,"
@@ -107,6 +109,10 @@ static const char * tomahawk_schema_sql =
 ");"
 "CREATE UNIQUE INDEX file_url_src_uniq ON file(source, url);"
 "CREATE INDEX file_source ON file(source);"
+"CREATE INDEX file_mtime ON file(mtime);"
+"CREATE INDEX file_size ON file(size);"
+"CREATE INDEX file_duration ON file(duration);"
+"CREATE INDEX file_bitrate ON file(bitrate);"
 "CREATE TABLE IF NOT EXISTS dirs_scanned ("
 "    name TEXT PRIMARY KEY,"
 "    mtime INTEGER NOT NULL"
@@ -185,11 +191,32 @@ static const char * tomahawk_schema_sql =
 "    mtime INTEGER,"
 "    permissions TEXT NOT NULL"
 ");"
+"CREATE TABLE IF NOT EXISTS resolve_cache ("
+"    artist TEXT NOT NULL,"
+"    track TEXT NOT NULL,"
+"    album TEXT NOT NULL,"
+"    resolver TEXT NOT NULL,                 "
+"    source INTEGER REFERENCES source(id) ON DELETE CASCADE ON UPDATE CASCADE DEFERRABLE INITIALLY DEFERRED,"
+"    url TEXT NOT NULL,"
+"    artistname TEXT NOT NULL,"
+"    albumname TEXT NOT NULL,"
+"    trackname TEXT NOT NULL,"
+"    mimetype TEXT,"
+"    duration INTEGER,"
+"    bitrate INTEGER,"
+"    size INTEGER,"
+"    friendlysource TEXT,"
+"    score REAL NOT NULL,"
+"    expires INTEGER NOT NULL                "
+");"
+"CREATE INDEX resolve_cache_query ON resolve_cache(artist, track, album);"
+"CREATE INDEX resolve_cache_source ON resolve_cache(source);"
+"CREATE INDEX resolve_cache_expires ON resolve_cache(expires);"
 "CREATE TABLE IF NOT EXISTS settings ("
 "    k TEXT NOT NULL PRIMARY KEY,"
 "    v TEXT NOT NULL DEFAULT ''"
 ");"
-"INSERT INTO settings(k,v) VALUES('schema_version', '27');"
+"INSERT INTO settings(k,v) VALUES('schema_version', '32');"
     ;
 
 const char * get_tomahawk_sql()
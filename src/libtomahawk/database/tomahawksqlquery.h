@@ -41,11 +41,14 @@ public:
         : QSqlQuery( db )
     {}
 
+    // one-shot queries don't need a separate prepare step
     bool exec( const QString& query )
     {
-        prepare( query );
+        QTime t;
+        t.start();
 
-        return exec();
+        bool ret = QSqlQuery::exec( query );
+        return finishExec( ret, t );
     }
 
     bool exec()
@@ -54,17 +57,22 @@ public:
         t.start();
 
         bool ret = QSqlQuery::exec();
+        return finishExec( ret, t );
+    }
+
+private:
+    bool finishExec( bool ret, const QTime& t )
+    {
         if( !ret )
             showError();
 
         int e = t.elapsed();
         if ( e >= TOMAHAWK_QUERY_THRESHOLD )
-            tLog( LOGVERBOSE ) << "TomahawkSqlQuery (" << lastQuery() << ") finished in" << t.elapsed() << "ms";
+            tLog( LOGVERBOSE ) << "TomahawkSqlQuery (" << lastQuery() << ") finished in" << e << "ms";
 
         return ret;
     }
 
-private:
     void showError()
     {
         tLog() << "\n" << "*** DATABASE ERROR ***" << "\n"
@@ -806,7 +806,7 @@ void
 GlobalActionManager::playNow( const query_ptr& q )
 {
 
-    Pipeline::instance()->resolve( q, true );
+    Pipeline::instance()->resolve( q, Pipeline::PriorityPlayback );
 
     m_waitingToPlay = q;
     q->setProperty( "playNow", true );
@@ -817,7 +817,7 @@ GlobalActionManager::playNow( const query_ptr& q )
 void
 GlobalActionManager::playOrQueueNow( const query_ptr& q )
 {
-    Pipeline::instance()->resolve( q, true );
+    Pipeline::instance()->resolve( q, Pipeline::PriorityPlayback );
 
     m_waitingToPlay = q;
     connect( q.data(), SIGNAL( resolvingFinished( bool ) ), this, SLOT( waitingForResolved( bool ) ) );
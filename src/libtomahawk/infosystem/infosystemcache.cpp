@@ -19,8 +19,11 @@
 #include <QtDebug>
 
 #include <QDir>
-#include <QSettings>
 #include <QCryptographicHash>
+#include <QDataStream>
+#include <QPair>
+#include <QSqlError>
+#include <QStringList>
 
 #ifndef ENABLE_HEADLESS
     #include <QDesktopServices>
@@ -28,8 +31,14 @@
 
 #include "infosystemcache.h"
 #include "tomahawksettings.h"
+#include "database/tomahawksqlquery.h"
 #include "utils/logger.h"
 
+// how stale an entry's last access may get before a hit updates it, in seconds
+#define ACCESS_GRANULARITY 3600
+// entries looked at per round of evicting
+#define EVICT_BATCH_SIZE 100
+
 
 namespace Tomahawk
 {
@@ -45,7 +54,8 @@ InfoSystemCache::InfoSystemCache( QObject* parent )
 #else
     , m_cacheBaseDir( QDir::tempPath() )
 #endif
-    , m_cacheVersion( 2 )
+    , m_size( 0 )
+    , m_cacheVersion( 3 )
 {
     tDebug() << Q_FUNC_INFO;
     TomahawkSettings *s = TomahawkSettings::instance();
@@ -64,6 +74,9 @@ InfoSystemCache::InfoSystemCache( QObject* parent )
         s->setInfoSystemCacheVersion( m_cacheVersion );
     }
 
+    if ( openDatabase() )
+        pruneTimerFired();
+
     m_pruneTimer.setInterval( 300000 );
     m_pruneTimer.setSingleShot( false );
     connect( &m_pruneTimer, SIGNAL( timeout() ), SLOT( pruneTimerFired() ) );
@@ -74,15 +87,64 @@ InfoSystemCache::InfoSystemCache( QObject* parent )
 InfoSystemCache::~InfoSystemCache()
 {
     tDebug() << Q_FUNC_INFO;
+
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase( "infosystemcache" );
 }
 
+
+bool
+InfoSystemCache::openDatabase()
+{
+    QDir dir( m_cacheBaseDir );
+    if ( !dir.exists() && !dir.mkpath( m_cacheBaseDir ) )
+    {
+        tLog() << "Failed to create cache dir! Not caching anything.";
+        return false;
+    }
+
+    m_db = QSqlDatabase::addDatabase( "QSQLITE", "infosystemcache" );
+    m_db.setDatabaseName( dir.filePath( "infosystemcache.db" ) );
+    if ( !m_db.open() )
+    {
+        tLog() << "Failed to open info system cache:" << m_db.lastError().text();
+        return false;
+    }
+
+    // it's a cache, losing the last few writes on a crash is fine
+    TomahawkSqlQuery query( m_db );
+    query.exec( "PRAGMA journal_mode = WAL" );
+    query.exec( "PRAGMA synchronous = OFF" );
+
+    query.exec( "CREATE TABLE IF NOT EXISTS cache ("
+                "    key TEXT PRIMARY KEY,"         // criteriaMd5() including the type
+                "    type INTEGER NOT NULL,"
+                "    expires INTEGER NOT NULL,"     // msecs since epoch
+                "    accessed INTEGER NOT NULL,"    // secs since epoch, for evicting
+                "    size INTEGER NOT NULL,"
+                "    data BLOB NOT NULL"            // QDataStream'd QVariant
+                ")" );
+    query.exec( "CREATE INDEX IF NOT EXISTS cache_expires ON cache(expires)" );
+    query.exec( "CREATE INDEX IF NOT EXISTS cache_accessed ON cache(accessed)" );
+
+    query.exec( "SELECT SUM(size) FROM cache" );
+    if ( query.next() )
+        m_size = query.value( 0 ).toLongLong();
+
+    tDebug() << Q_FUNC_INFO << "Info system cache holds" << m_size << "bytes";
+    return true;
+}
+
+
 void
 InfoSystemCache::doUpgrade( uint oldVersion, uint newVersion )
 {
     Q_UNUSED( newVersion );
     qDebug() << Q_FUNC_INFO;
-    if ( oldVersion == 0 || oldVersion == 1  )
+    if ( oldVersion == 0 || oldVersion == 1 || oldVersion == 2 )
     {
+        // up to version 2, every entry was an ini file in a dir per type
         qDebug() << Q_FUNC_INFO << "Wiping cache";
 
         for ( int i = InfoNoInfo; i <= InfoLastInfo; i++ )
@@ -95,6 +157,8 @@ InfoSystemCache::doUpgrade( uint oldVersion, uint newVersion )
                 if ( !QFile::remove( file.canonicalFilePath() ) )
                     tLog() << "During upgrade, failed to remove cache file " << file.canonicalFilePath();
             }
+
+            QDir( m_cacheBaseDir ).rmdir( QString::number( (int)type ) );
         }
     }
 }
@@ -104,29 +168,26 @@ void
 InfoSystemCache::pruneTimerFired()
 {
     qDebug() << Q_FUNC_INFO << "Pruning infosystemcache";
-    qlonglong currentMSecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    if ( !m_db.isOpen() )
+        return;
 
-    for ( int i = InfoNoInfo; i <= InfoLastInfo; i++ )
-    {
-        InfoType type = (InfoType)(i);
-        QHash< QString, QString > fileLocationHash = m_fileLocationCache[type];
-        const QString cacheDirName = m_cacheBaseDir + QString::number( (int)type );
-        QFileInfoList fileList = QDir( cacheDirName ).entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
-        foreach ( QFileInfo file, fileList )
-        {
-            QString baseName = file.baseName();
-            if ( file.suffix().toLongLong() < currentMSecsSinceEpoch )
-            {
-                if ( !QFile::remove( file.canonicalFilePath() ) )
-                    tLog() << "Failed to remove stale cache file" << file.canonicalFilePath();
-                else
-                    qDebug() << "Removed stale cache file" << file.canonicalFilePath();
-            }
-            if ( fileLocationHash.contains( baseName ) )
-                fileLocationHash.remove( baseName );
-        }
-        m_fileLocationCache[type] = fileLocationHash;
-    }
+    const qlonglong currentMSecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+
+    TomahawkSqlQuery query( m_db );
+    query.prepare( "SELECT COUNT(*), SUM(size) FROM cache WHERE expires < ?" );
+    query.addBindValue( currentMSecsSinceEpoch );
+    query.exec();
+    if ( !query.next() || query.value( 0 ).toInt() == 0 )
+        return;
+
+    const int count = query.value( 0 ).toInt();
+    m_size -= query.value( 1 ).toLongLong();
+
+    query.prepare( "DELETE FROM cache WHERE expires < ?" );
+    query.addBindValue( currentMSecsSinceEpoch );
+    query.exec();
+
+    qDebug() << "Removed" << count << "stale cache entries";
 }
 
 
@@ -134,91 +195,71 @@ void
 InfoSystemCache::getCachedInfoSlot( Tomahawk::InfoSystem::InfoStringHash criteria, qint64 newMaxAge, Tomahawk::InfoSystem::InfoRequestData requestData )
 {
     QObject* sendingObj = sender();
-    const QString criteriaHashVal = criteriaMd5( criteria );
-    const QString criteriaHashValWithType = criteriaMd5( criteria, requestData.type );
-    QHash< QString, QString > fileLocationHash = m_fileLocationCache[ requestData.type ];
-    if ( !fileLocationHash.contains( criteriaHashVal ) )
-    {
-        if ( !fileLocationHash.isEmpty() )
-        {
-            //We already know of some values, so no need to re-read the directory again as it's already happened
-            qDebug() << Q_FUNC_INFO << "notInCache -- filelocationhash empty";
-            notInCache( sendingObj, criteria, requestData );
-            return;
-        }
+    const QString key = criteriaMd5( criteria, requestData.type );
 
-        const QString cacheDir = m_cacheBaseDir + QString::number( (int)requestData.type );
-        QDir dir( cacheDir );
-        if ( !dir.exists() )
-        {
-            //Dir doesn't exist so clearly not in cache
-            qDebug() << Q_FUNC_INFO << "notInCache -- dir doesn't exist";
-            notInCache( sendingObj, criteria, requestData );
-            return;
-        }
-
-        QFileInfoList fileList = dir.entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
-        foreach ( QFileInfo file, fileList )
-        {
-            QString baseName = file.baseName();
-            fileLocationHash[ baseName ] = file.canonicalFilePath();
-        }
+    if ( !m_db.isOpen() )
+    {
+        notInCache( sendingObj, criteria, requestData );
+        return;
+    }
 
-        //Store what we've loaded up
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
-        if ( !fileLocationHash.contains( criteriaHashVal ) )
-        {
-            //Still didn't find it? It's really not in the cache then
-            qDebug() << Q_FUNC_INFO << "notInCache -- filelocationhash doesn't contain criteria val";
-            notInCache( sendingObj, criteria, requestData );
-            return;
-        }
+    TomahawkSqlQuery query( m_db );
+    query.prepare( "SELECT expires, accessed, size FROM cache WHERE key = ?" );
+    query.addBindValue( key );
+    query.exec();
+    if ( !query.next() )
+    {
+        qDebug() << Q_FUNC_INFO << "notInCache -- no entry";
+        m_dataCache.remove( key );
+        notInCache( sendingObj, criteria, requestData );
+        return;
     }
 
-    QFileInfo file( fileLocationHash[ criteriaHashVal ] );
-    qlonglong currMaxAge = file.suffix().toLongLong();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 expires = query.value( 0 ).toLongLong();
+    const uint accessed = query.value( 1 ).toUInt();
+    const qint64 size = query.value( 2 ).toLongLong();
 
-    if ( currMaxAge < QDateTime::currentMSecsSinceEpoch() )
+    if ( expires < now )
     {
-        if ( !QFile::remove( file.canonicalFilePath() ) )
-            tLog() << "Failed to remove stale cache file" << file.canonicalFilePath();
-        else
-            qDebug() << "Removed stale cache file" << file.canonicalFilePath();
+        removeEntry( key, size );
 
-        fileLocationHash.remove( criteriaHashVal );
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
-        m_dataCache.remove( criteriaHashValWithType );
-
-        qDebug() << Q_FUNC_INFO << "notInCache -- file was stale";
+        qDebug() << Q_FUNC_INFO << "notInCache -- entry was stale";
         notInCache( sendingObj, criteria, requestData );
         return;
     }
-    else if ( newMaxAge > 0 )
+
+    // don't turn every hit into a write, an hour is precise enough for evicting
+    const uint nowSecs = now / 1000;
+    if ( newMaxAge > 0 || accessed + ACCESS_GRANULARITY < nowSecs )
     {
-        const QString newFilePath = QString( file.dir().canonicalPath() + '/' + criteriaHashVal + '.' + QString::number( QDateTime::currentMSecsSinceEpoch() + newMaxAge ) );
+        query.prepare( "UPDATE cache SET expires = ?, accessed = ? WHERE key = ?" );
+        query.addBindValue( newMaxAge > 0 ? now + newMaxAge : expires );
+        query.addBindValue( nowSecs );
+        query.addBindValue( key );
+        query.exec();
+    }
+
+    if ( !m_dataCache.contains( key ) )
+    {
+        query.prepare( "SELECT data FROM cache WHERE key = ?" );
+        query.addBindValue( key );
+        query.exec();
 
-        if ( !QFile::rename( file.canonicalFilePath(), newFilePath ) )
+        QVariant output;
+        if ( query.next() )
         {
-            qDebug() << Q_FUNC_INFO << "notInCache -- failed to move old cache file to new location";
-            notInCache( sendingObj, criteria, requestData );
-            return;
+            QDataStream stream( query.value( 0 ).toByteArray() );
+            stream >> output;
         }
 
-        fileLocationHash[ criteriaHashVal ] = newFilePath;
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
-    }
-
-    if ( !m_dataCache.contains( criteriaHashValWithType ) )
-    {
-        QSettings cachedSettings( fileLocationHash[ criteriaHashVal ], QSettings::IniFormat );
-        QVariant output = cachedSettings.value( "data" );
-        m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
+        m_dataCache.insert( key, new QVariant( output ) );
 
         emit info( requestData, output );
     }
     else
     {
-        emit info( requestData, QVariant( *( m_dataCache[ criteriaHashValWithType ] ) ) );
+        emit info( requestData, QVariant( *( m_dataCache[ key ] ) ) );
     }
 }
 
@@ -234,52 +275,84 @@ void
 InfoSystemCache::updateCacheSlot( Tomahawk::InfoSystem::InfoStringHash criteria, qint64 maxAge, Tomahawk::InfoSystem::InfoType type, QVariant output )
 {
     qDebug() << Q_FUNC_INFO;
-    const QString criteriaHashVal = criteriaMd5( criteria );
-    const QString criteriaHashValWithType = criteriaMd5( criteria, type );
-    const QString cacheDir = m_cacheBaseDir + QString::number( (int)type );
-    const QString settingsFilePath( cacheDir + '/' + criteriaHashVal + '.' + QString::number( QDateTime::currentMSecsSinceEpoch() + maxAge ) );
+    const QString key = criteriaMd5( criteria, type );
+    m_dataCache.insert( key, new QVariant( output ) );
+
+    if ( !m_db.isOpen() )
+        return;
 
-    QHash< QString, QString > fileLocationHash = m_fileLocationCache[ type ];
-    if ( fileLocationHash.contains( criteriaHashVal ) )
+    // images end up as plain bytes in here, no need to encode them in any way
+    QByteArray data;
     {
-        if ( !QFile::rename( fileLocationHash[ criteriaHashVal ], settingsFilePath ) )
-        {
-            tLog() << "Failed to move old cache file to new location!";
-            return;
-        }
-        fileLocationHash[ criteriaHashVal ] = settingsFilePath;
-        m_fileLocationCache[ type ] = fileLocationHash;
+        QDataStream stream( &data, QIODevice::WriteOnly );
+        stream << output;
+    }
 
-        QSettings cachedSettings( fileLocationHash[ criteriaHashVal ], QSettings::IniFormat );
-        cachedSettings.setValue( "data", output );
+    TomahawkSqlQuery query( m_db );
+    query.prepare( "SELECT size FROM cache WHERE key = ?" );
+    query.addBindValue( key );
+    query.exec();
+    if ( query.next() )
+        m_size -= query.value( 0 ).toLongLong();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    query.prepare( "INSERT OR REPLACE INTO cache(key, type, expires, accessed, size, data) VALUES(?, ?, ?, ?, ?, ?)" );
+    query.addBindValue( key );
+    query.addBindValue( (int)type );
+    query.addBindValue( now + maxAge );
+    query.addBindValue( (uint)( now / 1000 ) );
+    query.addBindValue( data.size() );
+    query.addBindValue( data );
+    query.exec();
+
+    m_size += data.size();
+    if ( m_size > TomahawkSettings::instance()->infoSystemCacheMaxSize() )
+        evict();
+}
 
-        m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
 
-        return;
-    }
+void
+InfoSystemCache::removeEntry( const QString& key, qint64 size )
+{
+    TomahawkSqlQuery query( m_db );
+    query.prepare( "DELETE FROM cache WHERE key = ?" );
+    query.addBindValue( key );
+    query.exec();
+
+    m_size -= size;
+    m_dataCache.remove( key );
+}
 
-    QDir dir( cacheDir );
-    if( !dir.exists( cacheDir ) )
+
+void
+InfoSystemCache::evict()
+{
+    // get comfortably below the limit, so we don't have to do this again on the next insert
+    const qint64 target = TomahawkSettings::instance()->infoSystemCacheMaxSize() / 10 * 9;
+    tDebug() << Q_FUNC_INFO << "Cache holds" << m_size << "bytes, evicting down to" << target;
+
+    TomahawkSqlQuery query( m_db );
+    m_db.transaction();
+    while ( m_size > target )
     {
-        qDebug() << "Creating cache directory " << cacheDir;
-        if( !dir.mkpath( cacheDir ) )
+        query.prepare( QString( "SELECT key, size FROM cache ORDER BY accessed LIMIT %1" ).arg( EVICT_BATCH_SIZE ) );
+        query.exec();
+
+        QList< QPair< QString, qint64 > > entries;
+        while ( query.next() )
+            entries << qMakePair( query.value( 0 ).toString(), query.value( 1 ).toLongLong() );
+
+        if ( entries.isEmpty() )
         {
-            tLog() << "Failed to create cache dir! Bailing...";
-            return;
+            // nothing left, our bookkeeping was off
+            m_size = 0;
+            break;
         }
-    }
 
-    QSettings cachedSettings( settingsFilePath, QSettings::IniFormat );
-    QStringList keys = criteria.keys();
-    cachedSettings.beginGroup( "criteria" );
-    for( int i = 0; i < criteria.size(); i++ )
-        cachedSettings.setValue( keys.at( i ), criteria[keys.at( i )] );
-    cachedSettings.endGroup();
-    cachedSettings.setValue( "data", output );
-
-    fileLocationHash[criteriaHashVal] = settingsFilePath;
-    m_fileLocationCache[type] = fileLocationHash;
-    m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
+        for ( int i = 0; i < entries.count() && m_size > target; i++ )
+            removeEntry( entries.at( i ).first, entries.at( i ).second );
+    }
+    m_db.commit();
 }
 
 
@@ -22,6 +22,7 @@
 #include <QCache>
 #include <QDateTime>
 #include <QObject>
+#include <QSqlDatabase>
 #include <QtDebug>
 #include <QTimer>
 
@@ -33,6 +34,9 @@ namespace Tomahawk
 namespace InfoSystem
 {
 
+// Cached info lives in a single SQLite db, keyed by the md5 of the criteria and type.
+// Entries expire after their max age, and the least recently used ones get evicted when
+// the cache grows beyond TomahawkSettings::infoSystemCacheMaxSize().
 class InfoSystemCache : public QObject
 {
 Q_OBJECT
@@ -56,9 +60,14 @@ private:
     void notInCache( QObject *receiver, Tomahawk::InfoSystem::InfoStringHash criteria, Tomahawk::InfoSystem::InfoRequestData requestData );
     void doUpgrade( uint oldVersion, uint newVersion );
     const QString criteriaMd5( const Tomahawk::InfoSystem::InfoStringHash &criteria, Tomahawk::InfoSystem::InfoType type = Tomahawk::InfoSystem::InfoNoInfo ) const;
-    
+
+    bool openDatabase();
+    void removeEntry( const QString& key, qint64 size );
+    void evict();
+
     QString m_cacheBaseDir;
-    QHash< InfoType, QHash< QString, QString > > m_fileLocationCache;
+    QSqlDatabase m_db;
+    qint64 m_size;
     QTimer m_pruneTimer;
     QCache< QString, QVariant > m_dataCache;
 
@@ -23,16 +23,26 @@
 
 #include "utils/logger.h"
 
-// Msgs are framed, this is the size each msg we send containing audio data:
+// Msgs are framed, this is the size each msg we send containing audio data,
+// unless both peers agree on a larger one:
 #define BLOCKSIZE 4096
 
+// how much data ahead of the read position we want to be there or on its way
+#define PREFETCH_SIZE 256 * 1024
+
 
 BufferIODevice::BufferIODevice( unsigned int size, QObject* parent )
     : QIODevice( parent )
+    , m_nextEmptyBlock( 0 )
+    , m_streamBlock( 0 )
+    , m_requestedBlock( -1 )
     , m_size( size )
     , m_received( 0 )
+    , m_blockSize( BLOCKSIZE )
     , m_pos( 0 )
 {
+    m_buffer.resize( m_size );
+    m_blocks.resize( maxBlocks() );
 }
 
 
@@ -66,11 +76,16 @@ BufferIODevice::seek( qint64 pos )
     if ( pos >= m_size )
         return false;
 
-    int block = blockForPos( pos );
-    if ( isBlockEmpty( block ) )
-        emit blockRequest( block );
+    int request;
+    {
+        QMutexLocker lock( &m_mut );
+        m_pos = pos;
+        request = prefetch( pos );
+    }
+
+    if ( request >= 0 )
+        emit blockRequest( request );
 
-    m_pos = pos;
     qDebug() << "Finished seeking";
 
     return true;
@@ -81,6 +96,9 @@ void
 BufferIODevice::seeked( int block )
 {
     qDebug() << Q_FUNC_INFO << block << m_size;
+
+    QMutexLocker lock( &m_mut );
+    m_streamBlock = block;
 }
 
 
@@ -95,28 +113,43 @@ BufferIODevice::inputComplete( const QString& errmsg )
 
 
 void
-BufferIODevice::addData( int block, const QByteArray& ba )
+BufferIODevice::addData( int block, const char* data, int len )
 {
+    int request = -1;
     {
         QMutexLocker lock( &m_mut );
 
-        while ( m_buffer.count() <= block )
-            m_buffer << QByteArray();
+        // only grows if we didn't know the size up front
+        const qint64 offset = (qint64)block * m_blockSize;
+        if ( offset + len > m_buffer.size() )
+            m_buffer.resize( offset + len );
+        if ( block >= m_blocks.size() )
+            m_blocks.resize( block + 1 );
 
-        m_buffer.replace( block, ba );
-    }
+        memcpy( m_buffer.data() + offset, data, len );
 
-    // If this was the last block of the transfer, check if we need to fill up gaps
-    if ( block + 1 == maxBlocks() )
-    {
-        if ( nextEmptyBlock() >= 0 )
+        if ( !m_blocks.testBit( block ) )
         {
-            emit blockRequest( nextEmptyBlock() );
+            m_blocks.setBit( block );
+            m_received += len;
         }
+
+        while ( m_nextEmptyBlock < m_blocks.size() && m_blocks.testBit( m_nextEmptyBlock ) )
+            m_nextEmptyBlock++;
+
+        m_streamBlock = block + 1;
+        if ( block == m_requestedBlock )
+            m_requestedBlock = -1;
+
+        // If this was the last block of the transfer, check if we need to fill up gaps
+        if ( block + 1 == maxBlocks() && m_nextEmptyBlock < maxBlocks() )
+            request = m_nextEmptyBlock;
     }
 
-    m_received += ba.count();
-    emit bytesWritten( ba.count() );
+    if ( request >= 0 )
+        emit blockRequest( request );
+
+    emit bytesWritten( len );
     emit readyRead();
 }
 
@@ -136,14 +169,31 @@ BufferIODevice::readData( char* data, qint64 maxSize )
     if ( atEnd() )
         return 0;
 
-    QByteArray ba;
-    ba.append( getData( m_pos, maxSize ) );
-    m_pos += ba.count();
+    qint64 len;
+    int request;
+    {
+        QMutexLocker lock( &m_mut );
+
+        // copy as much as we've got without a gap in one go, straight into the caller's buffer
+        const qint64 end = qMin( (qint64)m_size, (qint64)m_pos + maxSize );
+        const int lastBlock = blockForPos( end - 1 );
+
+        int block = blockForPos( m_pos );
+        while ( block <= lastBlock && !isBlockEmpty( block ) )
+            block++;
+
+        len = qMax( (qint64)0, qMin( end, (qint64)block * m_blockSize ) - m_pos );
+        memcpy( data, m_buffer.constData() + m_pos, len );
+        m_pos += len;
 
-//    qDebug() << Q_FUNC_INFO << maxSize << ba.count() << 2;
-    memcpy( data, ba.data(), ba.count() );
+        request = prefetch( m_pos );
+    }
+
+    if ( request >= 0 )
+        emit blockRequest( request );
 
-    return ba.count();
+//    qDebug() << Q_FUNC_INFO << maxSize << len << 2;
+    return len;
 }
 
 
@@ -180,17 +230,35 @@ BufferIODevice::clear()
     QMutexLocker lock( &m_mut );
 
     m_pos = 0;
-    m_buffer.clear();
+    m_received = 0;
+    m_nextEmptyBlock = 0;
+    m_streamBlock = 0;
+    m_requestedBlock = -1;
+    m_blocks.fill( false );
 }
 
 
 unsigned int
-BufferIODevice::blockSize()
+BufferIODevice::defaultBlockSize()
 {
     return BLOCKSIZE;
 }
 
 
+void
+BufferIODevice::setBlockSize( unsigned int size )
+{
+    QMutexLocker lock( &m_mut );
+
+    Q_ASSERT( !m_received );
+    if ( m_received || !size )
+        return;
+
+    m_blockSize = size;
+    m_blocks = QBitArray( maxBlocks() );
+}
+
+
 int
 BufferIODevice::blockForPos( qint64 pos ) const
 {
@@ -198,7 +266,7 @@ BufferIODevice::blockForPos( qint64 pos ) const
     // 4095 / 4096 -> block 0
     // 4096 / 4096 -> block 1
 
-    return pos / BLOCKSIZE;
+    return pos / m_blockSize;
 }
 
 
@@ -209,35 +277,28 @@ BufferIODevice::offsetForPos( qint64 pos ) const
     // 4095 % 4096 -> offset 4095
     // 4096 % 4096 -> offset 0
 
-    return pos % BLOCKSIZE;
+    return pos % m_blockSize;
 }
 
 
 int
 BufferIODevice::nextEmptyBlock() const
 {
-    int i = 0;
-    foreach( const QByteArray& ba, m_buffer )
-    {
-        if ( ba.isEmpty() )
-            return i;
-
-        i++;
-    }
+    QMutexLocker lock( &m_mut );
 
-    if ( i == maxBlocks() )
+    if ( m_nextEmptyBlock >= maxBlocks() )
         return -1;
 
-    return i;
+    return m_nextEmptyBlock;
 }
 
 
 int
 BufferIODevice::maxBlocks() const
 {
-    int i = m_size / BLOCKSIZE;
+    int i = m_size / m_blockSize;
 
-    if ( ( m_size % BLOCKSIZE ) > 0 )
+    if ( ( m_size % m_blockSize ) > 0 )
         i++;
 
     return i;
@@ -247,33 +308,38 @@ BufferIODevice::maxBlocks() const
 bool
 BufferIODevice::isBlockEmpty( int block ) const
 {
-    if ( block >= m_buffer.count() )
+    if ( block >= m_blocks.size() )
         return true;
 
-    return m_buffer.at( block ).isEmpty();
+    return !m_blocks.testBit( block );
 }
 
 
-QByteArray
-BufferIODevice::getData( qint64 pos, qint64 size )
+int
+BufferIODevice::firstEmptyBlock( int from, int to ) const
 {
-//    qDebug() << Q_FUNC_INFO << pos << size << 1;
-    QByteArray ba;
-    int block = blockForPos( pos );
-    int offset = offsetForPos( pos );
-
-    QMutexLocker lock( &m_mut );
-    while( ba.count() < size )
+    for ( int i = qMax( from, m_nextEmptyBlock ); i < to; i++ )
     {
-        if ( block > maxBlocks() )
-            break;
+        if ( isBlockEmpty( i ) )
+            return i;
+    }
 
-        if ( isBlockEmpty( block ) )
-            break;
+    return -1;
+}
 
-        ba.append( m_buffer.at( block++ ).mid( offset ) );
-    }
 
-//    qDebug() << Q_FUNC_INFO << pos << size << 2;
-    return ba.left( size );
+int
+BufferIODevice::prefetch( qint64 pos )
+{
+    // Is there a gap right ahead of the read position, which the sender isn't about to fill anyway?
+    // Then ask for it now, before playback runs into it.
+    const int from = blockForPos( pos );
+    const int to = qMin( maxBlocks(), blockForPos( pos + PREFETCH_SIZE ) + 1 );
+
+    const int block = firstEmptyBlock( from, to );
+    if ( block < 0 || block == m_streamBlock || block == m_requestedBlock )
+        return -1;
+
+    m_requestedBlock = block;
+    return block;
 }
@@ -21,8 +21,14 @@
 
 #include <QIODevice>
 #include <QMutexLocker>
+#include <QBitArray>
 #include <QFile>
 
+/*
+    Receive buffer of a stream from a peer. Blocks may arrive out of order (after seeking),
+    they get copied into one buffer allocated up front for the whole file, and a bitmap
+    keeps track of which of them we've got already.
+*/
 class BufferIODevice : public QIODevice
 {
 Q_OBJECT
@@ -41,7 +47,8 @@ public:
     virtual bool atEnd() const;
     virtual qint64 pos() const { return m_pos; }
 
-    void addData( int block, const QByteArray& ba );
+    void addData( int block, const char* data, int len );
+    void addData( int block, const QByteArray& ba ) { addData( block, ba.constData(), ba.length() ); }
     void clear();
 
     OpenMode openMode() const { return QIODevice::ReadOnly | QIODevice::Unbuffered; }
@@ -50,7 +57,10 @@ public:
 
     virtual bool isSequential() const { return false; }
 
-    static unsigned int blockSize();
+    static unsigned int defaultBlockSize();
+    unsigned int blockSize() const { return m_blockSize; }
+    // only before any data got added, the sender decides about it when the stream starts
+    void setBlockSize( unsigned int size );
 
     int maxBlocks() const;
     int nextEmptyBlock() const;
@@ -66,11 +76,20 @@ protected:
 private:
     int blockForPos( qint64 pos ) const;
     int offsetForPos( qint64 pos ) const;
-    QByteArray getData( qint64 pos, qint64 size );
 
-    QList<QByteArray> m_buffer;
+    // call with m_mut locked
+    int firstEmptyBlock( int from, int to ) const;
+    int prefetch( qint64 pos );
+
+    QByteArray m_buffer;
+    QBitArray m_blocks;
+    int m_nextEmptyBlock;   // all blocks before this one are there
+    int m_streamBlock;      // the block the sender is going to send next
+    int m_requestedBlock;   // gap we asked the sender for, until it arrives
+
     mutable QMutex m_mut; //const methods need to lock
     unsigned int m_size, m_received;
+    unsigned int m_blockSize;
 
     unsigned int m_pos;
 };
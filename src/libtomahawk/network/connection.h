@@ -83,6 +83,8 @@ public:
 
     qint64 bytesSent() const { return m_tx_bytes; }
     qint64 bytesReceived() const { return m_rx_bytes; }
+    /// bytes handed to sendMsg() which haven't been written to the socket yet
+    qint64 bytesPending() const { return m_tx_bytes_requested - m_tx_bytes; }
 
     void setMsgProcessorModeOut( quint32 m ) { m_msgprocessor_out.setMode( m ); }
     void setMsgProcessorModeIn( quint32 m ) { m_msgprocessor_in.setMode( m ); }
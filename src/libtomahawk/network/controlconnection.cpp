@@ -246,7 +246,7 @@ ControlConnection::handleMsg( msg_ptr msg )
             QString theirkey = m["key"].toString();
             QString ourkey   = m["offer"].toString();
             QString theirdbid = m["controlid"].toString();
-            servent()->reverseOfferRequest( this, theirdbid, ourkey, theirkey );
+            servent()->reverseOfferRequest( this, theirdbid, ourkey, theirkey, m.value( "blocksize" ).toUInt() );
         }
         else if( m.value( "method" ).toString() == "dbsync-offer" )
         {
@@ -26,14 +26,25 @@
 
     Synced.
 
+    Ops are loaded and sent a chunk at a time, all msgs but the very last
+    one flagged as FRAGMENT.
+
+    Peers that ask for it ("bulk" in the fetchops msg) get the ops packed
+    into JSON lists, many per msg, which are compressed on the wire.
+    A peer that has never synced with us can also ask for a "snapshot":
+    instead of the whole history of added and deleted files it then gets
+    the rest of the ops, followed by the files as they are now.
+
 */
 
 #include "dbsyncconnection.h"
 
 #include "database/database.h"
 #include "database/databasecommand.h"
+#include "database/databasecommandloggable.h"
 #include "database/databasecommand_collectionstats.h"
 #include "database/databasecommand_loadops.h"
+#include "database/databasecommand_loadsnapshot.h"
 #include "remotecollection.h"
 #include "source.h"
 #include "sourcelist.h"
@@ -41,10 +52,21 @@
 
 using namespace Tomahawk;
 
+// ops loaded from the db at a time
+#define OPS_CHUNK_SIZE 5000
+// limits for the ops packed into a single msg in bulk mode
+#define MAX_BULK_OPS 1000
+#define MAX_BULK_BYTES 1048576
+
 
 DBSyncConnection::DBSyncConnection( Servent* s, const source_ptr& src )
     : Connection( s )
     , m_source( src )
+    , m_sending( false )
+    , m_sendBulk( false )
+    , m_sendSnapshot( false )
+    , m_firstChunk( false )
+    , m_receivingSnapshot( false )
     , m_state( UNKNOWN )
 {
     qDebug() << Q_FUNC_INFO << src->id() << thread();
@@ -165,6 +187,10 @@ DBSyncConnection::fetchOpsData( const QString& sinceguid )
     QVariantMap msg;
     msg.insert( "method", "fetchops" );
     msg.insert( "lastop", sinceguid );
+    msg.insert( "bulk", true );
+    m_receivingSnapshot = sinceguid.isEmpty();
+    if ( m_receivingSnapshot )
+        msg.insert( "snapshot", true );
     sendMsg( msg );
 }
 
@@ -195,32 +221,49 @@ DBSyncConnection::handleMsg( msg_ptr msg )
 
     Q_ASSERT( msg->is( Msg::JSON ) );
 
-    QVariantMap m = msg->json().toMap();
-    if ( m.empty() )
-    {
-        tLog() << "Failed to parse msg in dbsync" << m_source->id() << m_source->friendlyName();
-        Q_ASSERT( false );
-        return;
-    }
-
-    // a db sync op msg
+    // a db sync op msg, or a list of them when sent in bulk
     if ( msg->is( Msg::DBOP ) )
     {
-        DatabaseCommand* cmd = DatabaseCommand::factory( m, m_source );
-        if ( cmd )
+        const QVariant& json = msg->json();
+        if ( json.type() == QVariant::List )
+        {
+            foreach ( const QVariant& op, json.toList() )
+                addOp( op.toMap() );
+        }
+        else
         {
-            QSharedPointer<DatabaseCommand> cmdsp = QSharedPointer<DatabaseCommand>(cmd);
-            m_source->addCommand( cmdsp );
+            if ( json.toMap().isEmpty() )
+            {
+                tLog() << "Failed to parse msg in dbsync" << m_source->id() << m_source->friendlyName();
+                Q_ASSERT( false );
+                return;
+            }
+
+            addOp( json.toMap() );
         }
 
         if ( !msg->is( Msg::FRAGMENT ) ) // last msg in this batch
         {
+            // a snapshot is complete with its last op, which is where we continue from
+            if ( m_receivingSnapshot && !m_lastReceivedOp.isNull() )
+                ( (DatabaseCommandLoggable*)m_lastReceivedOp.data() )->setUpdatesLastOp( true );
+            m_lastReceivedOp.clear();
+            m_receivingSnapshot = false;
+
             changeState( SAVING ); // just DB work left to complete
             m_source->executeCommands();
         }
         return;
     }
 
+    QVariantMap m = msg->json().toMap();
+    if ( m.empty() )
+    {
+        tLog() << "Failed to parse msg in dbsync" << m_source->id() << m_source->friendlyName();
+        Q_ASSERT( false );
+        return;
+    }
+
     if ( m.value( "method" ).toString() == "fetchops" )
     {
         m_uscache = m;
@@ -240,6 +283,25 @@ DBSyncConnection::handleMsg( msg_ptr msg )
 }
 
 
+void
+DBSyncConnection::addOp( const QVariantMap& op )
+{
+    DatabaseCommand* cmd = DatabaseCommand::factory( op, m_source );
+    if ( cmd )
+    {
+        QSharedPointer<DatabaseCommand> cmdsp = QSharedPointer<DatabaseCommand>(cmd);
+        if ( cmd->loggable() )
+        {
+            ( (DatabaseCommandLoggable*)cmd )->setUpdatesLastOp( !m_receivingSnapshot );
+            if ( !cmd->singletonCmd() )
+                m_lastReceivedOp = cmdsp;
+        }
+
+        m_source->addCommand( cmdsp );
+    }
+}
+
+
 void
 DBSyncConnection::lastOpApplied()
 {
@@ -253,45 +315,170 @@ DBSyncConnection::lastOpApplied()
 void
 DBSyncConnection::sendOps()
 {
-    tLog( LOGVERBOSE ) << "Will send peer" << m_source->id() << "all ops since" << m_uscache.value( "lastop" ).toString();
+    if ( m_sending )
+    {
+        tLog( LOGVERBOSE ) << "Still sending ops to peer" << m_source->id() << "- ignoring new request";
+        return;
+    }
+
+    const QString since = m_uscache.value( "lastop" ).toString();
+    tLog( LOGVERBOSE ) << "Will send peer" << m_source->id() << "all ops since" << since;
+
+    m_sending = true;
+    m_sendBulk = m_uscache.value( "bulk" ).toBool();
+    m_sendSnapshot = m_uscache.value( "snapshot" ).toBool() && since.isEmpty();
+    m_firstChunk = true;
+    m_snapshotCheckpoint.clear();
+    m_pendingOps.clear();
+
+    loadOps( since );
+}
+
+
+void
+DBSyncConnection::loadOps( const QString& sinceguid )
+{
+    DatabaseCommand_loadOps* cmd = new DatabaseCommand_loadOps( SourceList::instance()->getLocal(), sinceguid );
+    cmd->setLimit( OPS_CHUNK_SIZE );
+    if ( m_sendSnapshot )
+        cmd->setSnapshot( true, m_snapshotCheckpoint );
+
+    connect( cmd, SIGNAL( checkpoint( QString ) ),
+                    SLOT( setSnapshotCheckpoint( QString ) ) );
+    connect( cmd, SIGNAL( done( QString, QString, QList< dbop_ptr >, bool ) ),
+                    SLOT( sendOpsData( QString, QString, QList< dbop_ptr >, bool ) ) );
+
+    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
+}
 
-    source_ptr src = SourceList::instance()->getLocal();
 
-    DatabaseCommand_loadOps* cmd = new DatabaseCommand_loadOps( src, m_uscache.value( "lastop" ).toString() );
-    connect( cmd, SIGNAL( done( QString, QString, QList< dbop_ptr > ) ),
-                    SLOT( sendOpsData( QString, QString, QList< dbop_ptr > ) ) );
+void
+DBSyncConnection::loadSnapshot( unsigned int fromFileId )
+{
+    DatabaseCommand_LoadSnapshot* cmd = new DatabaseCommand_LoadSnapshot( m_snapshotCheckpoint, fromFileId );
+    connect( cmd, SIGNAL( done( QList< dbop_ptr >, unsigned int, bool ) ),
+                    SLOT( sendSnapshotData( QList< dbop_ptr >, unsigned int, bool ) ) );
 
     Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
 }
 
 
 void
-DBSyncConnection::sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops )
+DBSyncConnection::setSnapshotCheckpoint( const QString& guid )
+{
+    m_snapshotCheckpoint = guid;
+}
+
+
+void
+DBSyncConnection::sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops, bool more )
 {
-    if ( m_lastSentOp == lastguid )
+    const bool firstChunk = m_firstChunk;
+    m_firstChunk = false;
+
+    const bool snapshotLeft = m_sendSnapshot && !m_snapshotCheckpoint.isEmpty();
+    if ( firstChunk && !more && !snapshotLeft && m_lastSentOp == lastguid )
         ops.clear();
 
+    tLog( LOGVERBOSE ) << Q_FUNC_INFO << sinceguid << lastguid << "Num ops to send:" << ops.length() << "more:" << more;
+    queueOps( ops );
+
+    if ( more )
+        loadOps( lastguid );
+    else if ( snapshotLeft )
+        loadSnapshot( 0 );
+    else
+        finishSending( lastguid );
+}
+
+
+void
+DBSyncConnection::sendSnapshotData( QList< dbop_ptr > ops, unsigned int lastFileId, bool more )
+{
+    queueOps( ops );
+
+    if ( more )
+        loadSnapshot( lastFileId );
+    else
+        finishSending( m_snapshotCheckpoint );
+}
+
+
+void
+DBSyncConnection::queueOps( const QList< dbop_ptr >& ops )
+{
+    if ( ops.isEmpty() )
+        return;
+
+    if ( !m_pendingOps.isEmpty() )
+        sendOpsMsgs( m_pendingOps, false );
+
+    m_pendingOps = ops;
+}
+
+
+void
+DBSyncConnection::finishSending( const QString& lastguid )
+{
+    m_sending = false;
     m_lastSentOp = lastguid;
-    if ( ops.length() == 0 )
+
+    // nothing was queued, so nothing has been sent either
+    if ( m_pendingOps.isEmpty() )
     {
         tDebug() << "Sending ok" << m_source->id() << m_source->friendlyName();
         sendMsg( Msg::factory( "ok", Msg::DBOP ) );
         return;
     }
 
-    tLog( LOGVERBOSE ) << Q_FUNC_INFO << sinceguid << lastguid << "Num ops to send:" << ops.length();
+    sendOpsMsgs( m_pendingOps, true );
+    m_pendingOps.clear();
+}
+
 
-    int i;
-    for( i = 0; i < ops.length(); ++i )
+void
+DBSyncConnection::sendOpsMsgs( const QList< dbop_ptr >& ops, bool last )
+{
+    if ( !m_sendBulk )
     {
-        quint8 flags = Msg::JSON | Msg::DBOP;
+        int i;
+        for( i = 0; i < ops.length(); ++i )
+        {
+            quint8 flags = Msg::JSON | Msg::DBOP;
+
+            if ( ops.at( i )->compressed )
+                flags |= Msg::COMPRESSED;
+            if ( !last || i != ops.length() - 1 )
+                flags |= Msg::FRAGMENT;
+
+            sendMsg( Msg::factory( ops.at( i )->payload, flags ) );
+        }
+        return;
+    }
 
-        if ( ops.at( i )->compressed )
-            flags |= Msg::COMPRESSED;
-        if ( i != ops.length() - 1 )
+    // pack the ops into JSON lists, the msg processor compresses them
+    QByteArray batch;
+    int count = 0;
+    for ( int i = 0; i < ops.length(); ++i )
+    {
+        const dbop_ptr& op = ops.at( i );
+        batch += ( count == 0 ) ? '[' : ',';
+        batch += op->compressed ? qUncompress( op->payload ) : op->payload;
+        count++;
+
+        const bool lastOp = ( i == ops.length() - 1 );
+        if ( !lastOp && count < MAX_BULK_OPS && batch.length() < MAX_BULK_BYTES )
+            continue;
+
+        batch += ']';
+
+        quint8 flags = Msg::JSON | Msg::DBOP;
+        if ( !last || !lastOp )
             flags |= Msg::FRAGMENT;
 
-        sendMsg( Msg::factory( ops.at( i )->payload, flags ) );
+        sendMsg( Msg::factory( batch, flags ) );
+        batch.clear();
+        count = 0;
     }
 }
 
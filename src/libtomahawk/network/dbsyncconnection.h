@@ -69,7 +69,9 @@ private slots:
     void gotThem( const QVariantMap& m );
 
     void fetchOpsData( const QString& sinceguid );
-    void sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops );
+    void sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops, bool more );
+    void setSnapshotCheckpoint( const QString& guid );
+    void sendSnapshotData( QList< dbop_ptr > ops, unsigned int lastFileId, bool more );
     void lastOpApplied();
 
     void check();
@@ -77,11 +79,28 @@ private slots:
 private:
     void synced();
     void changeState( State newstate );
+    void addOp( const QVariantMap& op );
+
+    void loadOps( const QString& sinceguid );
+    void loadSnapshot( unsigned int fromFileId );
+    void queueOps( const QList< dbop_ptr >& ops );
+    void finishSending( const QString& lastguid );
+    void sendOpsMsgs( const QList< dbop_ptr >& ops, bool last );
 
     Tomahawk::source_ptr m_source;
     QVariantMap m_uscache;
 
     QString m_lastSentOp;
+    bool m_sending;
+    bool m_sendBulk;
+    bool m_sendSnapshot;
+    bool m_firstChunk;
+    QString m_snapshotCheckpoint;
+    // we asked for a snapshot, and the op received last so far
+    bool m_receivingSnapshot;
+    QSharedPointer<DatabaseCommand> m_lastReceivedOp;
+    // the chunk loaded last is held back until we know if it ends the transfer
+    QList< dbop_ptr > m_pendingOps;
 
     State m_state;
 };
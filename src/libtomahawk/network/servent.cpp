@@ -390,6 +390,10 @@ Servent::readyRead()
             tLog() << "claimOffer FAILED, key:" << key << nodeid;
             goto closeconnection;
         }
+
+        StreamConnection* sc = qobject_cast< StreamConnection* >( conn );
+        if ( sc && sc->type() == StreamConnection::SENDING )
+            sc->setRequestedBlockSize( m.value( "blocksize" ).toUInt() );
         tDebug( LOGVERBOSE ) << "claimOffer OK:" << key << nodeid;
 
         m_connectedNodes << nodeid;
@@ -438,6 +442,8 @@ Servent::createParallelConnection( Connection* orig_conn, Connection* new_conn,
         m.insert( "offer", key );
         m.insert( "port", externalPort() );
         m.insert( "controlid", Database::instance()->dbid() );
+        if ( key.startsWith( "FILE_REQUEST_KEY:" ) )
+            m.insert( "blocksize", StreamConnection::maxBlockSize() );
 
         QJson::Serializer ser;
         orig_conn->sendMsg( Msg::factory( ser.serialize(m), Msg::JSON ) );
@@ -554,6 +560,8 @@ Servent::connectToPeer( const QString& ha, int port, const QString &key, Connect
         m["key"]       = key;
         m["port"]      = externalPort();
         m["controlid"] = Database::instance()->dbid();
+        if ( key.startsWith( "FILE_REQUEST_KEY:" ) )
+            m["blocksize"] = StreamConnection::maxBlockSize();
         conn->setFirstMessage( m );
     }
 
@@ -572,7 +580,7 @@ Servent::connectToPeer( const QString& ha, int port, const QString &key, Connect
 
 
 void
-Servent::reverseOfferRequest( ControlConnection* orig_conn, const QString& theirdbid, const QString& key, const QString& theirkey )
+Servent::reverseOfferRequest( ControlConnection* orig_conn, const QString& theirdbid, const QString& key, const QString& theirkey, unsigned int blockSize )
 {
     Q_ASSERT( this->thread() == QThread::currentThread() );
 
@@ -585,6 +593,10 @@ Servent::reverseOfferRequest( ControlConnection* orig_conn, const QString& their
         return;
     }
 
+    StreamConnection* sc = qobject_cast< StreamConnection* >( new_conn );
+    if ( sc )
+        sc->setRequestedBlockSize( blockSize );
+
     QVariantMap m;
     m["conntype"]  = "push-offer";
     m["key"]       = theirkey;
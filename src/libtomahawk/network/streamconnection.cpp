@@ -19,6 +19,7 @@
 #include "streamconnection.h"
 
 #include <QFile>
+#include <QTime>
 
 #include "result.h"
 
@@ -28,10 +29,51 @@
 #include "database/databasecommand_loadfiles.h"
 #include "database/database.h"
 #include "sourcelist.h"
+#include "tomahawksettings.h"
 #include "utils/logger.h"
 
+// largest block size we ask a sending peer for
+#define MAX_BLOCKSIZE 65536
+
 using namespace Tomahawk;
 
+// upload budget shared by all streams going to the same peer
+struct UploadBudget
+{
+    UploadBudget() : available( 0 ), streams( 0 ) {}
+
+    QTime mark;
+    qint64 available;
+    int streams;
+};
+
+static QHash< ControlConnection*, UploadBudget > s_uploadBudgets;
+
+
+// returns how many ms to wait before sending bytes to the peer, or 0 if that's fine now
+static int
+takeUploadBudget( ControlConnection* cc, qint64 bytes, qint64 limit )
+{
+    UploadBudget& budget = s_uploadBudgets[ cc ];
+    const qint64 capacity = qMax( limit, bytes );
+
+    if ( budget.mark.isNull() )
+    {
+        budget.mark.start();
+        budget.available = capacity;
+    }
+    else
+    {
+        budget.available = qMin( capacity, budget.available + budget.mark.restart() * limit / 1000 );
+    }
+
+    if ( budget.available < bytes )
+        return ( bytes - budget.available ) * 1000 / limit + 1;
+
+    budget.available -= bytes;
+    return 0;
+}
+
 
 StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString fid, const Tomahawk::result_ptr& result )
     : Connection( s )
@@ -39,6 +81,12 @@ StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString f
     , m_fid( fid )
     , m_type( RECEIVING )
     , m_curBlock( 0 )
+    , m_blockSize( BufferIODevice::defaultBlockSize() )
+    , m_negotiating( true )
+    , m_pendingSeek( -1 )
+    , m_windowSize( 0 )
+    , m_rateLimit( 0 )
+    , m_sentAll( false )
     , m_badded( 0 )
     , m_bsent( 0 )
     , m_allok( false )
@@ -72,11 +120,23 @@ StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString f
     , m_cc( cc )
     , m_fid( fid )
     , m_type( SENDING )
+    , m_curBlock( 0 )
+    , m_blockSize( BufferIODevice::defaultBlockSize() )
+    , m_negotiating( false )
+    , m_pendingSeek( -1 )
+    , m_windowSize( TomahawkSettings::instance()->streamWindowSize() )
+    , m_rateLimit( TomahawkSettings::instance()->uploadRateLimit() )
+    , m_sentAll( false )
     , m_badded( 0 )
     , m_bsent( 0 )
     , m_allok( false )
     , m_transferRate( 0 )
 {
+    s_uploadBudgets[ m_cc ].streams++;
+
+    m_throttleTimer.setSingleShot( true );
+    connect( &m_throttleTimer, SIGNAL( timeout() ), SLOT( sendSome() ) );
+
     Servent::instance()->registerStreamConnection( this );
     // auto delete when connection closes:
     connect( this, SIGNAL( finished() ), SLOT( deleteLater() ), Qt::QueuedConnection );
@@ -97,10 +157,31 @@ StreamConnection::~StreamConnection()
         ((BufferIODevice*)m_iodev.data())->inputComplete();
     }
 
+    if ( m_type == SENDING && --s_uploadBudgets[ m_cc ].streams == 0 )
+        s_uploadBudgets.remove( m_cc );
+
     Servent::instance()->onStreamFinished( this );
 }
 
 
+unsigned int
+StreamConnection::maxBlockSize()
+{
+    return MAX_BLOCKSIZE;
+}
+
+
+void
+StreamConnection::setRequestedBlockSize( unsigned int size )
+{
+    Q_ASSERT( m_type == SENDING );
+
+    // peers which don't know about this yet keep getting the default block size
+    if ( size > BufferIODevice::defaultBlockSize() )
+        m_blockSize = qMin( size, (unsigned int)MAX_BLOCKSIZE );
+}
+
+
 QString
 StreamConnection::id() const
 {
@@ -186,6 +267,17 @@ StreamConnection::startSending( const Tomahawk::result_ptr& result )
     }
 
     m_readdev = QSharedPointer<QIODevice>( io );
+
+    // only a peer which asked for a different block size knows what to do with this
+    if ( m_blockSize != BufferIODevice::defaultBlockSize() )
+    {
+        QByteArray sm;
+        sm.append( QString( "setblocksize%1" ).arg( m_blockSize ) );
+        sendMsg( Msg::factory( sm, Msg::RAW | Msg::FRAGMENT ) );
+    }
+
+    // the socket draining its write buffer asks for more data
+    connect( m_sock.data(), SIGNAL( bytesWritten( qint64 ) ), SLOT( sendSome() ), Qt::QueuedConnection );
     sendSome();
 
     emit updated();
@@ -197,42 +289,74 @@ StreamConnection::handleMsg( msg_ptr msg )
 {
     Q_ASSERT( msg->is( Msg::RAW ) );
 
-    if ( msg->payload().startsWith( "block" ) )
+    if ( m_type == SENDING )
     {
-        int block = QString( msg->payload() ).mid( 5 ).toInt();
-        m_readdev->seek( block * BufferIODevice::blockSize() );
+        if ( msg->payload().startsWith( "block" ) )
+        {
+            int block = QString( msg->payload() ).mid( 5 ).toInt();
+            m_readdev->seek( (qint64)block * m_blockSize );
 
-        qDebug() << "Seeked to block:" << block;
+            qDebug() << "Seeked to block:" << block;
 
-        QByteArray sm;
-        sm.append( QString( "doneblock%1" ).arg( block ) );
+            QByteArray sm;
+            sm.append( QString( "doneblock%1" ).arg( block ) );
 
-        sendMsg( Msg::factory( sm, Msg::RAW | Msg::FRAGMENT ) );
-        QTimer::singleShot( 0, this, SLOT( sendSome() ) );
+            sendMsg( Msg::factory( sm, Msg::RAW | Msg::FRAGMENT ) );
+
+            m_sentAll = false;
+            sendSome();
+        }
+
+        return;
+    }
+
+    BufferIODevice* bio = (BufferIODevice*)m_iodev.data();
+
+    if ( m_negotiating )
+    {
+        // the sender's first msg tells us whether it agreed on a block size, older peers just start sending data
+        m_negotiating = false;
+        if ( msg->payload().startsWith( "setblocksize" ) )
+        {
+            bio->setBlockSize( QString( msg->payload() ).mid( 12 ).toUInt() );
+            m_blockSize = bio->blockSize();
+            qDebug() << "Sender agreed on block size:" << m_blockSize;
+        }
+
+        if ( m_pendingSeek >= 0 )
+        {
+            onBlockRequest( m_pendingSeek / m_blockSize );
+            m_pendingSeek = -1;
+        }
+
+        if ( msg->payload().startsWith( "setblocksize" ) )
+            return;
     }
-    else if ( msg->payload().startsWith( "doneblock" ) )
+
+    if ( msg->payload().startsWith( "doneblock" ) )
     {
         int block = QString( msg->payload() ).mid( 9 ).toInt();
-        ((BufferIODevice*)m_iodev.data())->seeked( block );
+        bio->seeked( block );
 
         m_curBlock = block;
         qDebug() << "Next block is now:" << block;
     }
     else if ( msg->payload().startsWith( "data" ) )
     {
-        m_badded += msg->payload().length() - 4;
-        ((BufferIODevice*)m_iodev.data())->addData( m_curBlock++, msg->payload().mid( 4 ) );
+        const QByteArray& payload = msg->payload();
+        m_badded += payload.length() - 4;
+        bio->addData( m_curBlock++, payload.constData() + 4, payload.length() - 4 );
     }
 
     //qDebug() << Q_FUNC_INFO << "flags" << (int) msg->flags()
     //         << "payload len" << msg->payload().length()
     //         << "written to device so far: " << m_badded;
 
-    if ( ((BufferIODevice*)m_iodev.data())->nextEmptyBlock() < 0 )
+    if ( bio->nextEmptyBlock() < 0 )
     {
         m_allok = true;
         // tell our iodev there is no more data to read, no args meaning a success:
-        ((BufferIODevice*)m_iodev.data())->inputComplete();
+        bio->inputComplete();
         shutdown();
     }
 }
@@ -251,24 +375,53 @@ StreamConnection::sendSome()
 {
     Q_ASSERT( m_type == StreamConnection::SENDING );
 
-    QByteArray ba = "data";
-    ba.append( m_readdev->read( BufferIODevice::blockSize() ) );
-    m_bsent += ba.length() - 4;
-
-    if( m_readdev->atEnd() )
-    {
-        sendMsg( Msg::factory( ba, Msg::RAW ) );
+    if ( m_readdev.isNull() )
         return;
-    }
-    else
+
+    // Keep a window of data on its way to the peer. Each bytesWritten() of the socket
+    // brings us back here, so we neither spin the event loop nor flood the write buffer.
+    while ( !m_sentAll && bytesPending() < m_windowSize )
     {
-        // more to come -> FRAGMENT
-        sendMsg( Msg::factory( ba, Msg::RAW | Msg::FRAGMENT ) );
-    }
+        if ( m_rateLimit > 0 )
+        {
+            if ( m_throttleTimer.isActive() )
+                return;
+
+            const int wait = takeUploadBudget( m_cc, m_blockSize, m_rateLimit );
+            if ( wait > 0 )
+            {
+                m_throttleTimer.start( wait );
+                return;
+            }
+        }
+
+        // read straight into the msg payload, right behind the prefix
+        QByteArray ba;
+        ba.resize( m_blockSize + 4 );
+        memcpy( ba.data(), "data", 4 );
+
+        const qint64 len = m_readdev->read( ba.data() + 4, m_blockSize );
+        if ( len < 0 )
+        {
+            qDebug() << "Failed reading from source:" << m_result->url();
+            shutdown();
+            return;
+        }
+
+        ba.resize( len + 4 );
+        m_bsent += len;
 
-    // HINT: change the 0 to 50 to transmit at 640Kbps, for example
-    //       (this is where upload throttling could be implemented)
-    QTimer::singleShot( 0, this, SLOT( sendSome() ) );
+        if ( m_readdev->atEnd() )
+        {
+            m_sentAll = true;
+            sendMsg( Msg::factory( ba, Msg::RAW ) );
+        }
+        else
+        {
+            // more to come -> FRAGMENT
+            sendMsg( Msg::factory( ba, Msg::RAW | Msg::FRAGMENT ) );
+        }
+    }
 }
 
 
@@ -280,6 +433,13 @@ StreamConnection::onBlockRequest( int block )
     if ( m_curBlock == block )
         return;
 
+    // block numbers are only meaningful once the sender told us its block size
+    if ( m_negotiating )
+    {
+        m_pendingSeek = (qint64)block * m_blockSize;
+        return;
+    }
+
     QByteArray sm;
     sm.append( QString( "block%1" ).arg( block ) );
 
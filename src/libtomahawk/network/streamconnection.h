@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QSharedPointer>
 #include <QIODevice>
+#include <QTimer>
 
 #include "network/connection.h"
 #include "result.h"
@@ -63,6 +64,11 @@ public:
     Type type() const { return m_type; }
     QString fid() const { return m_fid; }
 
+    /// the largest block size a receiving peer asks for when setting up the stream
+    static unsigned int maxBlockSize();
+    /// TX: block size the receiving peer asked for, 0 if it doesn't know about negotiating one
+    void setRequestedBlockSize( unsigned int size );
+
 signals:
     void updated();
 
@@ -84,6 +90,17 @@ private:
     QSharedPointer<QIODevice> m_readdev;
 
     int m_curBlock;
+    unsigned int m_blockSize;
+
+    // RX: waiting for the sender to tell us the block size, and where to seek to then
+    bool m_negotiating;
+    qint64 m_pendingSeek;
+
+    // TX: bytes we let pile up in the socket's write buffer, and the upload limit for this peer
+    qint64 m_windowSize;
+    qint64 m_rateLimit;
+    bool m_sentAll;
+    QTimer m_throttleTimer;
 
     int m_badded, m_bsent;
     bool m_allok; // got last msg ok, transfer complete?
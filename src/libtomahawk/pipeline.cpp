@@ -21,7 +21,11 @@
 #include <QMutexLocker>
 
 #include "functimeout.h"
+#include "collection.h"
+#include "source.h"
 #include "database/database.h"
+#include "database/databasecommand_loadresolvecache.h"
+#include "database/databasecommand_updateresolvecache.h"
 #include "resolvers/scriptresolver.h"
 #include "resolvers/qtscriptresolver.h"
 
@@ -31,6 +35,8 @@
 #define MAX_CONCURRENT_QUERIES 16
 #define CLEANUP_TIMEOUT 5 * 60 * 1000
 #define MINSCORE 0.5
+#define CACHE_FLUSH_INTERVAL 2000
+#define REFRESH_BATCH_SIZE 200
 
 using namespace Tomahawk;
 
@@ -46,15 +52,32 @@ Pipeline::instance()
 
 Pipeline::Pipeline( QObject* parent )
     : QObject( parent )
+    , m_shuntScheduled( false )
+    , m_shuntNextScheduled( false )
+    , m_cacheUpdate( 0 )
+    , m_unsolvedCount( 0 )
+    , m_unsolvedEpoch( 1 )
+    , m_refreshEpoch( 0 )
+    , m_refreshScheduled( false )
     , m_running( false )
 {
     s_instance = this;
 
+    for ( int p = PriorityPlayback; p <= PriorityBackground; p++ )
+    {
+        m_unsolvedHead[ p ] = 0;
+        m_unsolvedTail[ p ] = 0;
+    }
+
     m_maxConcurrentQueries = qBound( DEFAULT_CONCURRENT_QUERIES, QThread::idealThreadCount(), MAX_CONCURRENT_QUERIES );
     tDebug() << Q_FUNC_INFO << "Using" << m_maxConcurrentQueries << "threads";
 
     m_temporaryQueryTimer.setInterval( CLEANUP_TIMEOUT );
     connect( &m_temporaryQueryTimer, SIGNAL( timeout() ), SLOT( onTemporaryQueryTimer() ) );
+
+    m_cacheFlushTimer.setInterval( CACHE_FLUSH_INTERVAL );
+    m_cacheFlushTimer.setSingleShot( true );
+    connect( &m_cacheFlushTimer, SIGNAL( timeout() ), SLOT( flushResultCache() ) );
 }
 
 
@@ -65,14 +88,29 @@ Pipeline::~Pipeline()
     // stop script resolvers
     qDeleteAll( m_scriptResolvers );
     m_scriptResolvers.clear();
+
+    delete m_cacheUpdate;
+
+    // queries outliving us must not touch the index anymore
+    QMutexLocker lock( &m_unsolvedMut );
+    for ( int p = PriorityPlayback; p <= PriorityBackground; p++ )
+    {
+        while ( m_unsolvedHead[ p ] )
+            unlinkUnsolved( m_unsolvedHead[ p ] );
+    }
+    s_instance = 0;
 }
 
 
 void
 Pipeline::databaseReady()
 {
-    connect( Database::instance(), SIGNAL( indexReady() ), this, SLOT( start() ), Qt::QueuedConnection );
+    connect( Database::instance(), SIGNAL( indexReady() ), SLOT( scheduleUnsolvedRefresh() ), Qt::UniqueConnection );
     Database::instance()->loadIndex();
+
+    // no need to wait for the search index: other resolvers can answer meanwhile,
+    // and queries resolve again once it has been loaded
+    QMetaObject::invokeMethod( this, "start", Qt::QueuedConnection );
 }
 
 
@@ -99,6 +137,34 @@ Pipeline::removeResolver( Resolver* r )
     QMutexLocker lock( &m_mut );
 
     m_resolvers.removeAll( r );
+
+    // queries waiting for this resolver move on to the next one
+    QueryQueue waiting = m_resolverQueues.take( r );
+    while ( !waiting.isEmpty() )
+        m_shuntQueue << waiting.dequeue();
+
+    foreach ( const QID& qid, m_qidsResolver.keys( r ) )
+        m_qidsResolver.remove( qid );
+    m_resolverLoad.remove( r );
+
+    // pending queries it held up go back into line
+    QueryQueue blocked = m_blocked.take( r );
+    while ( !blocked.isEmpty() )
+    {
+        const ResolvePriority priority = (ResolvePriority)blocked.priority( blocked.head()->id() );
+        const query_ptr q = blocked.dequeue();
+        m_blockedOn.remove( q->id() );
+        m_queries_pending.enqueue( q, priority );
+    }
+    scheduleShuntNext();
+
+    if ( !m_shuntQueue.isEmpty() && !m_shuntScheduled )
+    {
+        m_shuntScheduled = true;
+        QMetaObject::invokeMethod( this, "shuntQueued", Qt::QueuedConnection );
+    }
+
+    scheduleUnsolvedRefresh();
     emit resolverRemoved( r );
 }
 
@@ -110,6 +176,8 @@ Pipeline::addResolver( Resolver* r )
 
     tDebug() << "Adding resolver" << r->name();
     m_resolvers.append( r );
+
+    scheduleUnsolvedRefresh();
     emit resolverAdded( r );
 }
 
@@ -159,6 +227,12 @@ Pipeline::removeScriptResolver( const QString& scriptPath )
 
     if ( r )
     {
+        // forget the results it found, they're not coming back
+        if ( !m_cacheUpdate )
+            m_cacheUpdate = new DatabaseCommand_UpdateResolveCache();
+        m_cacheUpdate->removeResolver( r->name() );
+        flushResultCache();
+
         r->stop();
         connect( r, SIGNAL( stopped() ), r, SLOT( deleteLater() ) );
     }
@@ -178,44 +252,160 @@ Pipeline::resolverForPath( const QString& scriptPath )
 
 
 void
-Pipeline::resolve( const QList<query_ptr>& qlist, bool prioritized, bool temporaryQuery )
+Pipeline::QueryQueue::enqueue( const query_ptr& q, ResolvePriority priority )
+{
+    if ( m_priorities.contains( q->id() ) )
+    {
+        raise( q, priority );
+        return;
+    }
+
+    m_priorities.insert( q->id(), priority );
+
+    // the latest request for something the user is looking at is the most relevant one
+    if ( priority <= PriorityVisible )
+        m_queues[ priority ].prepend( q );
+    else
+        m_queues[ priority ].append( q );
+}
+
+
+void
+Pipeline::QueryQueue::raise( const query_ptr& q, ResolvePriority priority )
+{
+    QHash< QID, int >::iterator it = m_priorities.find( q->id() );
+    if ( it == m_priorities.end() || it.value() <= priority )
+        return;
+
+    it.value() = priority;
+    if ( priority <= PriorityVisible )
+        m_queues[ priority ].prepend( q );
+    else
+        m_queues[ priority ].append( q );
+}
+
+
+query_ptr
+Pipeline::QueryQueue::head()
+{
+    for ( int p = PriorityPlayback; p <= PriorityBackground; p++ )
+    {
+        QList< query_ptr >& queue = m_queues[ p ];
+        while ( !queue.isEmpty() )
+        {
+            // drop entries which were removed or raised to a higher priority meanwhile
+            if ( m_priorities.value( queue.first()->id(), -1 ) == p )
+                return queue.first();
+
+            queue.removeFirst();
+        }
+    }
+
+    return query_ptr();
+}
+
+
+query_ptr
+Pipeline::QueryQueue::dequeue()
+{
+    query_ptr q = head();
+    if ( !q.isNull() )
+    {
+        m_queues[ m_priorities.take( q->id() ) ].removeFirst();
+    }
+
+    return q;
+}
+
+
+void
+Pipeline::resolve( const QList<query_ptr>& qlist, ResolvePriority priority, bool temporaryQuery )
 {
+    QList< query_ptr > cacheLookups;
     {
         QMutexLocker lock( &m_mut );
 
-        int i = 0;
         foreach( const query_ptr& q, qlist )
         {
             if ( q->resolvingFinished() )
                 continue;
-            if ( m_queries_pending.contains( q ) )
+
+            if ( isPending( q->id() ) || m_qidsState.contains( q->id() ) )
+            {
+                raisePriority( q, priority );
                 continue;
-            if ( m_qidsState.contains( q->id() ) )
+            }
+            if ( m_leaderOf.contains( q->id() ) )
+            {
+                raisePriority( m_qids.value( m_leaderOf.value( q->id() ) ), priority );
                 continue;
+            }
 
             if ( !m_qids.contains( q->id() ) )
                 m_qids.insert( q->id(), q );
 
-            if ( prioritized )
-                m_queries_pending.insert( i++, q );
-            else
-                m_queries_pending << q;
-
             if ( temporaryQuery )
             {
-                m_queries_temporary << q;
+                m_queries_temporary << q->id();
 
                 if ( m_temporaryQueryTimer.isActive() )
                     m_temporaryQueryTimer.stop();
                 m_temporaryQueryTimer.start();
             }
+
+            // Is an identical query already being resolved? Then just wait for its results
+            const QString key = queryKey( q );
+            if ( !key.isEmpty() )
+            {
+                const QID leader = m_leaders.value( key );
+                if ( !leader.isEmpty() && m_qids.contains( leader ) )
+                {
+                    m_followers[ leader ] << q;
+                    m_leaderOf.insert( q->id(), leader );
+                    raisePriority( m_qids.value( leader ), priority );
+                    continue;
+                }
+
+                m_leaders.insert( key, q->id() );
+
+                if ( !q->isFullTextQuery() )
+                    cacheLookups << q;
+            }
+
+            m_queries_pending.enqueue( q, priority );
         }
     }
 
+    if ( !cacheLookups.isEmpty() )
+        loadCachedResults( cacheLookups );
+
     shuntNext();
 }
 
 
+void
+Pipeline::resolve( const query_ptr& q, ResolvePriority priority, bool temporaryQuery )
+{
+    if ( q.isNull() )
+        return;
+
+    QList< query_ptr > qlist;
+    qlist << q;
+    resolve( qlist, priority, temporaryQuery );
+}
+
+
+void
+Pipeline::resolve( const QList<query_ptr>& qlist, bool prioritized, bool temporaryQuery )
+{
+    ResolvePriority priority = prioritized ? PriorityVisible : PriorityBackground;
+    if ( temporaryQuery )
+        priority = PriorityTemporary;
+
+    resolve( qlist, priority, temporaryQuery );
+}
+
+
 void
 Pipeline::resolve( const query_ptr& q, bool prioritized, bool temporaryQuery )
 {
@@ -235,6 +425,44 @@ Pipeline::resolve( QID qid, bool prioritized, bool temporaryQuery )
 }
 
 
+QString
+Pipeline::queryKey( const Tomahawk::query_ptr& query ) const
+{
+    // a result hint asks for a specific file, don't mix those up
+    if ( !query->resultHint().isEmpty() )
+        return QString();
+
+    if ( query->isFullTextQuery() )
+        return QString( "\t\t\t%1" ).arg( query->albumSortname() );
+
+    return QString( "%1\t%2\t%3" ).arg( query->artistSortname() )
+                                  .arg( query->trackSortname() )
+                                  .arg( query->albumSortname() );
+}
+
+
+void
+Pipeline::raisePriority( const Tomahawk::query_ptr& query, ResolvePriority priority )
+{
+    if ( query.isNull() )
+        return;
+
+    m_queries_pending.raise( query, priority );
+    if ( m_blockedOn.contains( query->id() ) )
+        m_blocked[ m_blockedOn.value( query->id() ) ].raise( query, priority );
+
+    QHash< QID, ResolvePriority >::iterator it = m_qidsPriority.find( query->id() );
+    if ( it != m_qidsPriority.end() && it.value() > priority )
+    {
+        it.value() = priority;
+
+        QHash< Resolver*, QueryQueue >::iterator qit = m_resolverQueues.begin();
+        for ( ; qit != m_resolverQueues.end(); ++qit )
+            qit.value().raise( query, priority );
+    }
+}
+
+
 void
 Pipeline::reportResults( QID qid, const QList< result_ptr >& results )
 {
@@ -251,7 +479,7 @@ Pipeline::reportResults( QID qid, const QList< result_ptr >& results )
     QList< result_ptr > cleanResults;
     foreach( const result_ptr& r, results )
     {
-        float score = q->howSimilar( r );
+        float score = q->howSimilar( r, q->isFullTextQuery() ? 0.0 : MINSCORE );
         r->setScore( score );
         if ( !q->isFullTextQuery() && score < MINSCORE )
             continue;
@@ -261,10 +489,37 @@ Pipeline::reportResults( QID qid, const QList< result_ptr >& results )
 
     if ( !cleanResults.isEmpty() )
     {
-        q->addResults( cleanResults );
+        cacheResults( q, cleanResults );
+
+        {
+            QMutexLocker lock( &m_mut );
+            QHash< QID, QHash< RID, QString > >::iterator it = m_unconfirmed.find( qid );
+            if ( it != m_unconfirmed.end() )
+            {
+                foreach( const result_ptr& r, cleanResults )
+                    it.value().remove( r->id() );
+            }
+        }
+
+        // results we already got from the resolve cache are merely confirmed
+        QList< result_ptr > newResults;
+        const QList< result_ptr > knownResults = q->results();
         foreach( const result_ptr& r, cleanResults )
         {
-            m_rids.insert( r->id(), r );
+            if ( !knownResults.contains( r ) )
+                newResults << r;
+        }
+
+        if ( !newResults.isEmpty() )
+        {
+            q->addResults( newResults );
+            foreach( const query_ptr& follower, m_followers.value( qid ) )
+                follower->addResults( newResults );
+
+            foreach( const result_ptr& r, newResults )
+            {
+                m_rids.insert( r->id(), r );
+            }
         }
 
         if ( q->playable() && !q->isFullTextQuery() )
@@ -279,37 +534,294 @@ Pipeline::reportResults( QID qid, const QList< result_ptr >& results )
 
 
 void
-Pipeline::shuntNext()
+Pipeline::loadCachedResults( const QList< query_ptr >& queries )
 {
-    if ( !m_running )
+    if ( !Database::instance() )
         return;
 
-    unsigned int rc;
+    DatabaseCommand_LoadResolveCache* cmd = new DatabaseCommand_LoadResolveCache( queries );
+    connect( cmd, SIGNAL( results( Tomahawk::QID, QString, QList< Tomahawk::result_ptr > ) ),
+                    SLOT( onCachedResults( Tomahawk::QID, QString, QList< Tomahawk::result_ptr > ) ), Qt::QueuedConnection );
+
+    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
+}
+
+
+void
+Pipeline::onCachedResults( const QID& qid, const QString& resolver, const QList< result_ptr >& results )
+{
     query_ptr q;
+    QList< query_ptr > followers;
+    QList< result_ptr > newResults;
     {
         QMutexLocker lock( &m_mut );
 
-        rc = m_resolvers.count();
-        if ( m_queries_pending.isEmpty() )
-        {
-            if ( m_qidsState.isEmpty() )
-                emit idle();
+        // the resolvers beat us to it, don't bring back results they didn't confirm
+        if ( !isPending( qid ) && !m_qidsState.contains( qid ) )
             return;
-        }
 
-        // Check if we are ready to dispatch more queries
-        if ( m_qidsState.count() >= m_maxConcurrentQueries )
+        q = m_qids.value( qid );
+        if ( q.isNull() )
             return;
+        followers = m_followers.value( qid );
+
+        // Make the query playable right away, it keeps on resolving in the background to revalidate them
+        const QList< result_ptr > knownResults = q->results();
+        foreach( const result_ptr& r, results )
+        {
+            if ( knownResults.contains( r ) )
+                continue;
+
+            newResults << r;
+            m_rids.insert( r->id(), r );
+            m_unconfirmed[ qid ].insert( r->id(), resolver );
+        }
+    }
+
+    if ( newResults.isEmpty() )
+        return;
+
+    q->addResults( newResults );
+    foreach( const query_ptr& follower, followers )
+        follower->addResults( newResults );
+}
+
+
+void
+Pipeline::cacheResults( const query_ptr& query, const QList< result_ptr >& results )
+{
+    Resolver* r = query->currentResolver();
+    if ( !r || !r->resultCacheTtl() || !Database::instance() )
+        return;
+
+    // a result hint or full text search doesn't tell us which track it was for
+    if ( query->isFullTextQuery() || !query->resultHint().isEmpty() )
+        return;
+
+    // our own files are found in the database quickly enough
+    QList< result_ptr > cacheable;
+    foreach( const result_ptr& result, results )
+    {
+        if ( result->collection().isNull() || !result->collection()->source()->isLocal() )
+            cacheable << result;
+    }
+
+    if ( cacheable.isEmpty() )
+        return;
+
+    if ( !m_cacheUpdate )
+        m_cacheUpdate = new DatabaseCommand_UpdateResolveCache();
+    m_cacheUpdate->addResults( query, r->name(), r->resultCacheTtl(), cacheable );
+
+    if ( !m_cacheFlushTimer.isActive() )
+        m_cacheFlushTimer.start();
+}
+
+
+QList< result_ptr >
+Pipeline::dropUnconfirmedResults( const query_ptr& query )
+{
+    QList< result_ptr > dropped;
+    const QHash< RID, QString > unconfirmed = m_unconfirmed.take( query->id() );
+    if ( unconfirmed.isEmpty() )
+        return dropped;
+
+    // only the resolvers which got to revalidate can tell a cached result is gone
+    QSet< QString > asked;
+    foreach ( const QWeakPointer< Resolver >& r, query->resolvedBy() )
+    {
+        if ( !r.isNull() )
+            asked << r.data()->name();
+    }
+
+    QHash< RID, QString >::const_iterator it = unconfirmed.constBegin();
+    for ( ; it != unconfirmed.constEnd(); ++it )
+    {
+        if ( !asked.contains( it.value() ) )
+            continue;
+
+        const result_ptr r = m_rids.take( it.key() );
+        if ( r.isNull() )
+            continue;
+
+        tDebug( LOGVERBOSE ) << "Dropping cached result which wasn't found again:" << r->url() << query->toString();
+        dropped << r;
+
+        if ( !m_cacheUpdate )
+            m_cacheUpdate = new DatabaseCommand_UpdateResolveCache();
+        m_cacheUpdate->removeResult( query, it.value(), r );
+    }
+
+    if ( m_cacheUpdate && !m_cacheFlushTimer.isActive() )
+        m_cacheFlushTimer.start();
+
+    return dropped;
+}
+
+
+void
+Pipeline::flushResultCache()
+{
+    m_cacheFlushTimer.stop();
+    if ( !m_cacheUpdate || !Database::instance() )
+        return;
+
+    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( m_cacheUpdate ) );
+    m_cacheUpdate = 0;
+}
+
+
+unsigned int
+Pipeline::resolverBudget( Resolver* r ) const
+{
+    const unsigned int budget = r->maxConcurrentQueries();
+    return budget > 0 ? budget : m_maxConcurrentQueries;
+}
+
+
+bool
+Pipeline::acquireResolver( const Tomahawk::query_ptr& query, Resolver* r )
+{
+    if ( m_qidsResolver.value( query->id() ) == r )
+        return true;
+
+    releaseResolver( query->id() );
+    if ( m_resolverLoad.value( r ) >= resolverBudget( r ) )
+        return false;
+
+    m_resolverLoad[ r ]++;
+    m_qidsResolver.insert( query->id(), r );
+    return true;
+}
+
+
+void
+Pipeline::releaseResolver( const QID& qid )
+{
+    Resolver* r = m_qidsResolver.take( qid );
+    if ( !r )
+        return;
+
+    m_resolverLoad[ r ]--;
+
+    // hand the free slot to the most important query waiting for this resolver
+    QHash< Resolver*, QueryQueue >::iterator it = m_resolverQueues.find( r );
+    if ( it != m_resolverQueues.end() && !it.value().isEmpty() )
+    {
+        query_ptr q = it.value().dequeue();
+        m_resolverLoad[ r ]++;
+        m_qidsResolver.insert( q->id(), r );
+        scheduleShunt( q );
+    }
+    else
+    {
+        // nobody is waiting mid-resolve, let a pending query it held up back in line
+        it = m_blocked.find( r );
+        if ( it != m_blocked.end() && !it.value().isEmpty() )
+        {
+            const ResolvePriority priority = (ResolvePriority)it.value().priority( it.value().head()->id() );
+            const query_ptr q = it.value().dequeue();
+            m_blockedOn.remove( q->id() );
+            m_queries_pending.enqueue( q, priority );
+        }
+    }
+
+    // a slot is free, whatever its resolver does with it
+    scheduleShuntNext();
+}
+
+
+void
+Pipeline::scheduleShunt( const Tomahawk::query_ptr& query )
+{
+    m_shuntQueue << query;
+
+    if ( !m_shuntScheduled )
+    {
+        m_shuntScheduled = true;
+        QMetaObject::invokeMethod( this, "shuntQueued", Qt::QueuedConnection );
+    }
+}
+
+
+void
+Pipeline::scheduleShuntNext()
+{
+    if ( !m_shuntNextScheduled )
+    {
+        m_shuntNextScheduled = true;
+        QMetaObject::invokeMethod( this, "shuntNext", Qt::QueuedConnection );
+    }
+}
+
 
-        /*
-            Since resolvers are async, we now dispatch to the highest weighted ones
-            and after timeout, dispatch to next highest etc, aborting when solved
-        */
-        q = m_queries_pending.takeFirst();
-        q->setCurrentResolver( 0 );
+void
+Pipeline::shuntQueued()
+{
+    QList< query_ptr > queue;
+    {
+        QMutexLocker lock( &m_mut );
+        queue = m_shuntQueue;
+        m_shuntQueue.clear();
+        m_shuntScheduled = false;
     }
 
-    setQIDState( q, rc );
+    foreach ( const query_ptr& q, queue )
+        shunt( q );
+
+    shuntNext();
+}
+
+
+void
+Pipeline::shuntNext()
+{
+    if ( !m_running )
+        return;
+
+    // Dispatch as many queries as the resolvers' budgets allow at once, so
+    // resolvers like the DatabaseResolver get to resolve them in batches
+    forever
+    {
+        unsigned int rc;
+        query_ptr q;
+        {
+            QMutexLocker lock( &m_mut );
+            m_shuntNextScheduled = false;
+
+            rc = m_resolvers.count();
+            if ( m_queries_pending.isEmpty() )
+            {
+                if ( m_qidsState.isEmpty() && m_blockedOn.isEmpty() )
+                    emit idle();
+                return;
+            }
+
+            q = m_queries_pending.head();
+            ResolvePriority priority = (ResolvePriority)m_queries_pending.priority( q->id() );
+            m_queries_pending.dequeue();
+
+            // Check if the resolver the next query goes to first has got room for it.
+            // If not, set it aside until that resolver frees a slot and go on with the
+            // next one, queries for other resolvers needn't wait for it.
+            Resolver* r = nextResolver( q );
+            if ( r && !acquireResolver( q, r ) )
+            {
+                m_blocked[ r ].enqueue( q, priority );
+                m_blockedOn.insert( q->id(), r );
+                continue;
+            }
+
+            /*
+                Since resolvers are async, we now dispatch to the highest weighted ones
+                and after timeout, dispatch to next highest etc, aborting when solved
+            */
+            m_qidsPriority.insert( q->id(), priority );
+            q->setCurrentResolver( 0 );
+        }
+
+        setQIDState( q, rc );
+    }
 }
 
 
@@ -339,6 +851,19 @@ Pipeline::shunt( const query_ptr& q )
 
     if ( r )
     {
+        {
+            QMutexLocker lock( &m_mut );
+            if ( !m_qidsState.contains( q->id() ) )
+                return;
+
+            if ( !acquireResolver( q, r ) )
+            {
+                // wait for this resolver to finish with some other query
+                m_resolverQueues[ r ].enqueue( q, m_qidsPriority.value( q->id(), PriorityBackground ) );
+                return;
+            }
+        }
+
         tLog( LOGVERBOSE ) << "Dispatching to resolver" << r->name() << q->toString() << q->solved() << q->id();
 
         q->setCurrentResolver( r );
@@ -354,10 +879,7 @@ Pipeline::shunt( const query_ptr& q )
     {
         // we get here if we disable a resolver while a query is resolving
         setQIDState( q, 0 );
-        return;
     }
-
-    shuntNext();
 }
 
 
@@ -388,26 +910,67 @@ Pipeline::nextResolver( const Tomahawk::query_ptr& query ) const
 void
 Pipeline::setQIDState( const Tomahawk::query_ptr& query, int state )
 {
-    QMutexLocker lock( &m_mut );
+    ResolvePriority priority;
+    QList< query_ptr > finished;
+    QList< result_ptr > dropped;
+    {
+        QMutexLocker lock( &m_mut );
 
-    if ( m_qidsTimeout.contains( query->id() ) )
-        m_qidsTimeout.remove( query->id() );
+        if ( m_qidsTimeout.contains( query->id() ) )
+            m_qidsTimeout.remove( query->id() );
 
-    if ( state > 0 )
-    {
-        m_qidsState.insert( query->id(), state );
+        if ( state > 0 )
+        {
+            m_qidsState.insert( query->id(), state );
 
-        new FuncTimeout( 0, boost::bind( &Pipeline::shunt, this, query ), this );
-    }
-    else
-    {
+            scheduleShunt( query );
+            return;
+        }
+
+        priority = m_qidsPriority.value( query->id(), PriorityBackground );
         m_qidsState.remove( query->id() );
-        query->onResolvingFinished();
+        m_qidsPriority.remove( query->id() );
+
+        QHash< Resolver*, QueryQueue >::iterator it = m_resolverQueues.begin();
+        for ( ; it != m_resolverQueues.end(); ++it )
+            it.value().remove( query->id() );
+        releaseResolver( query->id() );
+
+        const QString key = queryKey( query );
+        if ( m_leaders.value( key ) == query->id() )
+            m_leaders.remove( key );
+
+        // revalidation is over, cached results nobody found again are gone
+        dropped = dropUnconfirmedResults( query );
 
-        if ( !m_queries_temporary.contains( query ) )
-            m_qids.remove( query->id() );
+        finished << query;
+        foreach ( const query_ptr& follower, m_followers.take( query->id() ) )
+        {
+            m_leaderOf.remove( follower->id() );
+            finished << follower;
+        }
+
+        foreach ( const query_ptr& q, finished )
+        {
+            if ( !m_queries_temporary.contains( q->id() ) )
+                m_qids.remove( q->id() );
+        }
 
-        new FuncTimeout( 0, boost::bind( &Pipeline::shuntNext, this ), this );
+        scheduleShuntNext();
+    }
+
+    // the queries emit signals from here on, whoever handles them directly may call back into us
+    foreach ( const query_ptr& q, finished )
+    {
+        foreach ( const result_ptr& r, dropped )
+            q->removeResult( r );
+
+        q->onResolvingFinished();
+        if ( !q->solved() )
+        {
+            QMutexLocker unsolvedLock( &m_unsolvedMut );
+            linkUnsolved( q.data(), priority );
+        }
     }
 }
 
@@ -453,9 +1016,140 @@ Pipeline::onTemporaryQueryTimer()
     tDebug() << Q_FUNC_INFO;
     m_temporaryQueryTimer.stop();
 
-    for ( int i = m_queries_temporary.count() - 1; i >= 0; i-- )
+    foreach ( const QID& qid, m_queries_temporary )
     {
-        query_ptr q = m_queries_temporary.takeAt( i );
-        m_qids.remove( q->id() );
+        // still being resolved, setQIDState() takes care of it once done
+        if ( !m_qidsState.contains( qid ) && !m_leaderOf.contains( qid ) )
+            m_qids.remove( qid );
     }
+    m_queries_temporary.clear();
+}
+
+
+void
+Pipeline::linkUnsolved( Tomahawk::Query* query, ResolvePriority priority )
+{
+    if ( query->m_unsolvedPriority >= 0 )
+        unlinkUnsolved( query );
+
+    query->m_unsolvedPriority = priority;
+    query->m_unsolvedEpoch = m_unsolvedEpoch;
+    query->m_unsolvedPrev = m_unsolvedTail[ priority ];
+    query->m_unsolvedNext = 0;
+
+    if ( m_unsolvedTail[ priority ] )
+        m_unsolvedTail[ priority ]->m_unsolvedNext = query;
+    else
+        m_unsolvedHead[ priority ] = query;
+    m_unsolvedTail[ priority ] = query;
+
+    m_unsolvedCount++;
+}
+
+
+void
+Pipeline::unlinkUnsolved( Tomahawk::Query* query )
+{
+    const int priority = query->m_unsolvedPriority;
+    if ( priority < 0 )
+        return;
+
+    if ( query->m_unsolvedPrev )
+        query->m_unsolvedPrev->m_unsolvedNext = query->m_unsolvedNext;
+    else
+        m_unsolvedHead[ priority ] = query->m_unsolvedNext;
+
+    if ( query->m_unsolvedNext )
+        query->m_unsolvedNext->m_unsolvedPrev = query->m_unsolvedPrev;
+    else
+        m_unsolvedTail[ priority ] = query->m_unsolvedPrev;
+
+    query->m_unsolvedPrev = 0;
+    query->m_unsolvedNext = 0;
+    query->m_unsolvedPriority = -1;
+
+    m_unsolvedCount--;
+}
+
+
+void
+Pipeline::removeUnsolved( Tomahawk::Query* query )
+{
+    QMutexLocker lock( &m_unsolvedMut );
+    unlinkUnsolved( query );
+}
+
+
+void
+Pipeline::scheduleUnsolvedRefresh()
+{
+    QMutexLocker lock( &m_unsolvedMut );
+
+    // everything that is unsolved right now is due, queries failing after this get the next refresh
+    m_refreshEpoch = m_unsolvedEpoch++;
+
+    if ( !m_refreshScheduled )
+    {
+        m_refreshScheduled = true;
+        QMetaObject::invokeMethod( this, "refreshUnsolved", Qt::QueuedConnection );
+    }
+}
+
+
+void
+Pipeline::refreshUnsolved()
+{
+    QList< query_ptr > batches[ PriorityBackground + 1 ];
+    bool more = false;
+    {
+        QMutexLocker lock( &m_unsolvedMut );
+
+        // most important queries first, and only a batch per event loop iteration
+        int taken = 0;
+        for ( int p = PriorityPlayback; p <= PriorityBackground && taken < REFRESH_BATCH_SIZE; p++ )
+        {
+            while ( taken < REFRESH_BATCH_SIZE && m_unsolvedHead[ p ] && m_unsolvedHead[ p ]->m_unsolvedEpoch <= m_refreshEpoch )
+            {
+                Query* query = m_unsolvedHead[ p ];
+                unlinkUnsolved( query );
+
+                // null if the query is being destroyed right now
+                const query_ptr q = Query::registered( query->id() );
+                if ( q.isNull() )
+                    continue;
+
+                batches[ p ] << q;
+                taken++;
+            }
+        }
+
+        for ( int p = PriorityPlayback; p <= PriorityBackground && !more; p++ )
+            more = m_unsolvedHead[ p ] && m_unsolvedHead[ p ]->m_unsolvedEpoch <= m_refreshEpoch;
+
+        m_refreshScheduled = more;
+    }
+
+    for ( int p = PriorityPlayback; p <= PriorityBackground; p++ )
+    {
+        if ( batches[ p ].isEmpty() )
+            continue;
+
+        QList< query_ptr > qlist;
+        foreach ( const query_ptr& q, batches[ p ] )
+        {
+            if ( q->solved() )
+                continue;
+
+            q->setResolveFinished( false );
+            qlist << q;
+        }
+        if ( qlist.isEmpty() )
+            continue;
+
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Resolving" << qlist.count() << "unsolved queries again with priority" << p;
+        resolve( qlist, (ResolvePriority)p );
+    }
+
+    if ( more )
+        QMetaObject::invokeMethod( this, "refreshUnsolved", Qt::QueuedConnection );
 }
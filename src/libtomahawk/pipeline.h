@@ -22,6 +22,8 @@
 #include <QObject>
 #include <QList>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QMutex>
 #include <QTimer>
 
@@ -30,6 +32,8 @@
 
 #include "dllmacro.h"
 
+class DatabaseCommand_UpdateResolveCache;
+
 namespace Tomahawk
 {
 class Resolver;
@@ -40,12 +44,21 @@ class DLLEXPORT Pipeline : public QObject
 Q_OBJECT
 
 public:
+    /// Queries waiting to be resolved are dispatched in this order
+    enum ResolvePriority
+    {
+        PriorityPlayback = 0, // the track that is (about to be) played
+        PriorityVisible,      // tracks shown in a view
+        PriorityTemporary,    // short-lived queries, e.g. searches
+        PriorityBackground    // bulk resolving, e.g. whole playlists
+    };
+
     static Pipeline* instance();
 
     explicit Pipeline( QObject* parent = 0 );
     virtual ~Pipeline();
 
-    unsigned int pendingQueryCount() const { return m_queries_pending.count(); }
+    unsigned int pendingQueryCount() const { return m_queries_pending.count() + m_blockedOn.count(); }
     unsigned int activeQueryCount() const { return m_qidsState.count(); }
 
     void reportResults( QID qid, const QList< result_ptr >& results );
@@ -69,6 +82,14 @@ public:
         return m_rids.value( rid );
     }
 
+    void resolve( const query_ptr& q, ResolvePriority priority, bool temporaryQuery = false );
+    void resolve( const QList<query_ptr>& qlist, ResolvePriority priority, bool temporaryQuery = false );
+
+    /// Number of finished but unsolved queries, which get resolved again when resolvers change
+    unsigned int unsolvedQueryCount() const { return m_unsolvedCount; }
+    /// Drops a query from the unsolved index, e.g. because it got solved or is being destroyed
+    void removeUnsolved( Tomahawk::Query* query );
+
 public slots:
     void resolve( const query_ptr& q, bool prioritized = true, bool temporaryQuery = false );
     void resolve( const QList<query_ptr>& qlist, bool prioritized = true, bool temporaryQuery = false );
@@ -89,16 +110,69 @@ private slots:
     void timeoutShunt( const query_ptr& q );
     void shunt( const query_ptr& q );
     void shuntNext();
+    void shuntQueued();
 
     void onTemporaryQueryTimer();
 
+    void scheduleUnsolvedRefresh();
+    void refreshUnsolved();
+
+    void onCachedResults( const Tomahawk::QID& qid, const QString& resolver, const QList< Tomahawk::result_ptr >& results );
+    void flushResultCache();
+
 private:
+    /*
+        Queries ordered by ResolvePriority, FIFO within a priority class.
+        Membership tests are O(1); raising the priority of a queued query leaves
+        a stale entry in the lower class behind, which gets skipped when dequeueing.
+    */
+    class QueryQueue
+    {
+    public:
+        void enqueue( const query_ptr& q, ResolvePriority priority );
+        void raise( const query_ptr& q, ResolvePriority priority );
+        query_ptr head();
+        query_ptr dequeue();
+        void remove( const QID& qid ) { m_priorities.remove( qid ); }
+
+        int priority( const QID& qid ) const { return m_priorities.value( qid, PriorityBackground ); }
+        bool contains( const QID& qid ) const { return m_priorities.contains( qid ); }
+        bool isEmpty() const { return m_priorities.isEmpty(); }
+        int count() const { return m_priorities.count(); }
+
+    private:
+        QList< query_ptr > m_queues[ PriorityBackground + 1 ];
+        QHash< QID, int > m_priorities;
+    };
+
     Tomahawk::Resolver* nextResolver( const Tomahawk::query_ptr& query ) const;
 
     void setQIDState( const Tomahawk::query_ptr& query, int state );
     int incQIDState( const Tomahawk::query_ptr& query );
     int decQIDState( const Tomahawk::query_ptr& query );
 
+    QString queryKey( const Tomahawk::query_ptr& query ) const;
+    void raisePriority( const Tomahawk::query_ptr& query, ResolvePriority priority );
+
+    // per-resolver concurrency budgets, call with m_mut locked
+    unsigned int resolverBudget( Resolver* r ) const;
+    bool acquireResolver( const Tomahawk::query_ptr& query, Resolver* r );
+    void releaseResolver( const QID& qid );
+    bool isPending( const QID& qid ) const { return m_queries_pending.contains( qid ) || m_blockedOn.contains( qid ); }
+
+    void scheduleShunt( const Tomahawk::query_ptr& query );
+    void scheduleShuntNext();
+
+    // intrusive index of unsolved queries, call with m_unsolvedMut locked
+    void linkUnsolved( Tomahawk::Query* query, ResolvePriority priority );
+    void unlinkUnsolved( Tomahawk::Query* query );
+
+    void loadCachedResults( const QList< Tomahawk::query_ptr >& queries );
+    void cacheResults( const Tomahawk::query_ptr& query, const QList< Tomahawk::result_ptr >& results );
+    // call with m_mut locked. Returns the results to remove from the query and
+    // its followers, which is up to the caller once it's unlocked again.
+    QList< Tomahawk::result_ptr > dropUnconfirmedResults( const Tomahawk::query_ptr& query );
+
     QList< Resolver* > m_resolvers;
     QList< Tomahawk::ExternalResolver* > m_scriptResolvers;
 
@@ -110,11 +184,56 @@ private:
     QMutex m_mut; // for m_qids, m_rids
 
     // store queries here until DB index is loaded, then shunt them all
-    QList< query_ptr > m_queries_pending;
+    QueryQueue m_queries_pending;
     // store temporary queries here and clean up after timeout threshold
-    QList< query_ptr > m_queries_temporary;
-
-    int m_maxConcurrentQueries;
+    QSet< QID > m_queries_temporary;
+    // priority of queries being resolved
+    QHash< QID, ResolvePriority > m_qidsPriority;
+
+    // identical artist/track/album queries are only resolved once:
+    // key -> the query being resolved, which passes its results on to the others
+    QHash< QString, QID > m_leaders;
+    QHash< QID, QList< query_ptr > > m_followers;
+    QHash< QID, QID > m_leaderOf;
+
+    // in-flight queries per resolver, and the queries waiting for a resolver's budget
+    QHash< Resolver*, unsigned int > m_resolverLoad;
+    QHash< Resolver*, QueryQueue > m_resolverQueues;
+    QHash< QID, Resolver* > m_qidsResolver;
+
+    // pending queries set aside because the resolver they go to first is busy,
+    // so they don't hold up the ones behind them. Still count as pending.
+    QHash< Resolver*, QueryQueue > m_blocked;
+    QHash< QID, Resolver* > m_blockedOn;
+
+    // queries to be shunted on the next event loop iteration
+    QList< query_ptr > m_shuntQueue;
+    bool m_shuntScheduled;
+    bool m_shuntNextScheduled;
+
+    // cached results no resolver found again yet: query -> result -> name of the resolver which had found it
+    QHash< QID, QHash< RID, QString > > m_unconfirmed;
+
+    // results waiting to be written to the resolve cache
+    DatabaseCommand_UpdateResolveCache* m_cacheUpdate;
+    QTimer m_cacheFlushTimer;
+
+    /*
+        Queries which finished resolving without a perfect result, one list per
+        ResolvePriority. The list links live in the Query objects themselves, so
+        resolver changes don't need a signal connection per query. Lists are
+        ordered by the epoch a query was linked in, so a refresh only walks the
+        queries which were unsolved when it got triggered.
+    */
+    Tomahawk::Query* m_unsolvedHead[ PriorityBackground + 1 ];
+    Tomahawk::Query* m_unsolvedTail[ PriorityBackground + 1 ];
+    unsigned int m_unsolvedCount;
+    unsigned int m_unsolvedEpoch;
+    unsigned int m_refreshEpoch;
+    bool m_refreshScheduled;
+    QMutex m_unsolvedMut;
+
+    unsigned int m_maxConcurrentQueries;
     bool m_running;
     QTimer m_temporaryQueryTimer;
 
@@ -474,7 +474,7 @@ Playlist::resolve()
         qlist << p->query();
     }
 
-    Pipeline::instance()->resolve( qlist );
+    Pipeline::instance()->resolve( qlist, Pipeline::PriorityBackground );
 }
 
 
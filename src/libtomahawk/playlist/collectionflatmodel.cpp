@@ -18,27 +18,247 @@
 
 #include "collectionflatmodel.h"
 
+#include <QDateTime>
 #include <QMimeData>
 #include <QTreeView>
 
+#include "audio/audioengine.h"
+#include "artist.h"
+#include "album.h"
 #include "database/database.h"
 #include "sourcelist.h"
+#include "utils/tomahawkutils.h"
 #include "utils/logger.h"
 
+#define PAGE_SIZE 250
+#define MAX_PAGES 16
+#define PREFETCH_PAGES 1
+
 using namespace Tomahawk;
 
 
 CollectionFlatModel::CollectionFlatModel( QObject* parent )
     : TrackModel( parent )
+    , m_recent( 0 )
+    , m_sortColumn( DatabaseCommand_TrackPage::Artist )
+    , m_sortDescending( false )
+    , m_generation( 0 )
+    , m_total( 0 )
+    , m_loadingItem( new TrackModelItem( Query::get( QString(), QString(), QString() ), 0 ) )
 {
     qDebug() << Q_FUNC_INFO;
 
+    m_loadingItem->model = this;
+
+    // collections change in bursts while scanning, only reload once things calm down
+    m_refreshTimer.setSingleShot( true );
+    m_refreshTimer.setInterval( 500 );
+    connect( &m_refreshTimer, SIGNAL( timeout() ), SLOT( refresh() ) );
+
     connect( SourceList::instance(), SIGNAL( sourceRemoved( Tomahawk::source_ptr ) ), SLOT( onSourceOffline( Tomahawk::source_ptr ) ) );
 }
 
 
 CollectionFlatModel::~CollectionFlatModel()
 {
+    clearPages();
+    delete m_loadingItem;
+}
+
+
+QModelIndex
+CollectionFlatModel::index( int row, int column, const QModelIndex& parent ) const
+{
+    if ( parent.isValid() || row < 0 || column < 0 || row >= m_total )
+        return QModelIndex();
+
+    // rows are addressed by their number alone, items come and go with their page
+    return createIndex( row, column );
+}
+
+
+QModelIndex
+CollectionFlatModel::parent( const QModelIndex& child ) const
+{
+    Q_UNUSED( child );
+    return QModelIndex();
+}
+
+
+int
+CollectionFlatModel::rowCount( const QModelIndex& parent ) const
+{
+    if ( parent.isValid() )
+        return 0;
+
+    return m_total;
+}
+
+
+QVariant
+CollectionFlatModel::data( const QModelIndex& index, int role ) const
+{
+    if ( !index.isValid() )
+        return QVariant();
+
+    if ( role == Qt::SizeHintRole )
+        return QSize( 0, 18 );
+
+    if ( role == StyleRole )
+        return style();
+
+    if ( role != Qt::DisplayRole )
+        return QVariant();
+
+    const int row = index.row();
+    if ( m_items.contains( row ) )
+        return TrackModel::data( index, role );
+
+    // answer straight from the page, without building a query for the row
+    QHash< int, TrackPage >::const_iterator it = m_pages.constFind( row / PAGE_SIZE );
+    if ( it == m_pages.constEnd() )
+    {
+        requestPage( row / PAGE_SIZE );
+        return QVariant();
+    }
+    touchPage( it.key() );
+
+    const TrackPage& page = it.value();
+    const int i = row - page.offset;
+    if ( i >= page.count() )
+        return QVariant();
+
+    switch( index.column() )
+    {
+        case Artist:
+            return page.artists.at( i );
+
+        case Track:
+            return page.tracks.at( i );
+
+        case Album:
+            return page.albums.at( i );
+
+        case AlbumPos:
+            if ( page.albumpos.at( i ) == 0 )
+                return QString();
+            return QString::number( page.albumpos.at( i ) );
+
+        case Duration:
+            return TomahawkUtils::timeToString( page.durations.at( i ) );
+
+        case Bitrate:
+            if ( page.bitrates.at( i ) == 0 )
+                return QString();
+            return page.bitrates.at( i );
+
+        case Age:
+            return TomahawkUtils::ageToString( QDateTime::fromTime_t( page.mtimes.at( i ) ) );
+
+        case Year:
+            if ( page.years.at( i ) == 0 )
+                return QString();
+            return page.years.at( i );
+
+        case Filesize:
+            return TomahawkUtils::filesizeToString( page.sizes.at( i ) );
+
+        case Origin:
+        {
+            source_ptr s = page.sourceIds.at( i ) == 0 ? SourceList::instance()->getLocal()
+                                                        : SourceList::instance()->get( page.sourceIds.at( i ) );
+            return s.isNull() ? QString() : s->friendlyName();
+        }
+
+        case Score:
+            return 1.0;
+    }
+
+    return QVariant();
+}
+
+
+TrackModelItem*
+CollectionFlatModel::itemFromIndex( const QModelIndex& index ) const
+{
+    if ( !index.isValid() )
+        return m_rootItem;
+
+    const int row = index.row();
+    TrackModelItem* item = m_items.value( row );
+    if ( item )
+        return item;
+
+    if ( !m_pages.contains( row / PAGE_SIZE ) )
+    {
+        requestPage( row / PAGE_SIZE );
+        return m_loadingItem;
+    }
+
+    return createItem( row );
+}
+
+
+TrackModelItem*
+CollectionFlatModel::createItem( int row ) const
+{
+    const int pageNumber = row / PAGE_SIZE;
+    touchPage( pageNumber );
+
+    const TrackPage& page = m_pages.constFind( pageNumber ).value();
+    const int i = row - page.offset;
+    if ( i >= page.count() )
+        return m_loadingItem;
+
+    source_ptr s;
+    QString url = page.urls.at( i );
+    if ( page.sourceIds.at( i ) == 0 )
+    {
+        s = SourceList::instance()->getLocal();
+    }
+    else
+    {
+        s = SourceList::instance()->get( page.sourceIds.at( i ) );
+        if ( s.isNull() )
+            return m_loadingItem;
+
+        url = QString( "servent://%1\t%2" ).arg( s->userName() ).arg( url );
+    }
+
+    Tomahawk::result_ptr result = Tomahawk::Result::get( url );
+    Tomahawk::query_ptr query = Tomahawk::Query::get( page.artists.at( i ), page.tracks.at( i ), page.albums.at( i ) );
+    Tomahawk::artist_ptr artistptr = Tomahawk::Artist::get( page.artistIds.at( i ), page.artists.at( i ) );
+    Tomahawk::album_ptr albumptr = Tomahawk::Album::get( page.albumIds.at( i ), page.albums.at( i ), artistptr );
+
+    result->setTrackId( page.trackIds.at( i ) );
+    result->setArtist( artistptr );
+    result->setAlbum( albumptr );
+    result->setTrack( page.tracks.at( i ) );
+    result->setSize( page.sizes.at( i ) );
+    result->setDuration( page.durations.at( i ) );
+    result->setBitrate( page.bitrates.at( i ) );
+    result->setModificationTime( page.mtimes.at( i ) );
+    result->setMimetype( page.mimetypes.at( i ) );
+    result->setAlbumPos( page.albumpos.at( i ) );
+    result->setYear( page.years.at( i ) );
+    result->setScore( 1.0 );
+    result->setCollection( s->collection() );
+
+    QList<Tomahawk::result_ptr> results;
+    results << result;
+    query->addResults( results );
+    query->setResolveFinished( true );
+
+    TrackModelItem* item = new TrackModelItem( query, 0 );
+    item->model = const_cast< CollectionFlatModel* >( this );
+    item->index = createIndex( row, 0 );
+    if ( AudioEngine::instance()->currentTrack() == result )
+        item->setIsPlaying( true );
+
+    connect( item, SIGNAL( dataChanged() ), SLOT( onDataChanged() ) );
+
+    m_items.insert( row, item );
+    return item;
 }
 
 
@@ -48,12 +268,10 @@ CollectionFlatModel::addCollections( const QList< collection_ptr >& collections
     qDebug() << Q_FUNC_INFO << "Adding collections!";
     foreach( const collection_ptr& col, collections )
     {
-        addCollection( col );
+        connectCollection( col );
     }
 
-    // we are waiting for some to load
-    if( !m_loadingCollections.isEmpty() )
-        emit loadingStarted();
+    reset();
 }
 
 
@@ -64,21 +282,8 @@ CollectionFlatModel::addCollection( const collection_ptr& collection, bool sendN
                             << collection->source()->id()
                             << collection->source()->userName();
 
-    connect( collection.data(), SIGNAL( tracksAdded( QList<Tomahawk::query_ptr> ) ),
-                                  SLOT( onTracksAdded( QList<Tomahawk::query_ptr> ) ) );
-    connect( collection.data(), SIGNAL( tracksRemoved( QList<Tomahawk::query_ptr> ) ),
-                                  SLOT( onTracksRemoved( QList<Tomahawk::query_ptr> ) ) );
-
-    if( sendNotifications )
-        emit loadingStarted();
-
-    DatabaseCommand_AllTracks* cmd = new DatabaseCommand_AllTracks( collection );
-    connect( cmd, SIGNAL( tracks( QList<Tomahawk::query_ptr>, QVariant ) ),
-                    SLOT( onTracksAdded( QList<Tomahawk::query_ptr> ) ), Qt::QueuedConnection );
-
-    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
-
-    m_loadingCollections << collection.data();
+    connectCollection( collection );
+    reset( sendNotifications );
 
     if ( collection->source()->isLocal() )
         setTitle( tr( "My Collection" ) );
@@ -95,178 +300,388 @@ CollectionFlatModel::addFilteredCollection( const collection_ptr& collection, un
                             << collection->source()->userName()
                             << amount << order;
 
-    DatabaseCommand_AllTracks* cmd = new DatabaseCommand_AllTracks( collection );
-    cmd->setLimit( amount );
-    cmd->setSortOrder( order );
-    cmd->setSortDescending( true );
+    if ( order == DatabaseCommand_AllTracks::ModificationTime )
+    {
+        m_recent = amount;
+        m_sortColumn = DatabaseCommand_TrackPage::ModificationTime;
+        m_sortDescending = true;
+    }
+    else
+        qDebug() << "Only the most recent tracks can be picked, showing the whole collection";
+
+    connectCollection( collection );
+    reset();
+}
 
-    connect( cmd, SIGNAL( tracks( QList<Tomahawk::query_ptr>, QVariant ) ),
-                    SLOT( onTracksAdded( QList<Tomahawk::query_ptr> ) ), Qt::QueuedConnection );
 
-    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
+void
+CollectionFlatModel::connectCollection( const collection_ptr& collection )
+{
+    if ( m_collections.contains( collection ) )
+        return;
+
+    m_collections << collection;
+
+    connect( collection.data(), SIGNAL( tracksAdded( QList<unsigned int> ) ), &m_refreshTimer, SLOT( start() ) );
+    connect( collection.data(), SIGNAL( tracksRemoved( QList<unsigned int> ) ), &m_refreshTimer, SLOT( start() ) );
 }
 
 
 void
 CollectionFlatModel::removeCollection( const collection_ptr& collection )
 {
-    return; // FIXME
+    if ( !m_collections.contains( collection ) )
+        return;
 
-    disconnect( collection.data(), SIGNAL( tracksAdded( QList<Tomahawk::query_ptr> ) ),
-                this, SLOT( onTracksAdded( QList<Tomahawk::query_ptr> ) ) );
+    disconnect( collection.data(), 0, &m_refreshTimer, 0 );
+    m_collections.removeAll( collection );
 
-    QTime timer;
-    timer.start();
+    reset();
+}
 
-//    QList<TrackModelItem*> plitems = m_collectionIndex.values( collection );
-    QList< QPair< int, int > > rows;
-    QList< QPair< int, int > > sortrows;
-    QPair< int, int > row;
-    QPair< int, int > rowf;
-    rows = m_collectionRows.values( collection );
 
-    while ( rows.count() )
+void
+CollectionFlatModel::setSortOrder( int column, Qt::SortOrder order )
+{
+    DatabaseCommand_TrackPage::SortColumn sortColumn;
+    switch ( column )
     {
-        int x = -1;
-        int j = 0;
-        foreach( row, rows )
-        {
-            if ( x < 0 || row.first > rows.at( x ).first )
-                x = j;
+        case Artist:
+            sortColumn = DatabaseCommand_TrackPage::Artist;
+            break;
 
-            j++;
-        }
+        case Track:
+            sortColumn = DatabaseCommand_TrackPage::Track;
+            break;
+
+        case Album:
+        case AlbumPos:
+            sortColumn = DatabaseCommand_TrackPage::Album;
+            break;
+
+        case Duration:
+            sortColumn = DatabaseCommand_TrackPage::Duration;
+            break;
+
+        case Bitrate:
+            sortColumn = DatabaseCommand_TrackPage::Bitrate;
+            break;
+
+        case Age:
+            sortColumn = DatabaseCommand_TrackPage::ModificationTime;
+            break;
 
-        sortrows.append( rows.at( x ) );
-        rows.removeAt( x );
+        case Filesize:
+            sortColumn = DatabaseCommand_TrackPage::Filesize;
+            break;
+
+        default:
+            return;
     }
 
-    foreach( row, sortrows )
+    const bool descending = ( order == Qt::DescendingOrder );
+    if ( sortColumn == m_sortColumn && descending == m_sortDescending )
+        return;
+
+    m_sortColumn = sortColumn;
+    m_sortDescending = descending;
+    reset();
+}
+
+
+void
+CollectionFlatModel::setFilter( const QString& filter )
+{
+    if ( filter == m_filter )
+        return;
+
+    m_filter = filter;
+    reset();
+}
+
+
+void
+CollectionFlatModel::setCurrentItem( const QModelIndex& index )
+{
+    TrackModel::setCurrentItem( index );
+
+    // make sure the next track is at hand when this one finishes
+    if ( index.isValid() )
+        requestPage( ( index.row() + 1 ) / PAGE_SIZE );
+}
+
+
+void
+CollectionFlatModel::reset( bool sendNotifications )
+{
+    beginResetModel();
+    m_generation++;
+    m_refreshTimer.stop();
+    clearPages();
+    m_total = 0;
+    endResetModel();
+
+    if ( m_collections.isEmpty() )
+        return;
+
+    if ( sendNotifications )
+        emit loadingStarted();
+
+    fetchPage( 0, true );
+}
+
+
+void
+CollectionFlatModel::refresh()
+{
+    if ( m_collections.isEmpty() )
+        return;
+
+    // keep the rows and the scroll position, just forget what we loaded and let
+    // the view ask again for what it shows. The pages of the playing track stay
+    // until we know where it ended up, see remapCurrentItem()
+    m_generation++;
+    m_pendingPages.clear();
+    m_wantedPages.clear();
+
+    const QPersistentModelIndex current = currentItem();
+    const int currentPage = current.isValid() ? current.row() / PAGE_SIZE : -1;
+    const int nextPage = current.isValid() ? ( current.row() + 1 ) / PAGE_SIZE : -1;
+    foreach ( int p, m_pages.keys() )
     {
-        QMap< Tomahawk::collection_ptr, QPair< int, int > > newrows;
-        foreach ( const collection_ptr& col, m_collectionRows.uniqueKeys() )
-        {
-            if ( col.data() == collection.data() )
-                continue;
+        if ( p == currentPage || p == nextPage )
+            m_stalePages << p;
+        else
+            dropPage( p );
+    }
+
+    fetchPage( 0, true );
+
+    if ( m_total )
+        emit dataChanged( index( 0, 0, QModelIndex() ), index( m_total - 1, columnCount() - 1, QModelIndex() ) );
+}
 
-            foreach ( rowf, m_collectionRows.values( col ) )
-            {
-                if ( rowf.first > row.first )
-                {
-                    rowf.first -= ( row.second - row.first ) + 1;
-                    rowf.second -= ( row.second - row.first ) + 1;
-                }
-                newrows.insertMulti( col, rowf );
-            }
-        }
-        m_collectionRows = newrows;
 
-        qDebug() << "Removing rows:" << row.first << row.second;
-        emit beginRemoveRows( QModelIndex(), row.first, row.second );
-        for ( int i = row.second; i >= row.first; i-- )
+void
+CollectionFlatModel::requestPage( int page ) const
+{
+    if ( page < 0 || page * PAGE_SIZE >= m_total )
+        return;
+    if ( m_pages.contains( page ) || m_pendingPages.contains( page ) || m_wantedPages.contains( page ) )
+        return;
+
+    // called while the view paints, so collect the pages and fetch them all at once later
+    if ( m_wantedPages.isEmpty() )
+        QMetaObject::invokeMethod( const_cast< CollectionFlatModel* >( this ), "fetchPages", Qt::QueuedConnection );
+
+    m_wantedPages << page;
+}
+
+
+void
+CollectionFlatModel::fetchPages()
+{
+    QList< int > wanted = m_wantedPages.toList();
+    m_wantedPages.clear();
+    qSort( wanted );
+
+    foreach ( int page, wanted )
+    {
+        for ( int p = page - PREFETCH_PAGES; p <= page + PREFETCH_PAGES; p++ )
         {
-            TrackModelItem* item = itemFromIndex( index( i, 0, QModelIndex() ) );
-            delete item;
+            if ( p < 0 || p * PAGE_SIZE >= m_total || m_pages.contains( p ) || m_pendingPages.contains( p ) )
+                continue;
+
+            fetchPage( p );
         }
-        emit endRemoveRows();
     }
+}
 
-    qDebug() << "Collection removed, time elapsed:" << timer.elapsed();
 
-//    emit trackCountChanged( rowCount( QModelIndex() ) );
+void
+CollectionFlatModel::fetchPage( int page, bool countTotal )
+{
+    DatabaseCommand_TrackPage* cmd = new DatabaseCommand_TrackPage( m_collections );
+    cmd->setSortColumn( m_sortColumn );
+    cmd->setSortDescending( m_sortDescending );
+    cmd->setFilter( m_filter );
+    cmd->setRecent( m_recent );
+    cmd->setCountTotal( countTotal );
+    if ( countTotal && currentItem().isValid() )
+        cmd->setLocate( fileIdAt( currentItem().row() ) );
+
+    // continue after the previous page if we have it, instead of counting rows from the top
+    QHash< int, TrackPage >::const_iterator previous = m_pages.constFind( page - 1 );
+    const bool continuous = previous != m_pages.constEnd() && !m_stalePages.contains( page - 1 );
+    cmd->setRange( page * PAGE_SIZE, PAGE_SIZE, continuous ? previous.value().lastKey : QVariantList() );
+    cmd->setData( m_generation );
+
+    connect( cmd, SIGNAL( tracks( TrackPage, QVariant ) ),
+                    SLOT( onPageLoaded( TrackPage, QVariant ) ), Qt::QueuedConnection );
+
+    m_pendingPages << page;
+    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
 }
 
 
 void
-CollectionFlatModel::onTracksAdded( const QList<Tomahawk::query_ptr>& tracks )
+CollectionFlatModel::onPageLoaded( const TrackPage& page, const QVariant& data )
 {
-    qDebug() << Q_FUNC_INFO << tracks.count() << rowCount( QModelIndex() );
+    if ( data.toUInt() != m_generation )
+        return;
+
+    const int pageNumber = page.offset / PAGE_SIZE;
+    m_pendingPages.remove( pageNumber );
 
-    if( !m_loadingCollections.isEmpty() && sender() && qobject_cast< Collection* >( sender() ) )
+    // before rows go away, which may take the current index with them
+    const int currentRow = currentItem().isValid() ? currentItem().row() : -1;
+
+    if ( page.total >= 0 && page.total != m_total )
     {
-        // we are keeping track and are called as a slot
-        m_loadingCollections.removeAll( qobject_cast< Collection* >( sender() ) );
+        if ( page.total > m_total )
+        {
+            beginInsertRows( QModelIndex(), m_total, page.total - 1 );
+            m_total = page.total;
+            endInsertRows();
+        }
+        else
+        {
+            beginRemoveRows( QModelIndex(), page.total, m_total - 1 );
+            m_total = page.total;
+            endRemoveRows();
+        }
     }
 
-    bool kickOff = m_tracksToAdd.isEmpty();
-    m_tracksToAdd << tracks;
+    if ( page.total >= 0 && !m_stalePages.isEmpty() )
+        remapCurrentItem( currentRow, page.located, pageNumber );
+
+    // a page loaded again only keeps the items of rows that still show the same file
+    QHash< int, TrackPage >::const_iterator old = m_pages.constFind( pageNumber );
+    if ( old != m_pages.constEnd() )
+    {
+        for ( int i = 0; i < old.value().count(); i++ )
+        {
+            const int row = page.offset + i;
+            if ( !m_items.contains( row ) )
+                continue;
+            if ( i >= page.count() || page.fileIds.at( i ) != old.value().fileIds.at( i ) )
+                delete m_items.take( row );
+        }
+    }
+
+    m_pages.insert( pageNumber, page );
+    m_stalePages.remove( pageNumber );
+    touchPage( pageNumber );
+
+    // the page of the playing track and the one after it stay, everything else
+    // is dropped least recently used first
+    const QPersistentModelIndex current = currentItem();
+    const int currentPage = current.isValid() ? current.row() / PAGE_SIZE : -1;
+    const int nextPage = current.isValid() ? ( current.row() + 1 ) / PAGE_SIZE : -1;
+    for ( int i = 0; i < m_pageUsage.count() && m_pages.count() > MAX_PAGES; )
+    {
+        const int p = m_pageUsage.at( i );
+        if ( p == currentPage || p == nextPage || p == pageNumber )
+        {
+            i++;
+            continue;
+        }
+
+        dropPage( p );
+    }
 
-    emit trackCountChanged( trackCount() );
+    const int first = page.offset;
+    const int last = qMin( first + page.count(), m_total ) - 1;
+    if ( last >= first )
+        emit dataChanged( index( first, 0, QModelIndex() ), index( last, columnCount() - 1, QModelIndex() ) );
 
-    if ( m_tracksToAdd.count() && kickOff )
-        processTracksToAdd();
-    else if ( m_tracksToAdd.isEmpty() && m_loadingCollections.isEmpty() )
+    if ( page.total >= 0 )
+    {
+        emit trackCountChanged( m_total );
         emit loadingFinished();
+    }
 }
 
 
 void
-CollectionFlatModel::processTracksToAdd()
+CollectionFlatModel::touchPage( int page ) const
 {
-    int chunkSize = 5000;
-    int maxc = qMin( chunkSize, m_tracksToAdd.count() );
-    int c = rowCount( QModelIndex() );
+    if ( !m_pageUsage.isEmpty() && m_pageUsage.last() == page )
+        return;
 
-    emit beginInsertRows( QModelIndex(), c, c + maxc - 1 );
-    //beginResetModel();
+    m_pageUsage.removeAll( page );
+    m_pageUsage << page;
+}
 
-    TrackModelItem* plitem;
-    QList< Tomahawk::query_ptr >::iterator iter = m_tracksToAdd.begin();
 
-    for( int i = 0; i < maxc; ++i )
+void
+CollectionFlatModel::remapCurrentItem( int oldRow, int row, int loadedPage )
+{
+    if ( oldRow < 0 || row < 0 || row == oldRow )
     {
-        plitem = new TrackModelItem( *iter, m_rootItem );
-        plitem->index = createIndex( m_rootItem->children.count() - 1, 0, plitem );
+        // the playing track didn't move (or isn't in the view anymore): keep
+        // showing its pages while they are loaded again
+        foreach ( int p, m_stalePages )
+        {
+            if ( p * PAGE_SIZE >= m_total )
+                dropPage( p );
+            else if ( p != loadedPage && !m_pendingPages.contains( p ) )
+                fetchPage( p );
+        }
+        return;
+    }
 
-        connect( plitem, SIGNAL( dataChanged() ), SLOT( onDataChanged() ) );
+    // the rows around it shifted, only the playing item itself is still of use
+    TrackModelItem* item = m_items.take( oldRow );
+    foreach ( int p, m_stalePages )
+        dropPage( p );
+    m_stalePages.clear();
 
-        ++iter;
+    if ( item )
+    {
+        delete m_items.take( row );
+        item->index = createIndex( row, 0 );
+        m_items.insert( row, item );
     }
 
-    m_tracksToAdd.erase( m_tracksToAdd.begin(), iter );
+    setCurrentItem( index( row, 0, QModelIndex() ) );
+}
 
-    if ( m_tracksToAdd.isEmpty() && m_loadingCollections.isEmpty() )
-        emit loadingFinished();
 
-    //endResetModel();
-    emit endInsertRows();
-    qDebug() << Q_FUNC_INFO << rowCount( QModelIndex() );
+unsigned int
+CollectionFlatModel::fileIdAt( int row ) const
+{
+    QHash< int, TrackPage >::const_iterator it = m_pages.constFind( row / PAGE_SIZE );
+    if ( it == m_pages.constEnd() )
+        return 0;
 
-    if ( m_tracksToAdd.count() )
-        QTimer::singleShot( 250, this, SLOT( processTracksToAdd() ) );
+    const int i = row - it.value().offset;
+    return i < it.value().count() ? it.value().fileIds.at( i ) : 0;
 }
 
 
 void
-CollectionFlatModel::onTracksRemoved( const QList<Tomahawk::query_ptr>& tracks )
+CollectionFlatModel::dropPage( int page )
 {
-    QList<Tomahawk::query_ptr> t = tracks;
-    for ( int i = rowCount( QModelIndex() ); i >= 0 && t.count(); i-- )
-    {
-        TrackModelItem* item = itemFromIndex( index( i, 0, QModelIndex() ) );
-        if ( !item )
-            continue;
+    const TrackPage p = m_pages.take( page );
+    m_pageUsage.removeAll( page );
+    m_stalePages.remove( page );
+
+    for ( int row = p.offset; row < (int)p.offset + p.count(); row++ )
+        delete m_items.take( row );
+}
 
-        int j = 0;
-        foreach ( const query_ptr& query, t )
-        {
-            if ( item->query().data() == query.data() )
-            {
-                qDebug() << "Removing row:" << i << query->toString();
-                emit beginRemoveRows( QModelIndex(), i, i );
-                delete item;
-                emit endRemoveRows();
-
-                t.removeAt( j );
-                break;
-            }
-
-            j++;
-        }
-    }
 
-//    emit trackCountChanged( rowCount( QModelIndex() ) );
-    qDebug() << Q_FUNC_INFO << rowCount( QModelIndex() );
+void
+CollectionFlatModel::clearPages()
+{
+    qDeleteAll( m_items );
+    m_items.clear();
+    m_pages.clear();
+    m_pageUsage.clear();
+    m_pendingPages.clear();
+    m_wantedPages.clear();
+    m_stalePages.clear();
 }
 
 
@@ -286,8 +701,9 @@ CollectionFlatModel::onSourceOffline( const Tomahawk::source_ptr& src )
 {
     qDebug() << Q_FUNC_INFO;
 
-    if ( m_collectionRows.contains( src->collection() ) )
+    foreach ( const collection_ptr& collection, m_collections )
     {
-        removeCollection( src->collection() );
+        if ( collection->source() == src )
+            removeCollection( collection );
     }
 }
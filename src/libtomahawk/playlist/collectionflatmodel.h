@@ -22,6 +22,8 @@
 #include <QAbstractItemModel>
 #include <QList>
 #include <QHash>
+#include <QSet>
+#include <QTimer>
 
 #include "typedefs.h"
 #include "trackmodel.h"
@@ -30,11 +32,19 @@
 #include "playlistinterface.h"
 
 #include "database/databasecommand_alltracks.h"
+#include "database/databasecommand_trackpage.h"
 
 #include "dllmacro.h"
 
 class QMetaData;
 
+/**
+ * A flat view onto one or more collections, which never holds the whole
+ * collection in memory: it only knows how many tracks match, and loads the
+ * rows the view asks for in pages, sorted and filtered by the database.
+ * Items with a query and result are only built for rows that get painted
+ * or played, and go away again together with their page.
+ */
 class DLLEXPORT CollectionFlatModel : public TrackModel
 {
 Q_OBJECT
@@ -43,7 +53,15 @@ public:
     explicit CollectionFlatModel( QObject* parent = 0 );
     ~CollectionFlatModel();
 
-    virtual int trackCount() const { return rowCount( QModelIndex() ) + m_tracksToAdd.count(); }
+    virtual QModelIndex index( int row, int column, const QModelIndex& parent ) const;
+    virtual QModelIndex parent( const QModelIndex& child ) const;
+    virtual int rowCount( const QModelIndex& parent ) const;
+    virtual QVariant data( const QModelIndex& index, int role = Qt::DisplayRole ) const;
+
+    virtual TrackModelItem* itemFromIndex( const QModelIndex& index ) const;
+
+    virtual void removeIndex( const QModelIndex& /*index*/, bool /*moreToCome*/ = false ) {}
+    virtual void ensureResolved() {}
 
     void addCollections( const QList< Tomahawk::collection_ptr >& collections );
 
@@ -52,6 +70,11 @@ public:
 
     void addFilteredCollection( const Tomahawk::collection_ptr& collection, unsigned int amount, DatabaseCommand_AllTracks::SortOrder order );
 
+    /// Sorts by one of the TrackModel columns. Columns the database can't sort by are ignored.
+    void setSortOrder( int column, Qt::SortOrder order );
+    QString filter() const { return m_filter; }
+    void setFilter( const QString& filter );
+
     virtual void append( const Tomahawk::query_ptr& /*query*/ ) {}
     virtual void append( const Tomahawk::artist_ptr& /*artist*/ ) {}
     virtual void append( const Tomahawk::album_ptr& /*album*/ ) {}
@@ -64,21 +87,51 @@ signals:
     void loadingFinished();
     void trackCountChanged( unsigned int tracks );
 
+public slots:
+    virtual void setCurrentItem( const QModelIndex& index );
+
 private slots:
     void onDataChanged();
-
-    void onTracksAdded( const QList<Tomahawk::query_ptr>& tracks );
-    void onTracksRemoved( const QList<Tomahawk::query_ptr>& tracks );
+    void onPageLoaded( const TrackPage& page, const QVariant& data );
 
     void onSourceOffline( const Tomahawk::source_ptr& src );
 
-    void processTracksToAdd();
+    void refresh();
+    void fetchPages();
 
 private:
-    QMap< Tomahawk::collection_ptr, QPair< int, int > > m_collectionRows;
-    QList<Tomahawk::query_ptr> m_tracksToAdd;
-    // just to keep track of what we are waiting to be loaded
-    QList<Tomahawk::Collection*> m_loadingCollections;
+    void connectCollection( const Tomahawk::collection_ptr& collection );
+    void reset( bool sendNotifications = true );
+
+    void fetchPage( int page, bool countTotal = false );
+    void requestPage( int page ) const;
+    void touchPage( int page ) const;
+    void clearPages();
+    void dropPage( int page );
+    void remapCurrentItem( int oldRow, int row, int loadedPage );
+    unsigned int fileIdAt( int row ) const;
+    TrackModelItem* createItem( int row ) const;
+
+    QList< Tomahawk::collection_ptr > m_collections;
+    unsigned int m_recent;
+
+    DatabaseCommand_TrackPage::SortColumn m_sortColumn;
+    bool m_sortDescending;
+    QString m_filter;
+
+    // bumped whenever sorting, filtering or the collections change, so pages
+    // still in flight for the old state are thrown away
+    unsigned int m_generation;
+    int m_total;
+    QTimer m_refreshTimer;
+
+    QHash< int, TrackPage > m_pages;
+    mutable QList< int > m_pageUsage; // least recently used first
+    mutable QSet< int > m_pendingPages;
+    mutable QSet< int > m_wantedPages;
+    QSet< int > m_stalePages; // kept over a refresh for the playing track, until loaded again
+    mutable QHash< int, TrackModelItem* > m_items;
+    TrackModelItem* m_loadingItem;
 };
 
 #endif // COLLECTIONFLATMODEL_H
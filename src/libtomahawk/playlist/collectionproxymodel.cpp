@@ -20,6 +20,7 @@
 
 #include <QTreeView>
 
+#include "collectionflatmodel.h"
 #include "album.h"
 #include "query.h"
 #include "utils/logger.h"
@@ -29,3 +30,66 @@ CollectionProxyModel::CollectionProxyModel( QObject* parent )
     : TrackProxyModel( parent )
 {
 }
+
+
+CollectionFlatModel*
+CollectionProxyModel::collectionModel() const
+{
+    return qobject_cast< CollectionFlatModel* >( sourceModel() );
+}
+
+
+// A CollectionFlatModel only ever holds a window of its rows, so it sorts and
+// filters in the database and we just pass its rows through as they come.
+void
+CollectionProxyModel::sort( int column, Qt::SortOrder order )
+{
+    CollectionFlatModel* model = collectionModel();
+    if ( !model )
+    {
+        TrackProxyModel::sort( column, order );
+        return;
+    }
+
+    model->setSortOrder( column, order );
+    TrackProxyModel::sort( -1, order );
+}
+
+
+QString
+CollectionProxyModel::filter() const
+{
+    CollectionFlatModel* model = collectionModel();
+    if ( !model )
+        return TrackProxyModel::filter();
+
+    return model->filter();
+}
+
+
+void
+CollectionProxyModel::setFilter( const QString& pattern )
+{
+    CollectionFlatModel* model = collectionModel();
+    if ( !model )
+    {
+        TrackProxyModel::setFilter( pattern );
+        return;
+    }
+
+    PlaylistInterface::setFilter( pattern );
+    model->setFilter( pattern );
+
+    emit filterChanged( pattern );
+    emit trackCountChanged( trackCount() );
+}
+
+
+bool
+CollectionProxyModel::filterAcceptsRow( int sourceRow, const QModelIndex& sourceParent ) const
+{
+    if ( !collectionModel() )
+        return TrackProxyModel::filterAcceptsRow( sourceRow, sourceParent );
+
+    return true;
+}
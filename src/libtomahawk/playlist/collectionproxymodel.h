@@ -21,6 +21,8 @@
 
 #include "trackproxymodel.h"
 
+class CollectionFlatModel;
+
 #include "dllmacro.h"
 
 class DLLEXPORT CollectionProxyModel : public TrackProxyModel
@@ -31,6 +33,17 @@ public:
     explicit CollectionProxyModel( QObject* parent = 0 );
 
     virtual PlaylistInterface::ViewMode viewMode() const { return PlaylistInterface::Flat; }
+
+    virtual void sort( int column, Qt::SortOrder order = Qt::AscendingOrder );
+
+    virtual QString filter() const;
+    virtual void setFilter( const QString& pattern );
+
+protected:
+    bool filterAcceptsRow( int sourceRow, const QModelIndex& sourceParent ) const;
+
+private:
+    CollectionFlatModel* collectionModel() const;
 };
 
 #endif // COLLECTIONPROXYMODEL_H
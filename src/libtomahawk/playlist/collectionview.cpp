@@ -79,7 +79,13 @@ CollectionView::dragEnterEvent( QDragEnterEvent* event )
 void
 CollectionView::onTrackCountChanged( unsigned int tracks )
 {
-    if ( tracks == 0 )
+    if ( tracks == 0 && !proxyModel()->filter().isEmpty() )
+    {
+        // the model filters by itself, so an empty result is the filter's doing
+        overlay()->setText( tr( "Sorry, your filter '%1' did not match any results." ).arg( proxyModel()->filter() ) );
+        overlay()->show();
+    }
+    else if ( tracks == 0 )
     {
         overlay()->setText( tr( "This collection is empty." ) );
         overlay()->show();
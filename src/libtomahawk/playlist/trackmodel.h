@@ -94,7 +94,7 @@ public:
     virtual void append( const Tomahawk::artist_ptr& artist ) = 0;
     virtual void append( const Tomahawk::album_ptr& album ) = 0;
 
-    TrackModelItem* itemFromIndex( const QModelIndex& index ) const;
+    virtual TrackModelItem* itemFromIndex( const QModelIndex& index ) const;
     TrackModelItem* m_rootItem;
 
 signals:
@@ -167,6 +167,25 @@ TrackProxyModel::siblingItem( int itemsAway, bool readOnly )
 }
 
 
+Tomahawk::query_ptr
+TrackProxyModel::siblingQuery( int itemsAway )
+{
+    // same walk as siblingItem(), minus the shuffling and skipping unplayable items
+    if ( m_shuffled || !rowCount() )
+        return Tomahawk::query_ptr();
+
+    QModelIndex idx = index( 0, 0 );
+    if ( currentIndex().isValid() )
+        idx = index( currentIndex().row() + ( m_repeatMode != PlaylistInterface::RepeatOne ? itemsAway : 0 ), 0 );
+
+    if ( !idx.isValid() && m_repeatMode == PlaylistInterface::RepeatAll )
+        idx = index( itemsAway > 0 ? 0 : rowCount() - 1, 0 );
+
+    TrackModelItem* item = idx.isValid() ? itemFromIndex( mapToSource( idx ) ) : 0;
+    return item ? item->query() : Tomahawk::query_ptr();
+}
+
+
 Tomahawk::result_ptr
 TrackProxyModel::currentItem() const
 {
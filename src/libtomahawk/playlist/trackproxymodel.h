@@ -53,6 +53,7 @@ public:
     virtual Tomahawk::result_ptr siblingItem( int itemsAway );
     virtual Tomahawk::result_ptr siblingItem( int itemsAway, bool readOnly );
     virtual bool hasNextItem();
+    virtual Tomahawk::query_ptr siblingQuery( int itemsAway );
 
     virtual QString filter() const { return filterRegExp().pattern(); }
     virtual void setFilter( const QString& pattern );
@@ -23,7 +23,6 @@
 #include "source.h"
 #include "query.h"
 #include "database/database.h"
-#include "database/databaseimpl.h"
 #include "database/databasecommand_allalbums.h"
 #include "utils/logger.h"
 
@@ -417,11 +416,11 @@ TreeProxyModel::textForItem( TreeModelItem* item ) const
     }
     else if ( !item->album().isNull() )
     {
-        return DatabaseImpl::sortname( item->album()->name() );
+        return item->album()->sortname();
     }
     else if ( !item->result().isNull() )
     {
-        return DatabaseImpl::sortname( item->result()->track() );
+        return item->result()->trackSortname();
     }
     else if ( !item->query().isNull() )
     {
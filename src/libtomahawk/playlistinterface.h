@@ -52,6 +52,9 @@ public:
     virtual bool hasNextItem() { return true; }
     virtual Tomahawk::result_ptr nextItem();
     virtual Tomahawk::result_ptr siblingItem( int itemsAway ) = 0;
+    // The query itemsAway from the current one, whether it's resolved or not, without moving
+    // there. Null if that isn't known in advance, e.g. when shuffling.
+    virtual Tomahawk::query_ptr siblingQuery( int /*itemsAway*/ ) { return Tomahawk::query_ptr(); }
 
     virtual PlaylistInterface::RepeatMode repeatMode() const = 0;
     virtual bool shuffled() const = 0;
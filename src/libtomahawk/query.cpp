@@ -20,7 +20,6 @@
 
 #include <QtAlgorithms>
 
-#include "database/database.h"
 #include "database/databaseimpl.h"
 #include "database/databasecommand_logplayback.h"
 #include "database/databasecommand_playbackhistory.h"
@@ -33,11 +32,12 @@
 #include "audio/audioengine.h"
 
 #include "utils/logger.h"
+#include "utils/tomahawkutils.h"
+#include "utils/weakregistry.h"
 
 using namespace Tomahawk;
 
-static QHash< QString, QWeakPointer< Query > > s_queries;
-static QMutex s_mutex;
+static TomahawkUtils::WeakRegistry< QString, Query > s_queries;
 
 
 query_ptr
@@ -47,8 +47,7 @@ Query::get( const QString& artist, const QString& track, const QString& album, c
         autoResolve = false;
 
     query_ptr q = query_ptr( new Query( artist, track, album, qid, autoResolve ) );
-    QMutexLocker lock( &s_mutex );
-    s_queries.insert( q->id(), q );
+    s_queries.set( q->id(), q );
 
     if ( autoResolve )
         Pipeline::instance()->resolve( q );
@@ -60,6 +59,7 @@ query_ptr
 Query::get( const QString& query, const QID& qid )
 {
     query_ptr q = query_ptr( new Query( query, qid ) );
+    s_queries.set( q->id(), q );
 
     if ( !qid.isEmpty() )
         Pipeline::instance()->resolve( q );
@@ -73,17 +73,8 @@ Query::Query( const QString& artist, const QString& track, const QString& album,
     , m_album( album )
     , m_track( track )
 {
+    Q_UNUSED( autoResolve );
     init();
-
-    if ( autoResolve )
-    {
-        connect( Database::instance(), SIGNAL( indexReady() ), SLOT( refreshResults() ), Qt::QueuedConnection );
-    }
-
-    connect( Pipeline::instance(), SIGNAL( resolverAdded( Resolver* ) ),
-             SLOT( onResolverAdded() ), Qt::QueuedConnection );
-    connect( Pipeline::instance(), SIGNAL( resolverRemoved( Resolver* ) ),
-             SLOT( onResolverRemoved() ), Qt::QueuedConnection );
 }
 
 
@@ -92,24 +83,30 @@ Query::Query( const QString& query, const QID& qid )
     , m_fullTextQuery( query )
 {
     init();
-
-    if ( !qid.isEmpty() )
-    {
-        connect( Database::instance(), SIGNAL( indexReady() ), SLOT( refreshResults() ), Qt::QueuedConnection );
-    }
 }
 
 
 Query::~Query()
 {
+    if ( Pipeline::instance() )
+        Pipeline::instance()->removeUnsolved( this );
+
     if ( !id().isEmpty() )
-    {
-        QMutexLocker lock( &s_mutex );
-        if ( s_queries.contains( id() ) )
-        {
-            s_queries.remove( id() );
-        }
-    }
+        s_queries.remove( id() );
+}
+
+
+query_ptr
+Query::registered( const QID& qid )
+{
+    return s_queries.value( qid );
+}
+
+
+unsigned int
+Query::registrySize()
+{
+    return s_queries.count();
 }
 
 
@@ -122,6 +119,11 @@ Query::init()
     m_duration = -1;
     m_albumpos = 0;
 
+    m_unsolvedPrev = 0;
+    m_unsolvedNext = 0;
+    m_unsolvedPriority = -1;
+    m_unsolvedEpoch = 0;
+
     updateSortNames();
 }
 
@@ -182,7 +184,11 @@ Query::refreshResults()
     if ( m_resolveFinished )
     {
         m_resolveFinished = false;
-        Pipeline::instance()->resolve( s_queries.value( id() ) );
+        if ( Pipeline::instance() )
+        {
+            Pipeline::instance()->removeUnsolved( this );
+            Pipeline::instance()->resolve( s_queries.value( id() ) );
+        }
     }
 }
 
@@ -228,26 +234,6 @@ Query::onResolvingFinished()
 }
 
 
-void
-Query::onResolverAdded()
-{
-    if ( !solved() )
-    {
-        refreshResults();
-    }
-}
-
-
-void
-Query::onResolverRemoved()
-{
-    if ( !solved() )
-    {
-        refreshResults();
-    }
-}
-
-
 QList< result_ptr >
 Query::results() const
 {
@@ -377,6 +363,9 @@ Query::checkResults()
     if ( m_solved != solved )
     {
         m_solved = solved;
+        if ( m_solved && Pipeline::instance() )
+            Pipeline::instance()->removeUnsolved( this );
+
         emit solvedStateChanged( m_solved );
     }
 }
@@ -403,129 +392,60 @@ Query::toString() const
 }
 
 
-// TODO make clever (ft. featuring live (stuff) etc)
-float
-Query::howSimilar( const Tomahawk::result_ptr& r )
+// Similarity of two sortnames between 0 and 1. Once it is clear the result
+// is going to be below minSimilarity the distance computation is cut short,
+// and the returned value is only an upper bound (still below minSimilarity).
+static float
+similarity( const QString& a, const QString& b, float minSimilarity = 0.0 )
 {
-    // result values
-    const QString rArtistname = r->artist()->sortname();
-    const QString rAlbumname  = DatabaseImpl::sortname( r->album()->name() );
-    const QString rTrackname  = DatabaseImpl::sortname( r->track() );
-
-    // normal edit distance
-    int artdist = levenshtein( m_artistSortname, rArtistname );
-    int albdist = levenshtein( m_albumSortname, rAlbumname );
-    int trkdist = levenshtein( m_trackSortname, rTrackname );
-
-    // max length of name
-    int mlart = qMax( m_artistSortname.length(), rArtistname.length() );
-    int mlalb = qMax( m_albumSortname.length(), rAlbumname.length() );
-    int mltrk = qMax( m_trackSortname.length(), rTrackname.length() );
+    const int ml = qMax( a.length(), b.length() );
+    if ( ml == 0 )
+        return 1.0;
 
-    // distance scores
-    float dcart = (float)( mlart - artdist ) / mlart;
-    float dcalb = (float)( mlalb - albdist ) / mlalb;
-    float dctrk = (float)( mltrk - trkdist ) / mltrk;
+    int maxDistance = -1;
+    if ( minSimilarity > 0.0 )
+        maxDistance = qMax( 0, (int)( ml * ( 1.0 - minSimilarity ) + 0.0001 ) );
 
-    if ( isFullTextQuery() )
-    {
-        float res = qMax( dcart, dcalb );
-        return qMax( res, dctrk );
-    }
-    else
-    {
-        // don't penalize for missing album name
-        if ( m_albumSortname.isEmpty() || rAlbumname.isEmpty() )
-            dcalb = 1.0;
-
-        // weighted, so album match is worth less than track title
-        float combined = ( dcart * 4 + dcalb + dctrk * 5 ) / 10;
-        return combined;
-    }
+    const int dist = TomahawkUtils::editDistance( a, b, maxDistance );
+    return (float)( ml - dist ) / ml;
 }
 
 
-QPair< Tomahawk::source_ptr, unsigned int >
-Query::playedBy() const
+// TODO make clever (ft. featuring live (stuff) etc)
+float
+Query::howSimilar( const Tomahawk::result_ptr& r, float minScore )
 {
-    return m_playedBy;
-}
+    // result values, normalized once when the result was created
+    const QString rArtistname = r->artist()->sortname();
+    const QString rAlbumname  = r->album()->sortname();
+    const QString rTrackname  = r->trackSortname();
 
-int
-Query::levenshtein( const QString& source, const QString& target )
-{
-    // Step 1
-    const int n = source.length();
-    const int m = target.length();
-
-    if ( n == 0 )
-        return m;
-    if ( m == 0 )
-        return n;
-
-    // Good form to declare a TYPEDEF
-    typedef QVector< QVector<int> > Tmatrix;
-    Tmatrix matrix;
-    matrix.resize( n + 1 );
-
-    // Size the vectors in the 2.nd dimension. Unfortunately C++ doesn't
-    // allow for allocation on declaration of 2.nd dimension of vec of vec
-    for ( int i = 0; i <= n; i++ )
+    if ( isFullTextQuery() )
     {
-        QVector<int> tmp;
-        tmp.resize( m + 1 );
-        matrix.insert( i, tmp );
+        float res = qMax( similarity( m_artistSortname, rArtistname ), similarity( m_albumSortname, rAlbumname ) );
+        return qMax( res, similarity( m_trackSortname, rTrackname ) );
     }
 
-    // Step 2
-    for ( int i = 0; i <= n; i++ )
-        matrix[i][0] = i;
-    for ( int j = 0; j <= m; j++ )
-        matrix[0][j] = j;
+    const float dcart = similarity( m_artistSortname, rArtistname );
 
-    // Step 3
-    for ( int i = 1; i <= n; i++ )
-    {
-        const QChar s_i = source[i - 1];
+    // don't penalize for missing album name
+    float dcalb = 1.0;
+    if ( !m_albumSortname.isEmpty() && !rAlbumname.isEmpty() )
+        dcalb = similarity( m_albumSortname, rAlbumname );
 
-        // Step 4
-        for ( int j = 1; j <= m; j++ )
-        {
-            const QChar t_j = target[j - 1];
+    // weighted, so album match is worth less than track title.
+    // Work out how similar the track has to be to still reach minScore
+    const float trkNeeded = ( minScore * 10 - dcart * 4 - dcalb ) / 5;
+    if ( trkNeeded > 1.0 )
+        return ( dcart * 4 + dcalb + 5 ) / 10;
 
-            // Step 5
-            int cost;
-            if ( s_i == t_j )
-                cost = 0;
-            else
-                cost = 1;
-
-            // Step 6
-            const int above = matrix[i - 1][j];
-            const int left = matrix[i][j - 1];
-            const int diag = matrix[i - 1][j - 1];
-
-            int cell = ( ( ( left + 1 ) > ( diag + cost ) ) ? diag + cost : left + 1 );
-            if ( above + 1 < cell )
-                cell = above + 1;
-
-            // Step 6A: Cover transposition, in addition to deletion,
-            // insertion and substitution. This step is taken from:
-            // Berghel, Hal ; Roach, David : "An Extension of Ukkonen's
-            // Enhanced Dynamic Programming ASM Algorithm"
-            // (http://www.acm.org/~hlb/publications/asm/asm.html)
-            if ( i > 2 && j > 2 )
-            {
-                int trans = matrix[i - 2][j - 2] + 1;
+    const float dctrk = similarity( m_trackSortname, rTrackname, trkNeeded );
+    return ( dcart * 4 + dcalb + dctrk * 5 ) / 10;
+}
 
-                if ( source[ i - 2 ] != t_j ) trans++;
-                if ( s_i != target[ j - 2 ] ) trans++;
-                if ( cell > trans ) cell = trans;
-            }
-            matrix[i][j] = cell;
-        }
-    }
 
-    // Step 7
-    return matrix[n][m];
+QPair< Tomahawk::source_ptr, unsigned int >
+Query::playedBy() const
+{
+    return m_playedBy;
 }
@@ -50,6 +50,8 @@ friend class Pipeline;
 public:
     static query_ptr get( const QString& artist, const QString& track, const QString& album, const QID& qid = QString(), bool autoResolve = true );
     static query_ptr get( const QString& query, const QID& qid );
+    /// Number of queries currently registered, including ones about to be swept.
+    static unsigned int registrySize();
 
     explicit Query( const QString& artist, const QString& track, const QString& album, const QID& qid, bool autoResolve );
     explicit Query( const QString& query, const QID& qid );
@@ -75,7 +77,8 @@ public:
     QString fullTextQuery() const { return m_fullTextQuery; }
     bool isFullTextQuery() const { return !m_fullTextQuery.isEmpty(); }
     bool resolvingFinished() const { return m_resolveFinished; }
-    float howSimilar( const Tomahawk::result_ptr& r );
+    /// Scores below minScore may be cut short and are only upper bounds.
+    float howSimilar( const Tomahawk::result_ptr& r, float minScore = 0.0 );
 
     QPair< Tomahawk::source_ptr, unsigned int > playedBy() const;
     Tomahawk::Resolver* currentResolver() const;
@@ -121,10 +124,6 @@ public slots:
 
     void onResolvingFinished();
 
-    // resolve if not solved()
-    void onResolverAdded();
-    void onResolverRemoved();
-
 private slots:
     void onResultStatusChanged();
     void refreshResults();
@@ -132,6 +131,9 @@ private slots:
 private:
     Query();
 
+    /// The registered query with this id, or a null pointer if it is gone
+    static query_ptr registered( const QID& qid );
+
     void init();
 
     void setCurrentResolver( Tomahawk::Resolver* resolver );
@@ -139,7 +141,6 @@ private:
     void checkResults();
 
     void updateSortNames();
-    static int levenshtein( const QString& source, const QString& target );
 
     QList< Tomahawk::result_ptr > m_results;
     bool m_solved;
@@ -164,6 +165,12 @@ private:
     QList< QWeakPointer< Tomahawk::Resolver > > m_resolvers;
 
     mutable QMutex m_mutex;
+
+    // links in the Pipeline's index of unsolved queries, guarded by the Pipeline
+    Query* m_unsolvedPrev;
+    Query* m_unsolvedNext;
+    int m_unsolvedPriority; // -1 if not in the index
+    unsigned int m_unsolvedEpoch;
 };
 
 }; //ns
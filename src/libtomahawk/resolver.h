@@ -49,6 +49,10 @@ public:
     virtual QString name() const = 0;
     virtual unsigned int weight() const = 0;
     virtual unsigned int timeout() const = 0;
+    /// how many queries the Pipeline may have in flight with this resolver, 0 for its default
+    virtual unsigned int maxConcurrentQueries() const { return 0; }
+    /// for how many seconds the Pipeline keeps this resolver's results in its resolve cache, 0 to not cache them
+    virtual unsigned int resultCacheTtl() const { return 0; }
 
 public slots:
     virtual void resolve( const Tomahawk::query_ptr& query ) = 0;
@@ -82,6 +86,9 @@ public:
     virtual ErrorState error() const;
     virtual bool running() const = 0;
 
+    // web results rarely change, revalidating them once a day is plenty
+    virtual unsigned int resultCacheTtl() const { return 24 * 60 * 60; }
+
 public slots:
     virtual void start() = 0;
     virtual void stop() = 0;
@@ -21,32 +21,34 @@
 #include "album.h"
 #include "collection.h"
 #include "database/database.h"
-#include "database/databasecommand_resolve.h"
+#include "database/databaseimpl.h"
 #include "database/databasecommand_alltracks.h"
 #include "database/databasecommand_addfiles.h"
 #include "database/databasecommand_loadsocialactions.h"
 
 #include "utils/logger.h"
+#include "utils/weakregistry.h"
 
 using namespace Tomahawk;
 
-static QHash< QString, QWeakPointer< Result > > s_results;
-static QMutex s_mutex;
+static TomahawkUtils::WeakRegistry< QString, Result > s_results;
 
 
 Tomahawk::result_ptr
 Result::get( const QString& url )
 {
-    QMutexLocker lock( &s_mutex );
-    if ( s_results.contains( url ) )
-    {
-        return s_results.value( url );
-    }
+    result_ptr r = s_results.value( url );
+    if ( !r.isNull() )
+        return r;
+
+    return s_results.insert( url, result_ptr( new Result( url ) ) );
+}
 
-    result_ptr r = result_ptr( new Result( url ) );
-    s_results.insert( url, r );
 
-    return r;
+unsigned int
+Result::registrySize()
+{
+    return s_results.count();
 }
 
 
@@ -68,11 +70,7 @@ Result::Result( const QString& url )
 
 Result::~Result()
 {
-    QMutexLocker lock( &s_mutex );
-    if ( s_results.contains( m_url ) )
-    {
-        s_results.remove( m_url );
-    }
+    s_results.remove( m_url );
 }
 
 
@@ -263,6 +261,14 @@ Result::setAlbum( const Tomahawk::album_ptr& album )
 }
 
 
+void
+Result::setTrack( const QString& track )
+{
+    m_track = track;
+    m_trackSortname = DatabaseImpl::sortname( track );
+}
+
+
 void
 Result::setCollection( const Tomahawk::collection_ptr& collection )
 {
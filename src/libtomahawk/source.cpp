@@ -26,7 +26,6 @@
 #include "database/databasecommand_addsource.h"
 #include "database/databasecommand_collectionstats.h"
 #include "database/databasecommand_sourceoffline.h"
-#include "database/databasecommand_updatesearchindex.h"
 #include "database/database.h"
 
 #include <QCoreApplication>
@@ -35,6 +34,9 @@
 #include "utils/tomahawkutils.h"
 #include "database/databasecommand_socialaction.h"
 
+// synced commands handed to the database worker in one go
+#define MAX_COMMAND_BATCH 500
+
 using namespace Tomahawk;
 
 
@@ -353,23 +355,20 @@ Source::executeCommands()
 {
     if ( !m_cmds.isEmpty() )
     {
-        QList< QSharedPointer<DatabaseCommand> > cmdGroup;
-        QSharedPointer<DatabaseCommand> cmd = m_cmds.takeFirst();
-        while ( cmd->groupable() )
-        {
-            cmdGroup << cmd;
-            if ( !m_cmds.isEmpty() && m_cmds.first()->groupable() && m_cmds.first()->commandname() == cmd->commandname() )
-                cmd = m_cmds.takeFirst();
-            else
-                break;
-        }
+        // Hand the worker a whole run of commands at once. It applies
+        // consecutive groupable ones in a single transaction.
+        QList< QSharedPointer<DatabaseCommand> > cmdBatch;
+        while ( !m_cmds.isEmpty() && cmdBatch.count() < MAX_COMMAND_BATCH && m_cmds.first()->doesMutates() )
+            cmdBatch << m_cmds.takeFirst();
+
+        QSharedPointer<DatabaseCommand> cmd = cmdBatch.isEmpty() ? m_cmds.takeFirst() : cmdBatch.last();
 
         // return here when the last command finished
         connect( cmd.data(), SIGNAL( finished() ), SLOT( executeCommands() ) );
 
-        if ( cmdGroup.count() )
+        if ( cmdBatch.count() )
         {
-            Database::instance()->enqueue( cmdGroup );
+            Database::instance()->enqueue( cmdBatch );
         }
         else
         {
@@ -421,18 +420,12 @@ Source::reportSocialAttributesChanged( DatabaseCommand_SocialAction* action )
 void
 Source::updateTracks()
 {
-    {
-        DatabaseCommand* cmd = new DatabaseCommand_UpdateSearchIndex();
-        Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
-    }
-
-    {
-        // Re-calculate local db stats
-        DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( SourceList::instance()->get( id() ) );
-        connect( cmd, SIGNAL( done( QVariantMap ) ),
-                 this,  SLOT( setStats( QVariantMap ) ), Qt::QueuedConnection );
-        Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
-    }
+    // The search index is kept up to date by the commands adding and removing files,
+    // only re-calculate local db stats
+    DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( SourceList::instance()->get( id() ) );
+    connect( cmd, SIGNAL( done( QVariantMap ) ),
+             this,  SLOT( setStats( QVariantMap ) ), Qt::QueuedConnection );
+    Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
 }
 
 
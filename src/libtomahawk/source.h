@@ -33,7 +33,6 @@
 class ControlConnection;
 class DatabaseCommand_LogPlayback;
 class DatabaseCommand_SocialAction;
-class DatabaseCommand_UpdateSearchIndex;
 
 namespace Tomahawk
 {
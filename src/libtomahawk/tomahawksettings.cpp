@@ -24,6 +24,7 @@
 #endif
 
 #include <QDir>
+#include <QThread>
 
 #include "sip/SipHandler.h"
 #include "playlistinterface.h"
@@ -263,6 +264,20 @@ TomahawkSettings::infoSystemCacheVersion() const
 }
 
 
+qint64
+TomahawkSettings::infoSystemCacheMaxSize() const
+{
+    return value( "infosystemcachemaxsize", 256 * 1024 * 1024 ).toLongLong();
+}
+
+
+void
+TomahawkSettings::setInfoSystemCacheMaxSize( qint64 size )
+{
+    setValue( "infosystemcachemaxsize", size );
+}
+
+
 QStringList
 TomahawkSettings::scannerPaths()
 {
@@ -305,6 +320,21 @@ TomahawkSettings::setScannerTime( uint time )
 }
 
 
+uint
+TomahawkSettings::scannerThreads() const
+{
+    // reading tags is mostly waiting for the disk (or the NAS), so use a few more threads than cores
+    return value( "scanner/threads", qMax( 4, QThread::idealThreadCount() ) ).toUInt();
+}
+
+
+void
+TomahawkSettings::setScannerThreads( uint threads )
+{
+    setValue( "scanner/threads", threads );
+}
+
+
 bool
 TomahawkSettings::watchForChanges() const
 {
@@ -770,6 +800,34 @@ TomahawkSettings::setExternalPort(int externalPort)
 }
 
 
+int
+TomahawkSettings::streamWindowSize() const
+{
+    return value( "network/stream-window-size", 512 * 1024 ).toInt();
+}
+
+
+void
+TomahawkSettings::setStreamWindowSize( int bytes )
+{
+    setValue( "network/stream-window-size", bytes );
+}
+
+
+int
+TomahawkSettings::uploadRateLimit() const
+{
+    return value( "network/upload-rate-limit", 0 ).toInt();
+}
+
+
+void
+TomahawkSettings::setUploadRateLimit( int bytesPerSecond )
+{
+    setValue( "network/upload-rate-limit", bytesPerSecond );
+}
+
+
 QString
 TomahawkSettings::lastFmPassword() const
 {
@@ -50,8 +50,12 @@ public:
     bool hasScannerPaths() const;
     uint scannerTime() const;
     void setScannerTime( uint time );
+    uint scannerThreads() const; /// how many files get their tags read at once
+    void setScannerThreads( uint threads );
     uint infoSystemCacheVersion() const;
     void setInfoSystemCacheVersion( uint version );
+    qint64 infoSystemCacheMaxSize() const; /// in bytes, least recently used entries get evicted beyond that
+    void setInfoSystemCacheMaxSize( qint64 size );
 
     bool watchForChanges() const;
     void setWatchForChanges( bool watch );
@@ -130,6 +134,14 @@ public:
     int externalPort() const;
     void setExternalPort( int externalPort );
 
+    /// how many bytes of a stream to a peer may be on their way at once
+    int streamWindowSize() const;
+    void setStreamWindowSize( int bytes );
+
+    /// upload limit per peer in bytes per second, 0 for unlimited
+    int uploadRateLimit() const;
+    void setUploadRateLimit( int bytesPerSecond );
+
     QString proxyHost() const;
     void setProxyHost( const QString &host );
 
@@ -26,6 +26,7 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QDir>
 #include <QtCore/QMutex>
+#include <QtCore/QVarLengthArray>
 #include <QtGui/QLayout>
 #include <QtGui/QPainter>
 #include <QtGui/QPixmap>
@@ -840,4 +841,148 @@ quint64 infosystemRequestId()
     return result;
 }
 
+
+// Plain dynamic programming over three rows, used for patterns too long for
+// one machine word.
+static int
+editDistanceRows( const QChar* pattern, int m, const QChar* text, int n, int maxDistance )
+{
+    QVarLengthArray< int, 128 > prevPrev( m + 1 );
+    QVarLengthArray< int, 128 > prev( m + 1 );
+    QVarLengthArray< int, 128 > cur( m + 1 );
+    for ( int i = 0; i <= m; i++ )
+        prev[i] = i;
+
+    for ( int j = 1; j <= n; j++ )
+    {
+        cur[0] = j;
+        int rowMin = j;
+        const QChar c = text[j - 1];
+
+        for ( int i = 1; i <= m; i++ )
+        {
+            const int cost = ( pattern[i - 1] == c ) ? 0 : 1;
+            int v = qMin( qMin( prev[i] + 1, cur[i - 1] + 1 ), prev[i - 1] + cost );
+
+            // swapped adjacent characters
+            if ( i > 1 && j > 1 && pattern[i - 1] == text[j - 2] && pattern[i - 2] == c )
+                v = qMin( v, prevPrev[i - 2] + 1 );
+
+            cur[i] = v;
+            rowMin = qMin( rowMin, v );
+        }
+
+        if ( rowMin > maxDistance )
+            return maxDistance + 1;
+
+        for ( int i = 0; i <= m; i++ )
+        {
+            prevPrev[i] = prev[i];
+            prev[i] = cur[i];
+        }
+    }
+
+    return prev[m] > maxDistance ? maxDistance + 1 : prev[m];
+}
+
+
+int
+editDistance( const QString& a, const QString& b, int maxDistance )
+{
+    // distance is symmetric, so use the shorter string as the pattern
+    const QString& pattern = ( a.length() <= b.length() ) ? a : b;
+    const QString& text = ( a.length() <= b.length() ) ? b : a;
+    const int m = pattern.length();
+    const int n = text.length();
+
+    if ( maxDistance < 0 )
+        maxDistance = n;
+    if ( n - m > maxDistance )
+        return maxDistance + 1;
+    if ( m == 0 )
+        return n;
+
+    const QChar* pd = pattern.constData();
+    const QChar* td = text.constData();
+
+    if ( m > 64 )
+        return editDistanceRows( pd, m, td, n, maxDistance );
+
+    // Myers' bit-vector algorithm with Hyyrö's extension for transpositions:
+    // one bit per pattern position, one step per text character.
+    quint64 asciiPeq[128] = { 0 };
+    QVarLengthArray< QPair< ushort, quint64 >, 16 > otherPeq;
+
+    for ( int i = 0; i < m; i++ )
+    {
+        const ushort c = pd[i].unicode();
+        const quint64 bit = Q_UINT64_C( 1 ) << i;
+        if ( c < 128 )
+        {
+            asciiPeq[c] |= bit;
+            continue;
+        }
+
+        int k = 0;
+        for ( ; k < otherPeq.size(); k++ )
+        {
+            if ( otherPeq[k].first == c )
+            {
+                otherPeq[k].second |= bit;
+                break;
+            }
+        }
+        if ( k == otherPeq.size() )
+            otherPeq.append( qMakePair( c, bit ) );
+    }
+
+    const quint64 last = Q_UINT64_C( 1 ) << ( m - 1 );
+    quint64 pv = ~Q_UINT64_C( 0 );
+    quint64 mv = 0;
+    quint64 d0 = 0;
+    quint64 prevEq = 0;
+    int score = m;
+
+    for ( int j = 0; j < n; j++ )
+    {
+        const ushort c = td[j].unicode();
+        quint64 eq = 0;
+        if ( c < 128 )
+            eq = asciiPeq[c];
+        else
+        {
+            for ( int k = 0; k < otherPeq.size(); k++ )
+            {
+                if ( otherPeq[k].first == c )
+                {
+                    eq = otherPeq[k].second;
+                    break;
+                }
+            }
+        }
+
+        const quint64 tr = ( ( ~d0 & eq ) << 1 ) & prevEq;
+        d0 = ( ( ( eq & pv ) + pv ) ^ pv ) | eq | mv | tr;
+        quint64 ph = mv | ~( d0 | pv );
+        quint64 mh = pv & d0;
+
+        if ( ph & last )
+            score++;
+        else if ( mh & last )
+            score--;
+
+        ph = ( ph << 1 ) | 1;
+        mh = mh << 1;
+        pv = mh | ~( d0 | ph );
+        mv = ph & d0;
+        prevEq = eq;
+
+        // every remaining text character can lower the score by one at most
+        if ( score - ( n - j - 1 ) > maxDistance )
+            return maxDistance + 1;
+    }
+
+    return score > maxDistance ? maxDistance + 1 : score;
+}
+
 } // ns
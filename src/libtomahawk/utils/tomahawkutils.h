@@ -117,6 +117,11 @@ namespace TomahawkUtils
     DLLEXPORT bool removeDirectory( const QString& dir );
 
     DLLEXPORT quint64 infosystemRequestId();
+
+    /// Edit distance between a and b, counting a swap of two adjacent characters
+    /// as a single edit. With maxDistance >= 0 it gives up as soon as the
+    /// distance is known to exceed it and returns maxDistance + 1.
+    DLLEXPORT int editDistance( const QString& a, const QString& b, int maxDistance = -1 );
 }
 
 #endif // TOMAHAWKUTILS_H
@@ -0,0 +1,161 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Copyright 2010-2011, Christian Muehlhaeuser <muesli@tomahawk-player.org>
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEAKREGISTRY_H
+#define WEAKREGISTRY_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QWeakPointer>
+
+namespace TomahawkUtils
+{
+
+/**
+ * Hands out one shared object per key without keeping it alive.
+ *
+ * Keys are spread over a fixed number of shards, each behind its own
+ * read/write lock, so lookups from different threads rarely wait for each
+ * other. Objects are expected to remove() themselves when they get destroyed;
+ * anything left behind is swept out every few thousand inserts.
+ */
+template< typename Key, typename T >
+class WeakRegistry
+{
+public:
+    WeakRegistry() {}
+
+    QSharedPointer< T > value( const Key& key ) const
+    {
+        const Shard& shard = shardFor( key );
+        QReadLocker lock( &shard.lock );
+
+        return shard.entries.value( key ).toStrongRef();
+    }
+
+    /// Registers \a object for \a key, unless another one still lives there. Returns the registered object.
+    QSharedPointer< T > insert( const Key& key, const QSharedPointer< T >& object )
+    {
+        Shard& shard = shardFor( key );
+        QWriteLocker lock( &shard.lock );
+
+        QSharedPointer< T > existing = shard.entries.value( key ).toStrongRef();
+        if ( !existing.isNull() )
+            return existing;
+
+        add( shard, key, object );
+        return object;
+    }
+
+    /// Registers \a object for \a key, replacing whatever was there before.
+    void set( const Key& key, const QSharedPointer< T >& object )
+    {
+        Shard& shard = shardFor( key );
+        QWriteLocker lock( &shard.lock );
+
+        add( shard, key, object );
+    }
+
+    /// Drops the entry for \a key, if its object is gone. Meant to be called from T's destructor.
+    void remove( const Key& key )
+    {
+        Shard& shard = shardFor( key );
+        QWriteLocker lock( &shard.lock );
+
+        typename QHash< Key, QWeakPointer< T > >::iterator it = shard.entries.find( key );
+        if ( it != shard.entries.end() && it.value().isNull() )
+            shard.entries.erase( it );
+    }
+
+    /// Removes all entries of objects that are gone and returns how many there were.
+    int sweep()
+    {
+        int removed = 0;
+        for ( int i = 0; i < Shards; i++ )
+        {
+            QWriteLocker lock( &m_shards[i].lock );
+            removed += sweep( m_shards[i] );
+        }
+
+        return removed;
+    }
+
+    int count() const
+    {
+        int entries = 0;
+        for ( int i = 0; i < Shards; i++ )
+        {
+            QReadLocker lock( &m_shards[i].lock );
+            entries += m_shards[i].entries.count();
+        }
+
+        return entries;
+    }
+
+private:
+    enum { Shards = 16, SweepInterval = 4096 };
+
+    struct Shard
+    {
+        Shard() : inserts( 0 ) {}
+
+        mutable QReadWriteLock lock;
+        QHash< Key, QWeakPointer< T > > entries;
+        unsigned int inserts;
+    };
+
+    Shard& shardFor( const Key& key ) const
+    {
+        return m_shards[ qHash( key ) % Shards ];
+    }
+
+    void add( Shard& shard, const Key& key, const QSharedPointer< T >& object )
+    {
+        shard.entries.insert( key, object.toWeakRef() );
+
+        if ( ++shard.inserts % SweepInterval == 0 )
+            sweep( shard );
+    }
+
+    int sweep( Shard& shard )
+    {
+        int removed = 0;
+        typename QHash< Key, QWeakPointer< T > >::iterator it = shard.entries.begin();
+        while ( it != shard.entries.end() )
+        {
+            if ( it.value().isNull() )
+            {
+                it = shard.entries.erase( it );
+                removed++;
+            }
+            else
+                ++it;
+        }
+
+        return removed;
+    }
+
+    Q_DISABLE_COPY( WeakRegistry )
+
+    mutable Shard m_shards[Shards];
+};
+
+}
+
+#endif // WEAKREGISTRY_H
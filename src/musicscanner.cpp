@@ -19,6 +19,7 @@
 #include "musicscanner.h"
 
 #include <QCoreApplication>
+#include <QRunnable>
 
 #include "utils/tomahawkutils.h"
 #include "tomahawksettings.h"
@@ -32,9 +33,39 @@
 
 #include "utils/logger.h"
 
+// files per DatabaseCommand_AddFiles
+#define DEFAULT_BATCH_SIZE 1000
+// batches we let the database worker queue up before we stop reading more files
+#define MAX_PENDING_COMMITS 2
+
 using namespace Tomahawk;
 
 
+class TagReader : public QRunnable
+{
+public:
+    TagReader( MusicScanner* scanner, int seq, const QFileInfo& fi, const QString& mimetype )
+        : m_scanner( scanner )
+        , m_seq( seq )
+        , m_fileInfo( fi )
+        , m_mimetype( mimetype )
+    {
+    }
+
+    virtual void run()
+    {
+        const QVariant m = MusicScanner::readFile( m_fileInfo, m_mimetype );
+        QMetaObject::invokeMethod( m_scanner, "fileRead", Qt::QueuedConnection, Q_ARG( int, m_seq ), Q_ARG( QVariant, m ) );
+    }
+
+private:
+    MusicScanner* m_scanner;
+    int m_seq;
+    QFileInfo m_fileInfo;
+    QString m_mimetype;
+};
+
+
 void
 DirLister::go()
 {
@@ -43,6 +74,9 @@ DirLister::go()
         m_opcount++;
         QMetaObject::invokeMethod( this, "scanDir", Qt::QueuedConnection, Q_ARG( QDir, QDir( dir, 0 ) ), Q_ARG( int, 0 ) );
     }
+
+    if ( m_opcount == 0 )
+        emit finished( m_dirMtimes );
 }
 
 
@@ -53,7 +87,7 @@ DirLister::scanDir( QDir dir, int depth )
     {
         m_opcount--;
         if ( m_opcount == 0 )
-            emit finished();
+            emit finished( m_dirMtimes );
 
         return;
     }
@@ -65,11 +99,14 @@ DirLister::scanDir( QDir dir, int depth )
 
         m_opcount--;
         if ( m_opcount == 0 )
-            emit finished();
+            emit finished( m_dirMtimes );
 
         return;
     }
 
+    // stat the dir before listing it, so anything changing while we're at it gets noticed next time
+    m_dirMtimes.insert( dir.canonicalPath(), QFileInfo( dir.canonicalPath() ).lastModified().toUTC().toTime_t() );
+
     QFileInfoList dirs;
 
     dir.setFilter( QDir::Files | QDir::Readable | QDir::NoDotAndDotDot );
@@ -77,7 +114,19 @@ DirLister::scanDir( QDir dir, int depth )
     dirs = dir.entryInfoList();
 
     foreach ( const QFileInfo& di, dirs )
+    {
+        // wait for the scanner to catch up, instead of queueing up the whole collection
+        bool deleting = false;
+        while ( !m_credits->tryAcquire( 1, 100 ) )
+        {
+            if ( ( deleting = isDeleting() ) )
+                break;
+        }
+        if ( deleting )
+            break;
+
         emit fileToScan( di );
+    }
 
     dir.setFilter( QDir::Dirs | QDir::Readable | QDir::NoDotAndDotDot );
     dirs = dir.entryInfoList();
@@ -85,22 +134,37 @@ DirLister::scanDir( QDir dir, int depth )
     foreach ( const QFileInfo& di, dirs )
     {
         const QString canonical = di.canonicalFilePath();
+
+        // known subdirs of a changed dir haven't changed themselves. Dirs that are new
+        // to us however need to be listed entirely.
+        if ( m_mode == ScanManager::DirScan && depth == 0 &&
+             ( m_knownDirs.contains( canonical ) || m_dirs.contains( canonical ) ) )
+            continue;
+
         m_opcount++;
         QMetaObject::invokeMethod( this, "scanDir", Qt::QueuedConnection, Q_ARG( QDir, di.canonicalFilePath() ), Q_ARG( int, depth + 1 ) );
     }
 
     m_opcount--;
     if ( m_opcount == 0 )
-        emit finished();
+        emit finished( m_dirMtimes );
 }
 
 
-MusicScanner::MusicScanner( const QStringList& dirs, quint32 bs )
+MusicScanner::MusicScanner( ScanManager::ScanMode mode, const QStringList& dirs, quint32 bs )
     : QObject()
+    , m_mode( mode )
     , m_dirs( dirs )
-    , m_batchsize( bs )
+    , m_batchsize( bs ? bs : DEFAULT_BATCH_SIZE )
+    , m_nextFile( 0 )
+    , m_nextCollected( 0 )
+    , m_pendingCommits( 0 )
+    , m_listerFinished( false )
     , m_dirListerThreadController( 0 )
 {
+    m_readerPool.setMaxThreadCount( qMax( 1u, TomahawkSettings::instance()->scannerThreads() ) );
+    m_listerCredits = QSharedPointer< QSemaphore >( new QSemaphore( 2 * m_batchsize ) );
+
     m_ext2mime.insert( "mp3", TomahawkUtils::extensionToMimetype( "mp3" ) );
     m_ext2mime.insert( "ogg", TomahawkUtils::extensionToMimetype( "ogg" ) );
     m_ext2mime.insert( "mpc", TomahawkUtils::extensionToMimetype( "mpc" ) );
@@ -116,6 +180,10 @@ MusicScanner::~MusicScanner()
 {
     tDebug() << Q_FUNC_INFO;
 
+    if ( !m_dirLister.isNull() )
+        m_dirLister.data()->setIsDeleting();
+    m_readerPool.waitForDone();
+
     if ( !m_dirLister.isNull() )
     {
         m_dirListerThreadController->quit();;
@@ -134,22 +202,76 @@ MusicScanner::startScan()
     tDebug( LOGVERBOSE ) << "Loading mtimes...";
     m_scanned = m_skipped = 0;
     m_skippedFiles.clear();
+    m_listerFinished = false;
+    m_dirMtimes.clear();
 
+    if ( m_mode == ScanManager::DirScan )
+    {
+        // dirs that are gone don't get listed, but we still need to drop what was in there
+        QStringList dirs;
+        m_vanishedDirs.clear();
+        foreach ( const QString& dir, m_dirs )
+        {
+            QFileInfo fi( dir );
+            if ( fi.isDir() )
+                dirs << fi.canonicalFilePath();
+            else
+                m_vanishedDirs << QDir::cleanPath( dir );
+        }
+        m_dirs = dirs;
+
+        // we need to know which subdirs were there before, to only descend into new ones
+        if ( !m_dirs.isEmpty() )
+        {
+            DatabaseCommand_DirMtimes* cmd = new DatabaseCommand_DirMtimes( m_dirs );
+            connect( cmd, SIGNAL( done( QMap< QString, unsigned int > ) ),
+                        SLOT( setDirMtimes( QMap< QString, unsigned int > ) ) );
+
+            Database::instance()->enqueue( QSharedPointer< DatabaseCommand >( cmd ) );
+            return;
+        }
+    }
+
+    loadFileMtimes();
+}
+
+
+void
+MusicScanner::setDirMtimes( const QMap< QString, unsigned int >& m )
+{
+    m_knownDirs = m.keys().toSet();
+    loadFileMtimes();
+}
+
+
+void
+MusicScanner::loadFileMtimes()
+{
     // trigger the scan once we've loaded old filemtimes
     //FIXME: For multiple collection support make sure the right prefix gets passed in...or not...
     //bear in mind that simply passing in the top-level of a defined collection means it will not return items that need
     //to be removed that aren't in that root any longer -- might have to do the filtering in setMTimes based on strings
-    DatabaseCommand_FileMtimes *cmd = new DatabaseCommand_FileMtimes();
-    connect( cmd, SIGNAL( done( QMap< QString, QMap< unsigned int, unsigned int > > ) ),
-                SLOT( setFileMtimes( QMap< QString, QMap< unsigned int, unsigned int > > ) ) );
+    if ( m_mode == ScanManager::DirScan && m_dirs.isEmpty() && m_vanishedDirs.isEmpty() )
+    {
+        setFileMtimes( FileMtimes() );
+        return;
+    }
+
+    DatabaseCommand_FileMtimes *cmd;
+    if ( m_mode == ScanManager::DirScan )
+        cmd = new DatabaseCommand_FileMtimes( m_dirs, m_vanishedDirs );
+    else
+        cmd = new DatabaseCommand_FileMtimes();
+
+    connect( cmd, SIGNAL( done( FileMtimes ) ),
+                SLOT( setFileMtimes( FileMtimes ) ) );
 
     Database::instance()->enqueue( QSharedPointer< DatabaseCommand >( cmd ) );
-    return;
 }
 
 
 void
-MusicScanner::setFileMtimes( const QMap< QString, QMap< unsigned int, unsigned int > >& m )
+MusicScanner::setFileMtimes( const FileMtimes& m )
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO << m.count();
     m_filemtimes = m;
@@ -160,22 +282,22 @@ MusicScanner::setFileMtimes( const QMap< QString, QMap< unsigned int, unsigned i
 void
 MusicScanner::scan()
 {
-    tDebug( LOGEXTRA ) << "Num saved file mtimes from last scan:" << m_filemtimes.size();
+    tDebug( LOGEXTRA ) << "Num saved file mtimes from last scan:" << m_filemtimes.count();
 
     connect( this, SIGNAL( batchReady( QVariantList, QVariantList ) ),
                      SLOT( commitBatch( QVariantList, QVariantList ) ), Qt::DirectConnection );
 
     m_dirListerThreadController = new QThread( this );
 
-    m_dirLister = QWeakPointer< DirLister >( new DirLister( m_dirs ) );
+    m_dirLister = QWeakPointer< DirLister >( new DirLister( m_mode, m_dirs, m_knownDirs, m_listerCredits ) );
     m_dirLister.data()->moveToThread( m_dirListerThreadController );
 
     connect( m_dirLister.data(), SIGNAL( fileToScan( QFileInfo ) ),
                                    SLOT( scanFile( QFileInfo ) ), Qt::QueuedConnection );
 
     // queued, so will only fire after all dirs have been scanned:
-    connect( m_dirLister.data(), SIGNAL( finished() ),
-                                   SLOT( listerFinished() ), Qt::QueuedConnection );
+    connect( m_dirLister.data(), SIGNAL( finished( QMap< QString, unsigned int > ) ),
+                                   SLOT( listerFinished( QMap< QString, unsigned int > ) ), Qt::QueuedConnection );
 
     m_dirListerThreadController->start();
     QMetaObject::invokeMethod( m_dirLister.data(), "go" );
@@ -183,18 +305,41 @@ MusicScanner::scan()
 
 
 void
-MusicScanner::listerFinished()
+MusicScanner::listerFinished( const QMap< QString, unsigned int >& dirmtimes )
+{
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO;
+    m_dirMtimes = dirmtimes;
+
+    // wait for the files still being read
+    m_listerFinished = true;
+    collectFiles();
+}
+
+
+void
+MusicScanner::finish()
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO;
+    m_listerFinished = false;
 
     // any remaining stuff that wasnt emitted as a batch:
-    foreach( const QString& key, m_filemtimes.keys() )
-        m_filesToDelete << m_filemtimes[ key ].keys().first();
+    foreach( unsigned int id, m_filemtimes.remainingIds() )
+        m_filesToDelete << id;
+    m_filemtimes = FileMtimes();
 
     commitBatch( m_scannedfiles, m_filesToDelete );
     m_scannedfiles.clear();
     m_filesToDelete.clear();
 
+    // a full scan saw every dir there is, a dir scan only replaces what it went through
+    DatabaseCommand_DirMtimes* cmd;
+    if ( m_mode == ScanManager::DirScan )
+        cmd = new DatabaseCommand_DirMtimes( m_dirMtimes, m_vanishedDirs );
+    else
+        cmd = new DatabaseCommand_DirMtimes( m_dirMtimes );
+    Database::instance()->enqueue( QSharedPointer< DatabaseCommand >( cmd ) );
+    emit dirsScanned( m_dirMtimes.keys() );
+
     tDebug( LOGINFO ) << "Scanning complete, saving to database. "
                          "( scanned" << m_scanned << "skipped" << m_skipped << ")";
 
@@ -231,60 +376,103 @@ MusicScanner::commitBatch( const QVariantList& tracks, const QVariantList& delet
     {
         tDebug( LOGINFO ) << Q_FUNC_INFO << "adding" << tracks.length() << "tracks";
         source_ptr localsrc = SourceList::instance()->getLocal();
-        Database::instance()->enqueue(
-            QSharedPointer<DatabaseCommand>( new DatabaseCommand_AddFiles( tracks, localsrc ) )
-        );
+        DatabaseCommand_AddFiles* cmd = new DatabaseCommand_AddFiles( tracks, localsrc );
+        connect( cmd, SIGNAL( finished() ), SLOT( batchCommitted() ), Qt::QueuedConnection );
+
+        m_pendingCommits++;
+        Database::instance()->enqueue( QSharedPointer<DatabaseCommand>( cmd ) );
     }
 }
 
 
+void
+MusicScanner::batchCommitted()
+{
+    m_pendingCommits--;
+    collectFiles();
+}
+
+
 void
 MusicScanner::scanFile( const QFileInfo& fi )
 {
     tDebug() << Q_FUNC_INFO << " scanning file: " << fi.canonicalFilePath();
-    if ( m_filemtimes.contains( "file://" + fi.canonicalFilePath() ) )
+    unsigned int id, mtime;
+    if ( m_filemtimes.take( fi.canonicalFilePath(), &id, &mtime ) )
     {
-        if ( fi.lastModified().toUTC().toTime_t() == m_filemtimes.value( "file://" + fi.canonicalFilePath() ).values().first() )
+        if ( fi.lastModified().toUTC().toTime_t() == mtime )
         {
-            m_filemtimes.remove( "file://" + fi.canonicalFilePath() );
+            m_listerCredits->release();
             return;
         }
 
-        m_filesToDelete << m_filemtimes.value( "file://" + fi.canonicalFilePath() ).keys().first();
-        m_filemtimes.remove( "file://" + fi.canonicalFilePath() );
+        m_filesToDelete << id;
     }
 
-    QVariant m = readFile( fi );
-    if ( m.toMap().isEmpty() )
-        return;
-
-    m_scannedfiles << m;
-    if ( m_batchsize != 0 && (quint32)m_scannedfiles.length() >= m_batchsize )
+    const QString suffix = fi.suffix().toLower();
+    if ( !m_ext2mime.contains( suffix ) )
     {
-        emit batchReady( m_scannedfiles, m_filesToDelete );
-        m_scannedfiles.clear();
-        m_filesToDelete.clear();
+        m_skipped++; // invalid extension
+        m_listerCredits->release();
+        return;
     }
+
+    const int seq = m_nextFile++;
+    m_readingFiles.insert( seq, fi.canonicalFilePath() );
+    m_readerPool.start( new TagReader( this, seq, fi, m_ext2mime.value( suffix ) ) );
 }
 
 
-QVariant
-MusicScanner::readFile( const QFileInfo& fi )
+void
+MusicScanner::fileRead( int seq, const QVariant& m )
 {
-    const QString suffix = fi.suffix().toLower();
+    m_readFiles.insert( seq, m );
+    collectFiles();
+}
 
-    if ( !m_ext2mime.contains( suffix ) )
+
+void
+MusicScanner::collectFiles()
+{
+    // Stop collecting while the database is busy with earlier batches. The files being read
+    // then pile up here, which in turn stops the lister, as it runs out of credits.
+    while ( m_pendingCommits < MAX_PENDING_COMMITS && m_readFiles.contains( m_nextCollected ) )
     {
-        m_skipped++;
-        return QVariantMap(); // invalid extension
-    }
+        const QVariant m = m_readFiles.take( m_nextCollected );
+        const QString path = m_readingFiles.take( m_nextCollected );
+        m_nextCollected++;
+        m_listerCredits->release();
+
+        if ( m.toMap().isEmpty() )
+        {
+            m_skippedFiles << path;
+            m_skipped++;
+            continue;
+        }
 
-    if ( m_scanned )
+        m_scanned++;
         if ( m_scanned % 3 == 0 )
             SourceList::instance()->getLocal()->scanningProgress( m_scanned );
-    if ( m_scanned % 100 == 0 )
-        tDebug( LOGINFO ) << "Scan progress:" << m_scanned << fi.canonicalFilePath();
+        if ( m_scanned % 100 == 0 )
+            tDebug( LOGINFO ) << "Scan progress:" << m_scanned << path;
 
+        m_scannedfiles << m;
+        if ( (quint32)m_scannedfiles.length() >= m_batchsize )
+        {
+            emit batchReady( m_scannedfiles, m_filesToDelete );
+            m_scannedfiles.clear();
+            m_filesToDelete.clear();
+        }
+    }
+
+    if ( m_listerFinished && m_nextCollected == m_nextFile )
+        finish();
+}
+
+
+QVariant
+MusicScanner::readFile( const QFileInfo& fi, const QString& mimetype )
+{
     #ifdef COMPLEX_TAGLIB_FILENAME
         const wchar_t *encodedName = reinterpret_cast< const wchar_t * >( fi.canonicalFilePath().utf16() );
     #else
@@ -294,11 +482,7 @@ MusicScanner::readFile( const QFileInfo& fi )
 
     TagLib::FileRef f( encodedName );
     if ( f.isNull() || !f.tag() )
-    {
-        m_skippedFiles << fi.canonicalFilePath();
-        m_skipped++;
         return QVariantMap();
-    }
 
     int bitrate = 0;
     int duration = 0;
@@ -316,12 +500,9 @@ MusicScanner::readFile( const QFileInfo& fi )
     if ( artist.isEmpty() || track.isEmpty() )
     {
         // FIXME: do some clever filename guessing
-        m_skippedFiles << fi.canonicalFilePath();
-        m_skipped++;
         return QVariantMap();
     }
 
-    QString mimetype = m_ext2mime.value( suffix );
     QString url( "file://%1" );
 
     QVariantMap m;
@@ -338,6 +519,5 @@ MusicScanner::readFile( const QFileInfo& fi )
     m["year"]         = tag->year();
     m["hash"]         = ""; // TODO
 
-    m_scanned++;
     return m;
 }
@@ -20,6 +20,7 @@
 #define MUSICSCANNER_H
 
 #include <tomahawksettings.h>
+#include "scanmanager.h"
 
 /* taglib */
 #include <taglib/fileref.h>
@@ -34,9 +35,13 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QWeakPointer>
+#include <QSharedPointer>
+#include <QSemaphore>
+#include <QSet>
+#include <QThreadPool>
 
-// descend dir tree comparing dir mtimes to last known mtime
-// emit signal for any dir with new content, so we can scan it.
+// descend dir tree, emitting every file found so the scanner can compare its mtime.
+// In DirScan mode only the given dirs are listed, plus any subdirs we didn't know about yet.
 // finally, emit the list of new mtimes we observed.
 class DirLister : public QObject
 {
@@ -44,8 +49,8 @@ Q_OBJECT
 
 public:
 
-    DirLister( const QStringList& dirs )
-        : QObject(), m_dirs( dirs ), m_opcount( 0 ), m_deleting( false )
+    DirLister( ScanManager::ScanMode mode, const QStringList& dirs, const QSet< QString >& knownDirs, const QSharedPointer< QSemaphore >& credits )
+        : QObject(), m_mode( mode ), m_dirs( dirs ), m_knownDirs( knownDirs ), m_credits( credits ), m_opcount( 0 ), m_deleting( false )
     {
         qDebug() << Q_FUNC_INFO;
     }
@@ -60,14 +65,19 @@ public:
 
 signals:
     void fileToScan( QFileInfo );
-    void finished();
+    void finished( const QMap< QString, unsigned int >& dirmtimes );
 
 private slots:
     void go();
     void scanDir( QDir dir, int depth );
 
 private:
+    ScanManager::ScanMode m_mode;
     QStringList m_dirs;
+    QSet< QString > m_knownDirs;
+    QMap< QString, unsigned int > m_dirMtimes;
+    // one per file we may hand to the scanner before it has caught up
+    QSharedPointer< QSemaphore > m_credits;
 
     uint m_opcount;
     QMutex m_deletingMutex;
@@ -80,39 +90,63 @@ class MusicScanner : public QObject
 Q_OBJECT
 
 public:
-    MusicScanner( const QStringList& dirs, quint32 bs = 0 );
+    MusicScanner( ScanManager::ScanMode mode, const QStringList& dirs, quint32 bs = 0 );
     ~MusicScanner();
 
+    // thread-safe, called by the tag reading pool. Returns an empty map if the file has no usable tags
+    static QVariant readFile( const QFileInfo& fi, const QString& mimetype );
+
 signals:
     //void fileScanned( QVariantMap );
     void finished();
     void batchReady( const QVariantList&, const QVariantList& );
+    // every directory the lister went through
+    void dirsScanned( const QStringList& dirs );
 
 private:
-    QVariant readFile( const QFileInfo& fi );
+    void collectFiles();
+    void finish();
 
 private slots:
-    void listerFinished();
+    void listerFinished( const QMap< QString, unsigned int >& dirmtimes );
     void scanFile( const QFileInfo& fi );
-    void setFileMtimes( const QMap< QString, QMap< unsigned int, unsigned int > >& m );
+    void fileRead( int seq, const QVariant& m );
+    void batchCommitted();
+    void setDirMtimes( const QMap< QString, unsigned int >& m );
+    void loadFileMtimes();
+    void setFileMtimes( const FileMtimes& m );
     void startScan();
     void scan();
     void commitBatch( const QVariantList& tracks, const QVariantList& deletethese );
 
 private:
+    ScanManager::ScanMode m_mode;
     QStringList m_dirs;
+    QStringList m_vanishedDirs;
+    QSet< QString > m_knownDirs;
+    QMap< QString, unsigned int > m_dirMtimes;
     QMap<QString, QString> m_ext2mime; // eg: mp3 -> audio/mpeg
     unsigned int m_scanned;
     unsigned int m_skipped;
 
     QList<QString> m_skippedFiles;
 
-    QMap<QString, QMap< unsigned int, unsigned int > > m_filemtimes;
+    FileMtimes m_filemtimes;
 
     QVariantList m_scannedfiles;
     QVariantList m_filesToDelete;
     quint32 m_batchsize;
 
+    // Tags are read in parallel, but collected in the order the lister found the files
+    QThreadPool m_readerPool;
+    QSharedPointer< QSemaphore > m_listerCredits;
+    int m_nextFile;                 // sequence number of the next file handed to the pool
+    int m_nextCollected;            // the file we're waiting for to collect next
+    QHash< int, QString > m_readingFiles;
+    QHash< int, QVariant > m_readFiles;
+    unsigned int m_pendingCommits;  // batches the database hasn't added yet
+    bool m_listerFinished;
+
     QWeakPointer< DirLister > m_dirLister;
     QThread* m_dirListerThreadController;
 };
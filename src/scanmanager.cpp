@@ -23,16 +23,23 @@
 #include <QTimer>
 
 #include "musicscanner.h"
+#include "dirwatcher.h"
 #include "tomahawksettings.h"
 #include "utils/tomahawkutils.h"
 #include "libtomahawk/sourcelist.h"
 
 #include "database/database.h"
+#include "database/databasecommand_dirmtimes.h"
 #include "database/databasecommand_filemtimes.h"
 #include "database/databasecommand_deletefiles.h"
 
 #include "utils/logger.h"
 
+// wait for changes to settle before scanning, e.g. while an album is being copied
+#define QUEUE_SETTLE_MS 5000
+// but don't keep on waiting forever when something keeps writing
+#define QUEUE_MAX_DELAY_MS 60000
+
 ScanManager* ScanManager::s_instance = 0;
 
 
@@ -47,6 +54,8 @@ ScanManager::ScanManager( QObject* parent )
     : QObject( parent )
     , m_musicScannerThreadController( 0 )
     , m_currScannerPaths()
+    , m_currScanMode( FullScan )
+    , m_watcher( 0 )
 {
     s_instance = this;
 
@@ -54,13 +63,17 @@ ScanManager::ScanManager( QObject* parent )
     m_scanTimer->setSingleShot( false );
     m_scanTimer->setInterval( TomahawkSettings::instance()->scannerTime() * 1000 );
 
+    m_queueTimer = new QTimer( this );
+    m_queueTimer->setSingleShot( true );
+    m_queueTimer->setInterval( QUEUE_SETTLE_MS );
+
     connect( TomahawkSettings::instance(), SIGNAL( changed() ), SLOT( onSettingsChanged() ) );
     connect( m_scanTimer, SIGNAL( timeout() ), SLOT( scanTimerTimeout() ) );
+    connect( m_queueTimer, SIGNAL( timeout() ), SLOT( runQueuedScan() ) );
 
     if ( TomahawkSettings::instance()->hasScannerPaths() )
     {
         m_currScannerPaths = TomahawkSettings::instance()->scannerPaths();
-        m_scanTimer->start();
         if ( TomahawkSettings::instance()->watchForChanges() )
             QTimer::singleShot( 1000, this, SLOT( runStartupScan() ) );
     }
@@ -87,20 +100,23 @@ ScanManager::~ScanManager()
 void
 ScanManager::onSettingsChanged()
 {
-    if ( !TomahawkSettings::instance()->watchForChanges() && m_scanTimer->isActive() )
+    if ( !TomahawkSettings::instance()->watchForChanges() )
+    {
         m_scanTimer->stop();
+        stopWatching();
+    }
 
     m_scanTimer->setInterval( TomahawkSettings::instance()->scannerTime() * 1000 );
 
     if ( TomahawkSettings::instance()->hasScannerPaths() &&
         m_currScannerPaths != TomahawkSettings::instance()->scannerPaths() )
     {
+        // the full scan sets up the watches again once it's done
         m_currScannerPaths = TomahawkSettings::instance()->scannerPaths();
         runScan();
     }
-
-    if ( TomahawkSettings::instance()->watchForChanges() && !m_scanTimer->isActive() )
-        m_scanTimer->start();
+    else if ( TomahawkSettings::instance()->watchForChanges() && !m_watcher && !m_scanTimer->isActive() )
+        startWatching();
 }
 
 
@@ -111,7 +127,144 @@ ScanManager::runStartupScan()
     if ( !Database::instance() || ( Database::instance() && !Database::instance()->isReady() ) )
         QTimer::singleShot( 1000, this, SLOT( runStartupScan() ) );
     else
+        startWatching();
+}
+
+
+void
+ScanManager::startWatching()
+{
+    if ( !DirWatcher::isSupported() )
+    {
+        // nothing to watch with, rescan everything every now and then
+        runScan();
+        return;
+    }
+
+    // find out what we've scanned before, so we neither have to walk the whole tree to set up
+    // the watches nor stat every file to catch up with what changed while we weren't running
+    DatabaseCommand_DirMtimes* cmd = new DatabaseCommand_DirMtimes();
+    connect( cmd, SIGNAL( done( QMap< QString, unsigned int > ) ),
+                SLOT( dirMtimesLoaded( QMap< QString, unsigned int > ) ) );
+
+    Database::instance()->enqueue( QSharedPointer< DatabaseCommand >( cmd ) );
+}
+
+
+void
+ScanManager::stopWatching()
+{
+    delete m_watcher;
+    m_watcher = 0;
+
+    m_queueTimer->stop();
+    m_queuedDirs.clear();
+}
+
+
+void
+ScanManager::dirMtimesLoaded( const QMap< QString, unsigned int >& mtimes )
+{
+    if ( !TomahawkSettings::instance()->watchForChanges() )
+        return;
+
+    // never scanned, or a new collection dir: the full scan gets us the dirs to watch when it's done
+    bool fullScan = mtimes.isEmpty();
+    foreach ( const QString& path, TomahawkSettings::instance()->scannerPaths() )
+    {
+        QFileInfo fi( path );
+        if ( fi.isDir() && !mtimes.contains( fi.canonicalFilePath() ) )
+            fullScan = true;
+    }
+
+    if ( fullScan )
+    {
         runScan();
+        return;
+    }
+
+    // a dir's mtime changes when entries get added or removed, which covers new albums and
+    // deleted tracks. Files that got rewritten in place while we weren't running go unnoticed
+    // until the next full scan.
+    QStringList dirs;
+    QMap< QString, unsigned int >::const_iterator it = mtimes.constBegin();
+    for ( ; it != mtimes.constEnd(); ++it )
+    {
+        QFileInfo fi( it.key() );
+        if ( !fi.isDir() )
+        {
+            queueDir( it.key() );
+            continue;
+        }
+
+        dirs << it.key();
+        if ( fi.lastModified().toUTC().toTime_t() != it.value() )
+            queueDir( it.key() );
+    }
+
+    tDebug() << "Watching" << dirs.count() << "dirs," << m_queuedDirs.count() << "changed since the last scan";
+    watchDirs( dirs );
+}
+
+
+void
+ScanManager::watchDirs( const QStringList& dirs )
+{
+    if ( !m_watcher )
+    {
+        m_watcher = new DirWatcher( this );
+        connect( m_watcher, SIGNAL( dirChanged( QString ) ), SLOT( dirChanged( QString ) ) );
+        connect( m_watcher, SIGNAL( overflow() ), SLOT( runScan() ) );
+    }
+
+    if ( !m_watcher->addDirs( dirs ) )
+    {
+        tLog() << "Can't watch all dirs of the collection for changes, falling back to rescanning every"
+               << TomahawkSettings::instance()->scannerTime() << "seconds";
+
+        stopWatching();
+        m_scanTimer->start();
+    }
+}
+
+
+void
+ScanManager::dirChanged( const QString& dir )
+{
+    queueDir( dir );
+}
+
+
+void
+ScanManager::queueDir( const QString& dir )
+{
+    if ( m_queuedDirs.isEmpty() )
+        m_queuedSince.start();
+
+    m_queuedDirs << dir;
+
+    // restart the timer with every change, unless we've been holding back changes for too long
+    if ( m_queuedSince.elapsed() < QUEUE_MAX_DELAY_MS || !m_queueTimer->isActive() )
+        m_queueTimer->start();
+}
+
+
+void
+ScanManager::runQueuedScan()
+{
+    if ( m_queuedDirs.isEmpty() )
+        return;
+
+    // a running scan restarts the queue when it's done
+    if ( !Database::instance() || !Database::instance()->isReady() ||
+         m_musicScannerThreadController || !m_scanner.isNull() )
+        return;
+
+    const QStringList dirs = m_queuedDirs.toList();
+    m_queuedDirs.clear();
+
+    tDebug() << Q_FUNC_INFO << "Rescanning" << dirs.count() << "changed dirs";
+    startScanner( DirScan, dirs );
 }
 
 
@@ -148,8 +301,8 @@ ScanManager::runScan( bool manualFull )
         }
 
         DatabaseCommand_FileMtimes *cmd = new DatabaseCommand_FileMtimes( true );
-        connect( cmd, SIGNAL( done( const QMap< QString, QMap< unsigned int, unsigned int > >& ) ),
-                    SLOT( fileMtimesCheck( const QMap< QString, QMap< unsigned int, unsigned int > >& ) ) );
+        connect( cmd, SIGNAL( done( FileMtimes ) ),
+                    SLOT( fileMtimesCheck( FileMtimes ) ) );
 
         Database::instance()->enqueue( QSharedPointer< DatabaseCommand >( cmd ) );
     }
@@ -162,7 +315,7 @@ ScanManager::runScan( bool manualFull )
 
 
 void
-ScanManager::fileMtimesCheck( const QMap< QString, QMap< unsigned int, unsigned int > >& mtimes )
+ScanManager::fileMtimesCheck( const FileMtimes& mtimes )
 {
     if ( !mtimes.isEmpty() && TomahawkSettings::instance()->scannerPaths().isEmpty() )
     {
@@ -196,14 +349,22 @@ ScanManager::runDirScan()
     if ( !Database::instance() || ( Database::instance() && !Database::instance()->isReady() ) )
         return;
 
-    QStringList paths = TomahawkSettings::instance()->scannerPaths();
+    startScanner( FullScan, TomahawkSettings::instance()->scannerPaths() );
+}
+
 
+void
+ScanManager::startScanner( ScanMode mode, const QStringList& paths )
+{
     if ( !m_musicScannerThreadController && m_scanner.isNull() ) //still running if these are not zero
     {
         m_scanTimer->stop();
+        m_currScanMode = mode;
+        m_currScanDirs = paths;
         m_musicScannerThreadController = new QThread( this );
-        m_scanner = QWeakPointer< MusicScanner>( new MusicScanner( paths ) );
+        m_scanner = QWeakPointer< MusicScanner>( new MusicScanner( mode, paths ) );
         m_scanner.data()->moveToThread( m_musicScannerThreadController );
+        connect( m_scanner.data(), SIGNAL( dirsScanned( QStringList ) ), SLOT( dirsScanned( QStringList ) ) );
         connect( m_scanner.data(), SIGNAL( finished() ), SLOT( scannerFinished() ) );
         m_musicScannerThreadController->start( QThread::IdlePriority );
         QMetaObject::invokeMethod( m_scanner.data(), "startScan" );
@@ -216,6 +377,52 @@ ScanManager::runDirScan()
 }
 
 
+void
+ScanManager::dirsScanned( const QStringList& dirs )
+{
+    if ( !TomahawkSettings::instance()->watchForChanges() || !DirWatcher::isSupported() )
+        return;
+
+    if ( m_currScanMode == FullScan )
+    {
+        // we just went through everything, so stop watching whatever we didn't find. The
+        // watches on the others stay, and so do the changes queued during the scan.
+        if ( m_watcher )
+        {
+            const QSet< QString > found = dirs.toSet();
+            foreach ( const QString& watched, m_watcher->dirs() )
+            {
+                if ( !found.contains( watched ) )
+                    m_watcher->removeDir( watched );
+            }
+        }
+    }
+    else if ( m_watcher )
+    {
+        // stop watching dirs that are gone, and whatever was below them
+        foreach ( const QString& dir, m_currScanDirs )
+        {
+            if ( QFileInfo( dir ).isDir() )
+                continue;
+
+            const QString path = QDir::cleanPath( dir );
+            foreach ( const QString& watched, m_watcher->dirs() )
+            {
+                if ( watched == path || watched.startsWith( path + "/" ) )
+                    m_watcher->removeDir( watched );
+            }
+        }
+    }
+    else
+    {
+        // fell back to the timer already
+        return;
+    }
+
+    watchDirs( dirs );
+}
+
+
 void
 ScanManager::scannerFinished()
 {
@@ -228,7 +435,12 @@ ScanManager::scannerFinished()
         delete m_musicScannerThreadController;
         m_musicScannerThreadController = 0;
     }
-    m_scanTimer->start();
+    // only rescan on a timer when we can't watch for changes
+    if ( TomahawkSettings::instance()->watchForChanges() && !m_watcher )
+        m_scanTimer->start();
+    else if ( !m_queuedDirs.isEmpty() && !m_queueTimer->isActive() )
+        m_queueTimer->start();
+
     SourceList::instance()->getLocal()->scanningFinished( 0 );
     emit finished();
 }
@@ -20,6 +20,7 @@
 #define SCANMANAGER_H
 
 #include "typedefs.h"
+#include "database/filemtimes.h"
 
 #include <QHash>
 #include <QMap>
@@ -27,10 +28,11 @@
 #include <QStringList>
 #include <QWeakPointer>
 #include <QSet>
+#include <QTime>
 
+class DirWatcher;
 class MusicScanner;
 class QThread;
-class QFileSystemWatcher;
 class QTimer;
 
 class ScanManager : public QObject
@@ -38,6 +40,8 @@ class ScanManager : public QObject
 Q_OBJECT
 
 public:
+    enum ScanMode { FullScan, DirScan };
+
     static ScanManager* instance();
 
     explicit ScanManager( QObject* parent = 0 );
@@ -58,17 +62,37 @@ private slots:
 
     void onSettingsChanged();
 
-    void fileMtimesCheck( const QMap< QString, QMap< unsigned int, unsigned int > >& mtimes );
+    void fileMtimesCheck( const FileMtimes& mtimes );
     void filesDeleted( const QStringList& files, const Tomahawk::collection_ptr& collection );
 
+    void dirMtimesLoaded( const QMap< QString, unsigned int >& mtimes );
+    void dirChanged( const QString& dir );
+    void runQueuedScan();
+    void dirsScanned( const QStringList& dirs );
+
 private:
+    void startScanner( ScanMode mode, const QStringList& paths );
+
+    void startWatching();
+    void stopWatching();
+    void watchDirs( const QStringList& dirs );
+    void queueDir( const QString& dir );
+
     static ScanManager* s_instance;
 
     QWeakPointer< MusicScanner > m_scanner;
     QThread* m_musicScannerThreadController;
     QStringList m_currScannerPaths;
+    ScanMode m_currScanMode;
+    QStringList m_currScanDirs;
 
     QTimer* m_scanTimer;
+
+    // only set while watching for changes. If it can't watch every dir we fall back to m_scanTimer
+    DirWatcher* m_watcher;
+    QSet< QString > m_queuedDirs;
+    QTimer* m_queueTimer;
+    QTime m_queuedSince;
 };
 
 #endif
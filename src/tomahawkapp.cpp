@@ -25,6 +25,7 @@
 #include <QtCore/QDir>
 #include <QtCore/QMetaType>
 #include <QtCore/QTime>
+#include <QtCore/QTimer>
 #include <QtNetwork/QNetworkReply>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
@@ -37,7 +38,9 @@
 #include "database/database.h"
 #include "database/databasecollection.h"
 #include "database/databasecommand_collectionstats.h"
+#include "database/databasecommand_trackpage.h"
 #include "database/databaseresolver.h"
+#include "database/filemtimes.h"
 #include "sip/SipHandler.h"
 #include "playlist/dynamic/GeneratorFactory.h"
 #include "playlist/dynamic/echonest/EchonestGenerator.h"
@@ -140,6 +143,8 @@ TomahawkApp::init()
     qsrand( QTime( 0, 0, 0 ).secsTo( QTime::currentTime() ) );
 
     tLog() << "Starting Tomahawk...";
+    m_startupTime.start();
+    m_lastStartupPhase = 0;
 
 #ifdef ENABLE_HEADLESS
     m_headless = true;
@@ -166,17 +171,21 @@ TomahawkApp::init()
     tDebug( LOGINFO ) << "Setting NAM.";
     // Cause the creation of the nam, but don't need to address it directly, so prevent warning
     Q_UNUSED( TomahawkUtils::nam() );
+    startupPhase( "settings" );
+
+    // The database gets opened in the background, nothing up to the local
+    // collection needs it, so set everything else up meanwhile.
+    new Pipeline( this );
+    tDebug() << "Init Database.";
+    initDatabase();
 
     m_audioEngine = QWeakPointer<AudioEngine>( new AudioEngine );
     m_scanManager = QWeakPointer<ScanManager>( new ScanManager( this ) );
-    new Pipeline( this );
+    startupPhase( "audio engine" );
 
     m_servent = QWeakPointer<Servent>( new Servent( this ) );
     connect( m_servent.data(), SIGNAL( ready() ), SLOT( initSIP() ) );
 
-    tDebug() << "Init Database.";
-    initDatabase();
-
     QByteArray magic = QByteArray::fromBase64( enApiSecret );
     QByteArray wand = QByteArray::fromBase64( QCoreApplication::applicationName().toLatin1() );
     int length = magic.length(), n2 = wand.length();
@@ -212,14 +221,12 @@ TomahawkApp::init()
         connect( m_shortcutHandler.data(), SIGNAL( mute() ), m_audioEngine.data(), SLOT( mute() ) );
     }
 
+    // its plugins are loaded on the info system's own worker thread
     tDebug() << "Init InfoSystem.";
     m_infoSystem = QWeakPointer<Tomahawk::InfoSystem::InfoSystem>( new Tomahawk::InfoSystem::InfoSystem( this ) );
+    startupPhase( "info system" );
 
-    Echonest::Config::instance()->setNetworkAccessManager( TomahawkUtils::nam() );
 #ifndef ENABLE_HEADLESS
-    EchonestGenerator::setupCatalogs();
-
-
     if ( !m_headless )
     {
         tDebug() << "Init MainWindow.";
@@ -231,12 +238,40 @@ TomahawkApp::init()
             m_mainwindow->show();
         }
     }
+    startupPhase( "main window" );
 #endif
 
     tDebug() << "Init Local Collection.";
     initLocalCollection();
     tDebug() << "Init Pipeline.";
     initPipeline();
+    startupPhase( "local collection" );
+
+#ifndef ENABLE_HEADLESS
+    if ( !s->hasScannerPaths() )
+    {
+        m_mainwindow->showSettingsDialog();
+    }
+
+    // Make sure to init GAM in the gui thread
+    GlobalActionManager::instance();
+#endif
+
+#ifdef Q_WS_MAC
+    // Make sure to do this after main window is inited
+    Tomahawk::enableFullscreen();
+#endif
+
+    // whatever the first view doesn't need is set up once we're back in the event loop
+    QTimer::singleShot( 0, this, SLOT( initLazy() ) );
+}
+
+
+void
+TomahawkApp::initLazy()
+{
+    tDebug() << "Init Script Resolvers.";
+    initScriptResolvers();
 
 #ifdef LIBATTICA_FOUND
 #ifndef ENABLE_HEADLESS
@@ -250,13 +285,6 @@ TomahawkApp::init()
         initHTTP();
     }
 
-#ifndef ENABLE_HEADLESS
-    if ( !s->hasScannerPaths() )
-    {
-        m_mainwindow->showSettingsDialog();
-    }
-#endif
-
 #ifdef LIBLASTFM_FOUND
     tDebug() << "Init Scrobbler.";
     m_scrobbler = new Scrobbler( this );
@@ -267,22 +295,30 @@ TomahawkApp::init()
         m_scanManager.data()->runScan( true );
     }
 
+    Echonest::Config::instance()->setNetworkAccessManager( TomahawkUtils::nam() );
+#ifndef ENABLE_HEADLESS
+    EchonestGenerator::setupCatalogs();
+#endif
+
     // Set up echonest catalog synchronizer
     Tomahawk::EchonestCatalogSynchronizer::instance();
 
 #ifndef ENABLE_HEADLESS
-    // Make sure to init GAM in the gui thread
-    GlobalActionManager::instance();
-
     // check if our spotify playlist api server is up and running, and enable spotify playlist drops if so
     QNetworkReply* r = TomahawkUtils::nam()->get( QNetworkRequest( QUrl( SPOTIFY_PLAYLIST_API_URL "/playlist/test" ) ) );
     connect( r, SIGNAL( finished() ), this, SLOT( spotifyApiCheckFinished() ) );
 #endif
 
-#ifdef Q_WS_MAC
-    // Make sure to do this after main window is inited
-    Tomahawk::enableFullscreen();
-#endif
+    startupPhase( "deferred init" );
+}
+
+
+void
+TomahawkApp::startupPhase( const QString& phase )
+{
+    const int elapsed = m_startupTime.elapsed();
+    tLog() << "Startup:" << phase << "done after" << elapsed << "ms, +" << elapsed - m_lastStartupPhase << "ms";
+    m_lastStartupPhase = elapsed;
 }
 
 
@@ -379,7 +415,8 @@ TomahawkApp::registerMetaTypes()
     qRegisterMetaType< QMap<QString, unsigned int> >("QMap<QString, unsigned int>");
     qRegisterMetaType< QMap< QString, plentry_ptr > >("QMap< QString, plentry_ptr >");
     qRegisterMetaType< QHash< QString, QMap<quint32, quint16> > >("QHash< QString, QMap<quint32, quint16> >");
-    qRegisterMetaType< QMap< QString, QMap< unsigned int, unsigned int > > >("QMap< QString, QMap< unsigned int, unsigned int > >");
+    qRegisterMetaType< FileMtimes >("FileMtimes");
+    qRegisterMetaType< TrackPage >("TrackPage");
     qRegisterMetaType< PairList >("PairList");
 
     qRegisterMetaType< GeneratorMode>("GeneratorMode");
@@ -438,10 +475,37 @@ TomahawkApp::initDatabase()
 
     tDebug( LOGEXTRA ) << "Using database:" << dbpath;
     m_database = QWeakPointer<Database>( new Database( dbpath, this ) );
+    connect( m_database.data(), SIGNAL( opened() ), SLOT( onDatabaseOpened() ) );
+    connect( m_database.data(), SIGNAL( openFailed() ), SLOT( onDatabaseOpenFailed() ) );
+    connect( m_database.data(), SIGNAL( indexReady() ), SLOT( onIndexLoaded() ) );
+
     Pipeline::instance()->databaseReady();
 }
 
 
+void
+TomahawkApp::onDatabaseOpened()
+{
+    startupPhase( "database opened" );
+}
+
+
+void
+TomahawkApp::onDatabaseOpenFailed()
+{
+    // there is nothing we could do without the collection db
+    tLog() << "Could not open the database, quitting";
+    QMetaObject::invokeMethod( this, "quit", Qt::QueuedConnection );
+}
+
+
+void
+TomahawkApp::onIndexLoaded()
+{
+    startupPhase( "search index loaded" );
+}
+
+
 void
 TomahawkApp::initHTTP()
 {
@@ -463,7 +527,12 @@ TomahawkApp::initPipeline()
 {
     // setup resolvers for local content, and (cached) remote collection content
     Pipeline::instance()->addResolver( new DatabaseResolver( 100 ) );
-    // load script resolvers
+}
+
+
+void
+TomahawkApp::initScriptResolvers()
+{
     QStringList enabled = TomahawkSettings::instance()->enabledScriptResolvers();
     foreach ( QString resolver, TomahawkSettings::instance()->allScriptResolvers() )
     {
@@ -497,6 +566,7 @@ TomahawkApp::initLocalCollection()
 void
 TomahawkApp::initServent()
 {
+    startupPhase( "sources loaded" );
     tDebug() << "Init Servent.";
 
     bool upnp = !arguments().contains( "--noupnp" ) && TomahawkSettings::instance()->value( "network/upnp", true ).toBool() && !TomahawkSettings::instance()->preferStaticHostPort();
@@ -512,6 +582,8 @@ TomahawkApp::initServent()
 void
 TomahawkApp::initSIP()
 {
+    startupPhase( "servent listening" );
+
     //FIXME: jabber autoconnect is really more, now that there is sip -- should be renamed and/or split out of jabber-specific settings
     if ( !arguments().contains( "--nosip" ) )
     {
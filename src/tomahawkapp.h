@@ -29,6 +29,7 @@
 #include <QtCore/QSettings>
 #include <QtCore/QDir>
 #include <QtCore/QPersistentModelIndex>
+#include <QtCore/QTime>
 
 #include "QxtHttpServerConnector"
 #include "QxtHttpSessionManager"
@@ -94,9 +95,14 @@ public slots:
     void instanceStarted( KDSingleApplicationGuard::Instance );
 
 private slots:
+    void initLazy();
     void initServent();
     void initSIP();
 
+    void onDatabaseOpened();
+    void onDatabaseOpenFailed();
+    void onIndexLoaded();
+
     void spotifyApiCheckFinished();
 
 private:
@@ -104,13 +110,17 @@ private:
 
     void printHelp();
 
-    // Start-up order: database, collection, pipeline, servent, http
+    // Start-up order: database (opened in the background), collection, pipeline, servent.
+    // Script resolvers, http etc. are set up lazily once the main window is up.
     void initDatabase();
     void initLocalCollection();
     void initPipeline();
+    void initScriptResolvers();
 
     void initHTTP();
 
+    void startupPhase( const QString& phase );
+
     QWeakPointer<Database> m_database;
     QWeakPointer<ScanManager> m_scanManager;
     QWeakPointer<AudioEngine> m_audioEngine;
@@ -130,6 +140,9 @@ private:
 
     bool m_headless;
 
+    QTime m_startupTime;
+    int m_lastStartupPhase;
+
     QxtHttpServerConnector m_connector;
     QxtHttpSessionManager m_session;
 };
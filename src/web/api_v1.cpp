@@ -19,6 +19,9 @@
 #include "api_v1.h"
 
 #include <QHash>
+#include <QRegExp>
+
+#include "rangeiodevice.h"
 
 #include "utils/logger.h"
 
@@ -183,11 +186,69 @@ Api_v1::sid( QxtWebRequestEvent* event, QString unused )
         return send404( event ); // 503?
     }
 
-    QxtWebPageEvent* e = new QxtWebPageEvent( event->sessionID, event->requestID, iodev );
-    e->streaming = iodev->isSequential();
+    // Only local files and streams from peers can seek, anything else is sent from the start
+    const qint64 size = rp->size();
+    const bool seekable = !iodev->isSequential() && size > 0;
+
+    QString range;
+    for ( QMultiHash< QString, QString >::const_iterator it = event->headers.constBegin(); it != event->headers.constEnd(); ++it )
+    {
+        if ( it.key().toLower() == "range" )
+            range = it.value().trimmed();
+    }
+
+    // we only deal with a single range, for anything else the whole file is fine too
+    QRegExp rx( "^bytes=(\\d*)-(\\d*)$" );
+    if ( !seekable || range.isEmpty() || rx.indexIn( range ) < 0 || ( rx.cap( 1 ).isEmpty() && rx.cap( 2 ).isEmpty() ) )
+    {
+        QxtWebPageEvent* e = new QxtWebPageEvent( event->sessionID, event->requestID, iodev );
+        e->streaming = iodev->isSequential();
+        e->contentType = rp->mimetype().toAscii();
+        if( size > 0 )
+            e->headers.insert( "Content-Length", QString::number( size ) );
+        if ( seekable )
+            e->headers.insert( "Accept-Ranges", "bytes" );
+        postEvent( e );
+        return;
+    }
+
+    qint64 start, end;
+    if ( rx.cap( 1 ).isEmpty() )
+    {
+        // bytes=-500 are the last 500 bytes
+        start = qMax( (qint64)0, size - rx.cap( 2 ).toLongLong() );
+        end = size - 1;
+    }
+    else
+    {
+        start = rx.cap( 1 ).toLongLong();
+        end = rx.cap( 2 ).isEmpty() ? size - 1 : qMin( rx.cap( 2 ).toLongLong(), size - 1 );
+    }
+
+    if ( start >= size || start > end )
+    {
+        QxtWebPageEvent* e = new QxtWebPageEvent( event->sessionID, event->requestID, QByteArray() );
+        e->status = 416;
+        e->statusMessage = "Requested Range Not Satisfiable";
+        e->headers.insert( "Content-Range", QString( "bytes */%1" ).arg( size ) );
+        postEvent( e );
+        return;
+    }
+
+    qDebug() << "Serving range" << start << "-" << end << "of" << size;
+
+    const qint64 length = end - start + 1;
+    QSharedPointer<QIODevice> rangedev( new RangeIODevice( iodev, start, length ) );
+
+    QxtWebPageEvent* e = new QxtWebPageEvent( event->sessionID, event->requestID, rangedev );
+    e->chunked = false;
+    e->streaming = false;
+    e->status = 206;
+    e->statusMessage = "Partial Content";
     e->contentType = rp->mimetype().toAscii();
-    if( rp->size() > 0 )
-        e->headers.insert( "Content-Length", QString::number( rp->size() ) );
+    e->headers.insert( "Accept-Ranges", "bytes" );
+    e->headers.insert( "Content-Range", QString( "bytes %1-%2/%3" ).arg( start ).arg( end ).arg( size ) );
+    e->headers.insert( "Content-Length", QString::number( length ) );
     postEvent( e );
 }
 